@@ -22,8 +22,12 @@
 
 # Piglit core
 
+import bisect
 import errno
+import hashlib
+import heapq
 import json
+import mmap
 import os
 import platform
 import re
@@ -32,6 +36,7 @@ import subprocess
 import sys
 import time
 import traceback
+import types
 from log import log
 from cStringIO import StringIO
 from textwrap import dedent
@@ -43,13 +48,16 @@ __all__ = [
 	'Environment',
 	'checkDir',
 	'loadTestProfile',
+	'writeTestManifest',
 	'TestrunResult',
+	'TestrunResultReader',
 	'GroupResult',
 	'TestResult',
 	'TestProfile',
 	'Group',
 	'Test',
 	'testBinDir',
+	'MEMORY_ALL',
 ]
 
 class JSONWriter:
@@ -361,6 +369,157 @@ class TestrunResult:
 		for (path, result) in self.tests.items():
 			self.tests[path] = TestResult(result)
 
+# Tokens that matter when skipping over a JSON value, and the rest of a
+# string literal after its opening quote.
+_JSON_TOKEN = re.compile(r'["{}\[\]]')
+_JSON_STRING_TAIL = re.compile(r'[^"\\]*(?:\\.[^"\\]*)*"', re.DOTALL)
+_JSON_SCALAR = re.compile(r'[^,}\]\s]*')
+_JSON_SPACE = re.compile(r'\s*')
+
+class TestrunResultReader:
+	'''
+	Read a results file one test result at a time.
+
+	The file is mapped and scanned once to find where each test result
+	starts and ends; only the small top-level items (options, name,
+	glxinfo, ...) are decoded up front.  ``iterTests`` then decodes one
+	result at a time, in path order, so memory use does not grow with
+	the size of the test output stored in the file.
+
+	Like ``TestrunResult.parseFile``, a file that was not closed
+	properly is read up to its last complete test result.
+	'''
+	def __init__(self, path):
+		if os.path.isdir(path):
+			path = os.path.join(path, 'main')
+		self.filename = path
+		self.items = {}
+		self.__spans = []
+
+		self.__file = open(path, 'rb')
+		try:
+			self.__buf = mmap.mmap(self.__file.fileno(), 0,
+					       access=mmap.ACCESS_READ)
+		except (ValueError, mmap.error):
+			self.__file.close()
+			raise Exception('Could not read tests results: ' + path)
+
+		self.__scan()
+		self.__spans.sort()
+		self.name = self.items.get('name')
+		self.options = self.items.get('options', {})
+
+	def close(self):
+		self.__buf.close()
+		self.__file.close()
+
+	def testNames(self):
+		return [span[0] for span in self.__spans]
+
+	def testSpans(self):
+		'''
+		Return a list of (path, start, end) for every test result, sorted
+		by path.  ``readTest(start, end)`` decodes one of them.
+		'''
+		return self.__spans
+
+	def readTest(self, start, end):
+		return TestResult(json.loads(self.__buf[start:end]))
+
+	def iterTests(self):
+		'''Yield (path, TestResult) for every test, sorted by path.'''
+		for (path, start, end) in self.__spans:
+			yield (path, self.readTest(start, end))
+
+	def __skipSpace(self, pos):
+		return _JSON_SPACE.match(self.__buf, pos).end()
+
+	def __valueEnd(self, pos):
+		'''
+		Return the offset just past the JSON value starting at ``pos``,
+		or None if the file ends first.
+		'''
+		buf = self.__buf
+		if pos >= len(buf):
+			return None
+		c = buf[pos]
+		if c == '"':
+			m = _JSON_STRING_TAIL.match(buf, pos + 1)
+			return m and m.end()
+		if c not in '{[':
+			m = _JSON_SCALAR.match(buf, pos)
+			return m.end() if m.end() < len(buf) else None
+
+		depth = 0
+		while True:
+			m = _JSON_TOKEN.search(buf, pos)
+			if m is None:
+				return None
+			token = m.group()
+			pos = m.end()
+			if token == '"':
+				m = _JSON_STRING_TAIL.match(buf, pos)
+				if m is None:
+					return None
+				pos = m.end()
+			elif token in '{[':
+				depth += 1
+			else:
+				depth -= 1
+				if depth == 0:
+					return pos
+
+	def __scanDict(self, pos, item):
+		'''
+		Call item(key, start) for each item of the JSON object starting
+		at ``pos``; it returns the offset just past the item's value.
+		Return the offset just past the object, or None if the file ends
+		first.
+		'''
+		buf = self.__buf
+		pos = self.__skipSpace(pos)
+		if pos >= len(buf) or buf[pos] != '{':
+			raise Exception('Malformed results file: ' + self.filename)
+		pos += 1
+		while True:
+			pos = self.__skipSpace(pos)
+			if pos >= len(buf):
+				return None
+			if buf[pos] == '}':
+				return pos + 1
+			if buf[pos] == ',':
+				pos = self.__skipSpace(pos + 1)
+
+			key_end = self.__valueEnd(pos)
+			if key_end is None:
+				return None
+			key = json.loads(buf[pos:key_end])
+			pos = self.__skipSpace(key_end)
+			if pos >= len(buf) or buf[pos] != ':':
+				return None
+			pos = item(key, self.__skipSpace(pos + 1))
+			if pos is None:
+				return None
+
+	def __topItem(self, key, start):
+		if key not in TestrunResult().serialized_keys:
+			raise Exception('unexpected key in results file: ' + str(key))
+		if key == 'tests':
+			return self.__scanDict(start, self.__testItem)
+		end = self.__valueEnd(start)
+		if end is not None:
+			self.items[key] = json.loads(self.__buf[start:end])
+		return end
+
+	def __testItem(self, path, start):
+		end = self.__valueEnd(start)
+		if end is not None:
+			self.__spans.append((path, start, end))
+		return end
+
+	def __scan(self):
+		self.__scanDict(0, self.__topItem)
+
 #############################################################################
 ##### Generic Test classes
 #############################################################################
@@ -375,6 +534,21 @@ class Environment:
 		self.exclude_tests = set()
 		self.valgrind = False
 
+		# Run only one shard of the test list: a dict with the 1-based
+		# 'index' and the 'count' of shards.  prepare_test_list adds the
+		# 'partition' digest and the 'tests' of the shard; a resumed run
+		# passes those back in.  See shardTests().
+		self.shard = None
+		# Historical run time of each test, used to balance shards.
+		self.shard_times = {}
+
+		# The MemoryBudget shared by the tests running at the same
+		# time, or None to ignore their memory use, and the peak
+		# memory use of each test in a previous run (loadTestMemory).
+		self.memory_budget = None
+		self.memory_hints = {}
+		self.memory_median = None
+
 	def run(self, command):
 		try:
 			p = subprocess.Popen(
@@ -384,6 +558,21 @@ class Environment:
 			return "Failed to run " + command
 		return stderr+stdout
 
+	def memoryEstimate(self, path, test):
+		'''
+		Return how many bytes of memory the test at ``path`` is
+		expected to use: its peak in the previous run, else what the
+		profile declares, else the median peak of the previous run.
+		'''
+		if path in self.memory_hints:
+			return self.memory_hints[path]
+		if test.memory is not None:
+			return test.memory
+		if self.memory_median is None:
+			peaks = sorted(self.memory_hints.values())
+			self.memory_median = peaks[len(peaks) / 2] if peaks else 0
+		return self.memory_median
+
 	def collectData(self):
 		result = {}
 		if platform.system() != 'Windows':
@@ -392,9 +581,18 @@ class Environment:
 			result['lspci'] = self.run('lspci')
 		return result
 
+# Declares that a test may use all the memory there is, e.g. because it
+# allocates the largest surfaces the driver allows.  See Test.memory.
+MEMORY_ALL = float('inf')
+
 class Test:
 	ignoreErrors = []
 
+	# Peak memory use of the test in bytes, or MEMORY_ALL, for
+	# scheduling it when no previous run has measured it.  None means
+	# unknown.  See Environment.memoryEstimate.
+	memory = None
+
 	def __init__(self, runConcurrent = False):
 		'''
 			'runConcurrent' controls whether this test will
@@ -406,6 +604,18 @@ class Test:
 	def run(self):
 		raise NotImplementedError
 
+	def getManifestState(self):
+		'''
+		Return a JSON serializable dictionary from which
+		``setManifestState`` can recreate this test.
+
+		See ``writeTestManifest``.
+		'''
+		return dict(self.__dict__)
+
+	def setManifestState(self, state):
+		self.__dict__.update(state)
+
 	def schedule(self, env, path, json_writer):
 		'''
 		Schedule test to be run via the concurrent thread pool.
@@ -430,6 +640,9 @@ class Test:
 
 		# Run the test
 		if env.execute:
+			if env.memory_budget is not None:
+				memory = env.memory_budget.acquire(
+					env.memoryEstimate(path, self))
 			try:
 				status("running")
 				time_start = time.time()
@@ -452,6 +665,8 @@ class Test:
 			status(result['result'])
 
 			json_writer.write_dict_item(path, result)
+			if env.memory_budget is not None:
+				env.memory_budget.release(memory)
 		else:
 			status("dry-run")
 
@@ -487,6 +702,11 @@ class TestProfile:
 	def __init__(self):
 		self.tests = Group()
 		self.test_list = {}
+		self.prepared = False
+
+		# Set by loadTestProfile when loading a manifest.  The tests
+		# then come from the manifest rather than from self.tests.
+		self.manifest = None
 
 	def flatten_group_hierarchy(self):
 		'''
@@ -511,6 +731,12 @@ class TestProfile:
 		self.tests = Group()
 
 	def prepare_test_list(self, env):
+		self.prepared = True
+		if self.manifest is not None:
+			self.test_list = self.manifest.select(env)
+			self.__select_shard(env)
+			return
+
 		self.flatten_group_hierarchy()
 
 		def matches_any_regexp(x, re_list):
@@ -523,20 +749,42 @@ class TestProfile:
 
 		# Filter out unwanted tests
 		self.test_list = dict(filter(test_matches, self.test_list.items()))
+		self.__select_shard(env)
+
+	def __select_shard(self, env):
+		if env.shard is None:
+			return
+		if 'tests' not in env.shard:
+			(env.shard['tests'], env.shard['partition']) = shardTests(
+				self.test_list.keys(), env.shard['index'],
+				env.shard['count'], env.shard_times)
+		shard_tests = set(env.shard['tests'])
+		self.test_list = dict([(path, test)
+				       for (path, test) in self.test_list.items()
+				       if path in shard_tests])
 
 	def run(self, env, json_writer):
 		'''
 		Schedule all tests in profile for execution.
 
-		See ``Test.schedule`` and ``Test.run``.
+		See ``Test.schedule`` and ``Test.run``.  The test list is
+		prepared first unless ``prepare_test_list`` was already called.
 		'''
 
-		self.prepare_test_list(env)
+		if not self.prepared:
+			self.prepare_test_list(env)
 
 		# Queue up all the concurrent tests, so the pool is filled
-		# at the start of the test run.
+		# at the start of the test run.  Under a memory budget, queue
+		# the biggest first, so that the small ones fill in around
+		# them instead of leaving them to run alone at the end.
 		if env.concurrent:
-			for (path, test) in self.test_list.items():
+			tests = self.test_list.items()
+			if env.memory_budget is not None:
+				tests.sort(key=lambda (path, test):
+					   env.memoryEstimate(path, test),
+					   reverse=True)
+			for (path, test) in tests:
 				test.schedule(env, path, json_writer)
 
 		# Run any remaining non-concurrent tests serially from this
@@ -560,11 +808,295 @@ class TestProfile:
 			group = group[group_name]
 		del group[l[-1]]
 
+#############################################################################
+##### Sharding
+#############################################################################
+
+def shardTests(paths, index, count, times):
+	'''
+	Split ``paths`` into ``count`` shards of about equal total run time,
+	and return a sorted list of the paths in shard ``index`` (counting
+	from 1) together with a digest identifying the partition.
+
+	Tests are handed out longest first, each to the shard with the least
+	time so far; ``times`` maps paths to their historical run time, and
+	tests missing from it are assumed to take the median time.  The
+	result depends only on the arguments, so every machine of a sharded
+	run computes the same partition from the same profile, filters and
+	times.
+	'''
+	known = sorted([times[path] for path in paths if path in times])
+	default = known[len(known) // 2] if known else 1.0
+
+	def cost(path):
+		return times.get(path, default)
+
+	digest = hashlib.sha1()
+	shards = [(0.0, i) for i in range(count)]
+	selected = []
+	for path in sorted(paths, key=lambda path: (-cost(path), path)):
+		(total, i) = heapq.heappop(shards)
+		if i == index - 1:
+			selected.append(path)
+		heapq.heappush(shards, (total + cost(path), i))
+		digest.update((u'%s\t%d\t%r\n' % (path, i, cost(path)))
+			      .encode('utf-8'))
+
+	return (sorted(selected), digest.hexdigest())
+
+def _loadResultValues(path, key):
+	reader = TestrunResultReader(path)
+	values = {}
+	try:
+		for (test_path, result) in reader.iterTests():
+			if key in result:
+				values[test_path] = float(result[key])
+	finally:
+		reader.close()
+	return values
+
+def loadTestTimes(path):
+	'''
+	Return a dictionary mapping each test in the results file ``path``
+	to its run time, for balancing shards.
+	'''
+	return _loadResultValues(path, 'time')
+
+def loadTestMemory(path):
+	'''
+	Return a dictionary mapping each test in the results file ``path``
+	to its peak memory use in bytes, for Environment.memoryEstimate.
+	'''
+	return _loadResultValues(path, 'peak_rss')
+
+#############################################################################
+##### Test manifests
+#############################################################################
+
+# A test manifest is a snapshot of a flattened TestProfile, written at
+# build time by piglit-manifest.py, so that piglit-run.py doesn't have to
+# execute the profile, and walk the source tree, on every run.
+#
+# The first line identifies the format.  Every other line describes one
+# test, and the lines are sorted by test path:
+#
+#   path <TAB> concurrent <TAB> module.Class <TAB> state
+#
+# where state is the JSON encoded result of Test.getManifestState().
+# Since the manifest is written once and used with many result
+# directories, the profile is loaded with MANIFEST_RES_DIR as its result
+# directory, and testBinDir is replaced by MANIFEST_BIN_DIR.
+
+MANIFEST_HEADER = 'piglit test manifest 1'
+MANIFEST_BIN_DIR = '%PIGLIT_BIN_DIR%'
+MANIFEST_RES_DIR = '%PIGLIT_RES_DIR%'
+
+def _encodeManifestValue(value):
+	if isinstance(value, basestring):
+		if value.startswith(testBinDir):
+			value = MANIFEST_BIN_DIR + value[len(testBinDir):]
+		return value
+	elif isinstance(value, (list, tuple)):
+		return [_encodeManifestValue(v) for v in value]
+	elif isinstance(value, dict):
+		return dict((k, _encodeManifestValue(v))
+			    for (k, v) in value.items())
+	return value
+
+def _decodeManifestValue(value, resdir):
+	# The json module returns unicode strings.  Hand out plain strings
+	# like the profiles do, with the placeholders filled in.
+	if isinstance(value, basestring):
+		if isinstance(value, unicode):
+			value = value.encode('utf-8')
+		return value.replace(MANIFEST_BIN_DIR, testBinDir) \
+			    .replace(MANIFEST_RES_DIR, resdir)
+	elif isinstance(value, list):
+		return [_decodeManifestValue(v, resdir) for v in value]
+	elif isinstance(value, dict):
+		return dict((_decodeManifestValue(k, resdir),
+			     _decodeManifestValue(v, resdir))
+			    for (k, v) in value.items())
+	return value
+
+def writeTestManifest(profile, file):
+	'''
+	Write every test of ``profile``, which must have been loaded with
+	MANIFEST_RES_DIR as its result directory, to ``file``.
+	'''
+	profile.prepare_test_list(Environment())
+
+	file.write(MANIFEST_HEADER + '\n')
+	for path in sorted(profile.test_list.keys()):
+		test = profile.test_list[path]
+		cls = test.__class__
+		if '\t' in path or '\n' in path:
+			raise Exception('Test name {0!r} cannot be stored in a '
+					'manifest'.format(path))
+		state = _encodeManifestValue(test.getManifestState())
+		file.write('\t'.join([
+			path,
+			'1' if test.runConcurrent else '0',
+			cls.__module__ + '.' + cls.__name__,
+			json.dumps(state, sort_keys=True)]) + '\n')
+
+def _literalPrefix(pattern):
+	'''
+	Return ``(prefix, exact)`` such that every string that the regular
+	expression ``pattern`` matches starts with ``prefix``.  ``exact``
+	is True if, conversely, every string starting with ``prefix``
+	matches.  Return None if the pattern isn't anchored at the start.
+	'''
+	if not pattern.startswith('^') or '|' in pattern:
+		return None
+
+	prefix = ''
+	i = 1
+	while i < len(pattern):
+		c = pattern[i]
+		if c == '\\' and i + 1 < len(pattern) and \
+		   not pattern[i + 1].isalnum():
+			# Escaped punctuation is a literal.
+			c = pattern[i + 1]
+			i += 1
+		elif c in '.^$*+?{}[]()\\':
+			break
+		prefix += c
+		i += 1
+
+	if i == len(pattern):
+		return (prefix, True)
+	if pattern[i] in '*?{':
+		# The last literal is optional.
+		prefix = prefix[:-1]
+	return (prefix, False)
+
+class TestManifest:
+	'''
+	A test manifest, as written by ``writeTestManifest``.
+
+	Only the test paths are decoded when the manifest is loaded.  Tests
+	are recreated on demand by ``select``, which uses the literal
+	prefixes of anchored filters to look up ranges of the sorted path
+	list, so that typical filters such as ``^glean/`` neither scan nor
+	recreate the rest of the manifest.
+	'''
+	def __init__(self, file, resdir):
+		if file.readline().rstrip('\n') != MANIFEST_HEADER:
+			raise Exception('Unsupported test manifest format')
+
+		self.resdir = resdir
+		self.paths = []
+		self.entries = []
+		for line in file:
+			(path, entry) = line.rstrip('\n').split('\t', 1)
+			self.paths.append(path)
+			self.entries.append(entry)
+
+		# piglit-manifest.py sorts the manifest, but don't rely on
+		# that for hand edited ones.
+		if self.paths != sorted(self.paths):
+			order = sorted(range(len(self.paths)),
+				       key=self.paths.__getitem__)
+			self.paths = [self.paths[i] for i in order]
+			self.entries = [self.entries[i] for i in order]
+
+	def __prefixRange(self, prefix):
+		'''Return the index range of the paths starting with prefix.'''
+		# Paths are UTF-8, which never contains a 0xff byte.
+		begin = bisect.bisect_left(self.paths, prefix)
+		end = bisect.bisect_left(self.paths, prefix + '\xff', begin)
+		return (begin, end)
+
+	def __candidates(self, filters):
+		'''
+		Return a sorted list of ``(index, matched)`` tuples covering
+		every path that may match one of ``filters``.  ``matched`` is
+		True if the path is known to match.
+		'''
+		if not filters:
+			return [(i, True) for i in range(len(self.paths))]
+
+		candidates = {}
+		for r in filters:
+			literal = _literalPrefix(r.pattern)
+			if literal is None:
+				# Unanchored; every path is a candidate.
+				for i in range(len(self.paths)):
+					candidates.setdefault(i, False)
+				continue
+			(prefix, exact) = literal
+			(begin, end) = self.__prefixRange(prefix)
+			for i in range(begin, end):
+				candidates[i] = candidates.get(i, False) or exact
+		return sorted(candidates.items())
+
+	def __makeTest(self, index):
+		(concurrent, name, state) = self.entries[index].split('\t', 2)
+		(module, cls) = name.rsplit('.', 1)
+		cls = getattr(__import__(module, fromlist=[cls]), cls)
+
+		# Recreate the test without running its constructor, which
+		# may have side effects such as creating directories.
+		if isinstance(cls, type):
+			test = cls.__new__(cls)
+		else:
+			test = types.InstanceType(cls)
+		test.setManifestState(
+			_decodeManifestValue(json.loads(state), self.resdir))
+		test.runConcurrent = concurrent == '1'
+		return test
+
+	def select(self, env):
+		'''
+		Return a dictionary mapping the paths of the tests that pass
+		the filters of ``env`` to Test objects.
+		'''
+		def matches_any_regexp(x, re_list):
+			return True in map(lambda r: r.search(x) != None, re_list)
+
+		excluded_ranges = []
+		exclude_filter = []
+		for r in env.exclude_filter:
+			literal = _literalPrefix(r.pattern)
+			if literal is not None and literal[1]:
+				excluded_ranges.append(
+					self.__prefixRange(literal[0]))
+			else:
+				exclude_filter.append(r)
+
+		test_list = {}
+		for (i, matched) in self.__candidates(env.filter):
+			path = self.paths[i]
+			if not matched and not matches_any_regexp(path, env.filter):
+				continue
+			if path in env.exclude_tests or \
+			   True in [b <= i < e for (b, e) in excluded_ranges] or \
+			   matches_any_regexp(path, exclude_filter):
+				continue
+			test_list[path] = self.__makeTest(i)
+		return test_list
+
 #############################################################################
 ##### Loaders
 #############################################################################
 
 def loadTestProfile(filename, resdir):
+	'''
+	Load the test profile ``filename``.  This is either a profile
+	script (``*.tests``) or a manifest (``*.manifest``) written by
+	piglit-manifest.py.
+	'''
+	if filename.endswith('.manifest'):
+		profile = TestProfile()
+		try:
+			with open(filename, 'r') as file:
+				profile.manifest = TestManifest(file, resdir)
+		except:
+			traceback.print_exc()
+			raise Exception('Could not read test manifest')
+		return profile
+
 	ns = {
 		'__file__': filename,
 		'res_dir': resdir
@@ -23,9 +23,13 @@
 import os
 import subprocess
 import shlex
+import threading
+import time
 import types
 
 from core import Test, testBinDir, TestResult
+import process
+import zygote
 
 #############################################################################
 ##### ExecTest: A shared base class for tests that simply run an executable.
@@ -40,11 +44,82 @@ class ExecTest(Test):
 		if isinstance(self.command, basestring):
 			self.command = shlex.split(str(self.command))
 
+	# Name of the subtest this test reports, for tests whose command
+	# reports several subtests in one run.  See runSubtest.
+	subtest = None
+
+	# Start tests through fork servers where possible.  See zygote.py.
+	useZygotes = False
+
+	# The threads.ThreadBudget that gives each concurrent run its CPUs,
+	# or None.  Serial runs have the machine to themselves and are left
+	# alone.  A run is restricted to its CPUs through PIGLIT_CPUS (see
+	# piglit_set_cpu_affinity_from_env), and drivers that start
+	# threads of their own are told how many through these variables,
+	# unless they are set already.
+	threadBudget = None
+	threadCountVariables = [
+		'LP_NUM_THREADS',		# llvmpipe
+		'POCL_MAX_PTHREAD_COUNT',	# pocl
+	]
+
+	# Runs of such commands, shared by the tests of their subtests.
+	subtestRuns = {}
+	subtestRunsLock = threading.Lock()
+
 	def interpretResult(self, out, results):
 		raise NotImplementedError
 		return out
 
+	def selectSubtest(self):
+		'''
+		Change the command so that it runs only ``self.subtest``.
+		'''
+		raise NotImplementedError
+
 	def run(self, valgrind):
+		if self.subtest is None:
+			return self.runCommand(valgrind)
+		if valgrind:
+			# Valgrind's verdict is per process, so give the
+			# subtest a process of its own.
+			self.selectSubtest()
+			return self.runCommand(valgrind)
+		return self.runSubtest()
+
+	def runSubtest(self):
+		'''
+		Return the result of ``self.subtest``, taken from a run of the
+		command that reports every subtest.
+
+		The first test of the command to run starts it, and the rest
+		reuse its output.  A subtest without a record of its own, e.g.
+		because the command crashed before reaching it, gets the result
+		and output of the whole run.
+		'''
+		key = (tuple(self.command), tuple(sorted(self.env.items())))
+		with ExecTest.subtestRunsLock:
+			shared = ExecTest.subtestRuns.setdefault(
+				key, {'lock': threading.Lock()})
+		with shared['lock']:
+			if 'result' not in shared:
+				start = time.time()
+				shared['result'] = self.runCommand(False)
+				shared['time'] = time.time() - start
+
+		result = TestResult(shared['result'])
+		result.pop('subtest', None)
+		subtests = result.pop('subtests', {})
+		if self.subtest in subtests:
+			(status, out) = subtests[self.subtest]
+			if status == 'pass' and 'errors' in result:
+				status = 'warn'
+			result['result'] = status
+			result['info'] = "Returncode: %d\n\nOutput:\n%s" % (result['returncode'], out)
+			result['time'] = shared['time'] / len(subtests)
+		return result
+
+	def runCommand(self, valgrind):
 		fullenv = os.environ.copy()
 		for e in self.env:
 			fullenv[e] = str(self.env[e])
@@ -54,14 +129,34 @@ class ExecTest(Test):
 			if valgrind:
 				command[:0] = ['valgrind', '--quiet', '--error-exitcode=1', '--tool=memcheck']
 
-			proc = subprocess.Popen(
-				command,
-				stdout=subprocess.PIPE,
-				stderr=subprocess.PIPE,
-				env=fullenv,
-				universal_newlines=True
-				)
-			out, err = proc.communicate()
+			cpus = None
+			if ExecTest.threadBudget is not None and \
+			   self.runConcurrent:
+				cpus = ExecTest.threadBudget.acquire()
+				fullenv['PIGLIT_CPUS'] = ','.join(map(str, cpus))
+				for var in ExecTest.threadCountVariables:
+					fullenv.setdefault(var, str(len(cpus)))
+
+			try:
+				forked = None
+				if ExecTest.useZygotes and not valgrind:
+					forked = zygote.run(command, fullenv)
+				if forked is not None:
+					(out, err, returncode, peak_rss) = forked
+				else:
+					proc = process.Popen(
+						command,
+						stdout=subprocess.PIPE,
+						stderr=subprocess.PIPE,
+						env=fullenv,
+						universal_newlines=True
+						)
+					out, err = proc.communicate()
+					returncode = proc.returncode
+					peak_rss = proc.peak_rss
+			finally:
+				if cpus is not None:
+					ExecTest.threadBudget.release(cpus)
 
 			# proc.communicate() returns 8-bit strings, but we need
 			# unicode strings.  In Python 2.x, this is because we
@@ -83,6 +178,8 @@ class ExecTest(Test):
 			results = TestResult()
 
 			results['result'] = 'fail'
+			if self.subtest is not None:
+				results['subtests'] = splitSubtestOutput(out)
 			out = self.interpretResult(out, results)
 
 			crash_codes = [
@@ -99,17 +196,17 @@ class ExecTest(Test):
 				-1073741676
 			]
 
-			if proc.returncode in crash_codes:
+			if returncode in crash_codes:
 				results['result'] = 'crash'
-			elif proc.returncode != 0:
-				results['note'] = 'Returncode was %d' % (proc.returncode)
+			elif returncode != 0:
+				results['note'] = 'Returncode was %d' % (returncode)
 
 			if valgrind:
 				# If the underlying test failed, simply report
 				# 'skip' for this valgrind test.
 				if results['result'] != 'pass':
 					results['result'] = 'skip'
-				elif proc.returncode == 0:
+				elif returncode == 0:
 					# Test passes and is valgrind clean.
 					results['result'] = 'pass'
 				else:
@@ -121,9 +218,13 @@ class ExecTest(Test):
 				env = env + key + '="' + self.env[key] + '" '
 			if env:
 				results['environment'] = env
-			results['info'] = "Returncode: %d\n\nErrors:\n%s\n\nOutput:\n%s" % (proc.returncode, err, out)
-			results['returncode'] = proc.returncode
+			results['info'] = "Returncode: %d\n\nErrors:\n%s\n\nOutput:\n%s" % (returncode, err, out)
+			results['returncode'] = returncode
 			results['command'] = ' '.join(self.command)
+			# For the memory budget of later runs; see
+			# core.loadTestMemory.
+			if peak_rss is not None and not valgrind:
+				results['peak_rss'] = peak_rss
 
 			self.handleErr(results, err)
 
@@ -136,16 +237,61 @@ class ExecTest(Test):
 
 
 
+def mergeResultDict(results, record):
+	'''
+	Merge one PIGLIT: record into ``results``.
+
+	Dict-valued items (e.g. ``'bench'``) are merged one level deep, so
+	that a test can report several records under the same key.
+	'''
+	for (key, value) in record.items():
+		if isinstance(value, dict) and isinstance(results.get(key), dict):
+			results[key].update(value)
+		else:
+			results[key] = value
+
+def splitSubtestOutput(out):
+	'''
+	Split the output of a test that reports several subtests from one
+	process.
+
+	Return a dictionary mapping the name of each subtest in a
+	``'subtest'`` PIGLIT: record to a ``(result, output)`` tuple, where
+	output is the text printed between the previous record and this one.
+	'''
+	subtests = {}
+	lines = []
+	for line in out.split('\n'):
+		if line.startswith('PIGLIT:'):
+			try:
+				record = eval(line[7:], {})
+			except:
+				record = None
+			if isinstance(record, dict) and \
+			   isinstance(record.get('subtest'), dict):
+				for (name, result) in record['subtest'].items():
+					subtests[name] = (result, '\n'.join(lines))
+				lines = []
+				continue
+		lines.append(line)
+	return subtests
+
 #############################################################################
 ##### PlainExecTest: Run a "native" piglit test executable
-##### Expect one line prefixed PIGLIT: in the output, which contains a
-##### result dictionary. The plain output is appended to this dictionary
+##### Expect lines prefixed PIGLIT: in the output, each of which contains a
+##### result dictionary. The dictionaries are merged in order, and the plain
+##### output is appended to the merged dictionary
 #############################################################################
 class PlainExecTest(ExecTest):
-	def __init__(self, command):
+	def __init__(self, command, subtest = None):
 		ExecTest.__init__(self, command)
 		# Prepend testBinDir to the path.
 		self.command[0] = testBinDir + self.command[0]
+		if subtest is not None:
+			self.subtest = subtest
+
+	def selectSubtest(self):
+		self.command = self.command + ['-subtest', self.subtest]
 
 	def interpretResult(self, out, results):
 		outlines = out.split('\n')
@@ -153,7 +299,8 @@ class PlainExecTest(ExecTest):
 
 		if len(outpiglit) > 0:
 			try:
-				results.update(eval(''.join(outpiglit), {}))
+				for record in outpiglit:
+					mergeResultDict(results, eval(record, {}))
 				out = '\n'.join(filter(lambda s: not s.startswith('PIGLIT:'), outlines))
 			except:
 				results['result'] = 'fail'
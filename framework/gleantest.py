@@ -38,21 +38,39 @@ def gleanResultDir(r_dir):
 class GleanTest(ExecTest):
 	globalParams = []
 
-	def __init__(self, name, resdir):
+	def __init__(self, name, resdir, subtest = None):
 		ExecTest.__init__(self, \
 			[gleanExecutable(), "-r", os.path.join(gleanResultDir(resdir), name),
 			"-o",
 			"-v", "-v", "-v",
 			"-t", "+"+name])
 
+		self.resultDir = os.path.join(gleanResultDir(resdir), name)
 		if resdir[0] not in '$%':
-			checkDir(os.path.join(gleanResultDir(resdir), name), False)
+			checkDir(self.resultDir, False)
 
 		self.name = name
+		if subtest is not None:
+			self.subtest = subtest
+
+	def getManifestState(self):
+		# Profiles set globalParams after creating the tests, and a
+		# manifest doesn't run the profile, so record them per test.
+		state = ExecTest.getManifestState(self)
+		state['command'] = self.command + GleanTest.globalParams
+		return state
+
+	def setManifestState(self, state):
+		ExecTest.setManifestState(self, state)
+		if self.resultDir[0] not in '$%':
+			checkDir(self.resultDir, False)
+
+	def selectSubtest(self):
+		self.env['PIGLIT_TEST'] = self.subtest
 
 	def run(self, valgrind):
-                self.command += GleanTest.globalParams
-                return ExecTest.run(self, valgrind)
+		self.command += GleanTest.globalParams
+		return ExecTest.run(self, valgrind)
 
 	def interpretResult(self, out, results):
 		if out.find('FAIL') >= 0:
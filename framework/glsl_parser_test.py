@@ -343,6 +343,15 @@ class GLSLParserTest(PlainExecTest):
 		p = subprocess.Popen(self.command, env=env)
 		p.communicate()
 
+	def getManifestState(self):
+		# The config section is parsed lazily; don't store the
+		# parsed config, or the result of parsing it.
+		state = Test.getManifestState(self)
+		state['_GLSLParserTest__config'] = None
+		state['_GLSLParserTest__command'] = None
+		state['result'] = None
+		return state
+
 	@property
 	def config(self):
 		if self.__config is None:
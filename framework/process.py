@@ -0,0 +1,65 @@
+#
+# Copyright (c) 2012 Intel Corporation
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+#
+
+# Starting test processes and measuring what they used.
+
+import errno
+import os
+import subprocess
+import sys
+
+__all__ = ['Popen', 'maxrssBytes']
+
+def maxrssBytes(maxrss):
+	'''
+	Convert ``ru_maxrss`` of getrusage(2) or wait4(2) to bytes.  It is
+	in kilobytes, except on Mac OS X.
+	'''
+	if sys.platform == 'darwin':
+		return int(maxrss)
+	return int(maxrss) * 1024
+
+class Popen(subprocess.Popen):
+	'''
+	subprocess.Popen that reaps the child with wait4(), where there is
+	one, and keeps its peak resident set size in bytes as ``peak_rss``
+	(None if unknown).
+	'''
+	peak_rss = None
+
+	if hasattr(os, 'wait4'):
+		def wait(self):
+			while self.returncode is None:
+				try:
+					(pid, status, usage) = os.wait4(self.pid, 0)
+				except OSError, e:
+					if e.errno == errno.EINTR:
+						continue
+					if e.errno != errno.ECHILD:
+						raise
+					# Somebody else reaped it.
+					self.returncode = 0
+					break
+				self.peak_rss = maxrssBytes(usage.ru_maxrss)
+				self._handle_exitstatus(status)
+			return self.returncode
@@ -23,9 +23,10 @@
 
 from threadpool import ThreadPool, WorkRequest
 from patterns import Singleton
-from threading import RLock
+from threading import Condition, RLock
 from weakref import WeakKeyDictionary
 import multiprocessing
+import time
 
 def synchronized_self(function):
 	'''
@@ -57,3 +58,155 @@ class ConcurrentTestPool(Singleton):
 
 	def join(self):
 		self.pool.wait()
+
+class MemoryBudget:
+	'''
+	Admits tests, in the order they ask, while the memory they are
+	expected to use fits in ``budget`` bytes.  A test that needs more
+	than the whole budget is admitted once nothing else is running.
+	'''
+	def __init__(self, budget):
+		self.budget = budget
+		self.used = 0
+		self.running = 0
+		self.next_ticket = 0
+		self.serving = 0
+		self.cond = Condition()
+
+	def acquire(self, amount):
+		'''
+		Wait until ``amount`` bytes fit, and take them.  Return the
+		amount to give back to ``release``.
+		'''
+		amount = min(amount, self.budget)
+		self.cond.acquire()
+		try:
+			ticket = self.next_ticket
+			self.next_ticket += 1
+			while ticket != self.serving or \
+			      (self.running > 0 and
+			       self.used + amount >= self.budget):
+				self.cond.wait()
+			self.serving += 1
+			self.used += amount
+			self.running += 1
+			# Let the next one in line check whether it fits.
+			self.cond.notifyAll()
+		finally:
+			self.cond.release()
+		return amount
+
+	def release(self, amount):
+		self.cond.acquire()
+		try:
+			self.used -= amount
+			self.running -= 1
+			self.cond.notifyAll()
+		finally:
+			self.cond.release()
+
+def availableCpus():
+	'''
+	Return a sorted list of the CPUs this process may run on.
+	'''
+	try:
+		for line in open('/proc/self/status'):
+			if line.startswith('Cpus_allowed_list:'):
+				cpus = []
+				for part in line.split(':', 1)[1].strip().split(','):
+					bounds = map(int, part.split('-'))
+					cpus += range(bounds[0], bounds[-1] + 1)
+				return cpus
+	except (IOError, ValueError):
+		pass
+	return range(multiprocessing.cpu_count())
+
+class ThreadBudget:
+	'''
+	Shares the CPUs among the tests that run at the same time.  Each
+	test gets ``threads`` CPUs of its own, for itself and the threads
+	its driver starts (e.g. llvmpipe's rasterizer threads), so that
+	running many tests at once doesn't oversubscribe the machine.
+
+	With ``tune``, ``threads`` is chosen while the tests run, see
+	ThreadTuner.
+	'''
+	def __init__(self, threads, tune = False):
+		self.free = availableCpus()
+		self.cpus = len(self.free)
+		self.tuner = None
+		if tune:
+			self.tuner = ThreadTuner(self.cpus)
+			threads = self.tuner.threads
+		self.threads = max(1, min(threads, self.cpus))
+		self.cond = Condition()
+
+	def acquire(self):
+		'''
+		Wait for ``threads`` free CPUs and return a list of them.
+		'''
+		self.cond.acquire()
+		try:
+			while len(self.free) < self.threads:
+				self.cond.wait()
+			cpus = self.free[:self.threads]
+			del self.free[:self.threads]
+		finally:
+			self.cond.release()
+		return cpus
+
+	def release(self, cpus):
+		self.cond.acquire()
+		try:
+			self.free = sorted(self.free + cpus)
+			if self.tuner is not None:
+				self.threads = self.tuner.finished()
+			self.cond.notifyAll()
+		finally:
+			self.cond.release()
+
+class ThreadTuner:
+	'''
+	Finds the number of CPUs per test that finishes the most tests per
+	second.  Starting with 1, each power of two is tried for
+	``window`` tests, and doubled as long as the rate improves.  The
+	best one is then kept for the rest of the run.
+	'''
+	window = 32
+
+	def __init__(self, cpus):
+		self.cpus = cpus
+		self.threads = 1
+		self.best = None
+		self.done = False
+		self.__restart()
+
+	def __restart(self):
+		self.count = 0
+		self.start = time.time()
+
+	def finished(self):
+		'''
+		Count a finished test, and return the number of CPUs to give
+		each test from now on.
+		'''
+		if self.done:
+			return self.threads
+		self.count += 1
+		if self.count < self.window:
+			return self.threads
+
+		rate = self.count / max(time.time() - self.start, 1e-6)
+		if self.best is None or rate > self.best[0]:
+			self.best = (rate, self.threads)
+			if self.threads * 2 <= self.cpus:
+				self.threads *= 2
+				self.__restart()
+				return self.threads
+
+		self.threads = self.best[1]
+		self.done = True
+		from log import log
+		log(msg = '%d CPUs per test, %.1f tests/s' % self.best[::-1],
+		    channel = 'threads')
+		return self.threads
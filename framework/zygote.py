@@ -0,0 +1,175 @@
+#
+# Copyright (c) 2012 Intel Corporation
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+#
+
+# Running tests through fork servers ("zygotes").
+#
+# The first run of an executable is started with PIGLIT_ZYGOTE set.  An
+# executable using piglit's framework then becomes a zygote for itself
+# instead of running the test (see tests/util/piglit-zygote.h), and this
+# and every later run of it are forked from the zygote.  Any other
+# executable just runs the test, and is started normally from then on.
+
+import atexit
+import os
+import shutil
+import socket
+import subprocess
+import tempfile
+import threading
+
+import process
+
+__all__ = ['run']
+
+READY = 'PIGLIT-ZYGOTE: ready'
+
+class Zygote:
+	def __init__(self, directory, socketPath, proc, stderr):
+		self.directory = directory
+		self.socketPath = socketPath
+		self.proc = proc
+		self.stderr = stderr
+
+	def run(self, command, env):
+		'''
+		Run command in a child of the zygote and return the tuple
+		``(stdout, stderr, returncode, peak_rss)``, where peak_rss is
+		the child's peak resident set size in bytes.  Raises
+		socket.error or ValueError if the zygote is gone.
+		'''
+		(fd, outPath) = tempfile.mkstemp(dir=self.directory)
+		os.close(fd)
+		(fd, errPath) = tempfile.mkstemp(dir=self.directory)
+		os.close(fd)
+		try:
+			fields = [outPath, errPath, os.getcwd(), str(len(command))]
+			fields += command
+			fields.append(str(len(env)))
+			fields += ['%s=%s' % item for item in env.items()]
+
+			sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+			try:
+				sock.connect(self.socketPath)
+				sock.sendall(''.join([str(f) + '\0' for f in fields]))
+				sock.shutdown(socket.SHUT_WR)
+				reply = ''
+				while True:
+					data = sock.recv(64)
+					if not data:
+						break
+					reply += data
+			finally:
+				sock.close()
+			(returncode, maxrss) = map(int, reply.split())
+
+			out = open(outPath, 'rU').read()
+			err = open(errPath, 'rU').read()
+		finally:
+			os.unlink(outPath)
+			os.unlink(errPath)
+		return (out, err, returncode, process.maxrssBytes(maxrss))
+
+	def close(self):
+		try:
+			self.proc.stdin.close()
+			self.proc.wait()
+		except:
+			pass
+		self.stderr.close()
+		shutil.rmtree(self.directory, True)
+
+# Maps each executable to a dictionary holding a lock and, once its first
+# run has been started, the Zygote or None if it can't be one.
+zygotes = {}
+zygotesLock = threading.Lock()
+
+def start(command, env):
+	'''
+	Start command as a zygote.  Return ``(zygote, None)`` if it became
+	one, else ``(None, (stdout, stderr, returncode, peak_rss))`` of the
+	test run.
+	'''
+	directory = tempfile.mkdtemp(prefix='piglit-zygote-')
+	socketPath = os.path.join(directory, 'socket')
+	zygoteEnv = dict(env)
+	zygoteEnv['PIGLIT_ZYGOTE'] = '%d:%s' % (os.getpid(), socketPath)
+
+	# Keep stderr out of the way of reading the first line of stdout.
+	stderr = tempfile.TemporaryFile()
+	proc = process.Popen(
+		command,
+		stdin=subprocess.PIPE,
+		stdout=subprocess.PIPE,
+		stderr=stderr,
+		env=zygoteEnv,
+		universal_newlines=True
+		)
+	first = proc.stdout.readline()
+	if first.rstrip('\n') == READY:
+		return (Zygote(directory, socketPath, proc, stderr), None)
+
+	(out, _) = proc.communicate()
+	stderr.seek(0)
+	err = stderr.read()
+	stderr.close()
+	shutil.rmtree(directory, True)
+	return (None, (first + out, err, proc.returncode, proc.peak_rss))
+
+def run(command, env):
+	'''
+	Run command with the environment env through a zygote of its
+	executable.  Return ``(stdout, stderr, returncode, peak_rss)``, or
+	None if the caller should start the command itself.
+	'''
+	with zygotesLock:
+		entry = zygotes.setdefault(command[0],
+					   {'lock': threading.Lock()})
+	with entry['lock']:
+		if 'zygote' not in entry:
+			try:
+				(entry['zygote'], result) = start(command, env)
+			except OSError:
+				entry['zygote'] = None
+				return None
+			if result is not None:
+				return result
+		zygote = entry['zygote']
+
+	if zygote is None:
+		return None
+	try:
+		return zygote.run(command, env)
+	except (socket.error, ValueError):
+		# The zygote died.  Later runs start the command themselves.
+		with entry['lock']:
+			entry['zygote'] = None
+		return None
+
+def closeAll():
+	with zygotesLock:
+		for entry in zygotes.values():
+			if entry.get('zygote') is not None:
+				entry['zygote'].close()
+		zygotes.clear()
+
+atexit.register(closeAll)
@@ -45,6 +45,7 @@
 # of the files; it doesn't generate them.
 
 from builtin_function import *
+from generator_util import *
 import abc
 import numpy
 import optparse
@@ -459,7 +460,7 @@ class ShaderTest(object):
 		self.test_prefix(), self._signature.name, argtype_names,
 		self._comparator.testname_suffix()))
 
-    def generate_shader_test(self):
+    def generate(self):
 	"""Generate the test and write it to the output file."""
 	shader_test = '[require]\n'
 	shader_test += 'GLSL >= {0:1.2f}\n'.format(float(self.glsl_version()) / 100)
@@ -473,12 +474,7 @@ class ShaderTest(object):
         shader_test += self.make_vbo_data()
 	shader_test += '[test]\n'
 	shader_test += self.make_test()
-	filename = self.filename()
-	dirname = os.path.dirname(filename)
-	if not os.path.exists(dirname):
-	    os.makedirs(dirname)
-	with open(filename, 'w') as f:
-	    f.write(shader_test)
+	return write_if_changed(self.filename(), shader_test)
 
 
 
@@ -554,16 +550,18 @@ def all_tests():
 
 def main():
     desc = 'Generate shader tests that test built-in functions using uniforms'
-    usage = 'usage: %prog [-h] [--names-only]'
+    usage = 'usage: %prog [-h] [--names-only] [-j JOBS]'
     parser = optparse.OptionParser(description=desc, usage=usage)
     parser.add_option(
 	'--names-only', dest='names_only', action='store_true',
 	help="Don't output files, just generate a list of filenames to stdout")
+    add_jobs_option(parser)
     options, args = parser.parse_args()
-    for test in all_tests():
-	if not options.names_only:
-	    test.generate_shader_test()
-	print test.filename()
+    if options.names_only:
+	for test in all_tests():
+	    print test.filename()
+    else:
+	generate_tests(all_tests, options.jobs)
 
 
 
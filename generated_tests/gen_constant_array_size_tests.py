@@ -35,6 +35,7 @@
 # of the files; it doesn't generate them.
 
 from builtin_function import *
+from generator_util import *
 import abc
 import optparse
 import os
@@ -156,7 +157,7 @@ class ParserTest(object):
 	    '{0}-{1}.{2}'.format(
 		self.__signature.name, argtype_names, self.test_suffix()))
 
-    def generate_parser_test(self):
+    def generate(self):
 	"""Generate the test and write it to the output file."""
 	parser_test = '/* [config]\n'
 	parser_test += ' * expect_result: pass\n'
@@ -171,12 +172,7 @@ class ParserTest(object):
 		glsl_constant(test_vector.result))
 	parser_test += ' */\n'
 	parser_test += self.make_shader()
-	filename = self.filename()
-	dirname = os.path.dirname(filename)
-	if not os.path.exists(dirname):
-	    os.makedirs(dirname)
-	with open(filename, 'w') as f:
-	    f.write(parser_test)
+	return write_if_changed(self.filename(), parser_test)
 
 
 
@@ -213,16 +209,18 @@ def all_tests():
 
 def main():
     desc = 'Generate shader tests that test built-in functions using constant array sizes'
-    usage = 'usage: %prog [-h] [--names-only]'
+    usage = 'usage: %prog [-h] [--names-only] [-j JOBS]'
     parser = optparse.OptionParser(description=desc, usage=usage)
     parser.add_option(
 	'--names-only', dest='names_only', action='store_true',
 	help="Don't output files, just generate a list of filenames to stdout")
+    add_jobs_option(parser)
     options, args = parser.parse_args()
-    for test in all_tests():
-	if not options.names_only:
-	    test.generate_parser_test()
-	print test.filename()
+    if options.names_only:
+	for test in all_tests():
+	    print test.filename()
+    else:
+	generate_tests(all_tests, options.jobs)
 
 
 
@@ -64,6 +64,7 @@
 # This program outputs, to stdout, the name of each file it generates.
 
 import os
+from generator_util import *
 
 
 class Test(object):
@@ -325,12 +326,7 @@ class Test(object):
 	for x, y, r, g, b, a in self.probe_data():
 	    test += ('relative probe rgba ({0}, {1}) ({2}, {3}, {4}, {5})\n'
 		     .format(x, y, r, g, b, a))
-	filename = self.filename()
-	dirname = os.path.dirname(filename)
-	if not os.path.exists(dirname):
-	    os.makedirs(dirname)
-	with open(filename, 'w') as f:
-	    f.write(test)
+	return write_if_changed(self.filename(), test)
 
 
 def all_tests():
@@ -345,9 +341,7 @@ def all_tests():
 
 
 def main():
-    for test in all_tests():
-	test.generate()
-	print test.filename()
+    generate_tests(all_tests)
 
 
 if __name__ == '__main__':
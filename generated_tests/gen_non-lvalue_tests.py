@@ -22,6 +22,7 @@
 # DEALINGS IN THE SOFTWARE.
 
 import os
+from generator_util import *
 
 
 class Test(object):
@@ -137,12 +138,7 @@ void main()
                            var_as_vec4 = var_as_vec4,
                            mode = mode)
 
-        filename = self.filename()
-	dirname = os.path.dirname(filename)
-	if not os.path.exists(dirname):
-	    os.makedirs(dirname)
-	with open(filename, 'w') as f:
-	    f.write(test)
+        return write_if_changed(self.filename(), test)
 
 
 def all_tests():
@@ -154,9 +150,7 @@ def all_tests():
                               yield Test(type_name, op, usage, shader_target)
 
 def main():
-    for test in all_tests():
-	test.generate()
-	print test.filename()
+    generate_tests(all_tests)
 
 
 if __name__ == '__main__':
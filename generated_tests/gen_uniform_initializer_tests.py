@@ -23,6 +23,7 @@
 
 import os
 import os.path
+from generator_util import write_if_changed
 from mako.template import Template
 
 
@@ -103,12 +104,11 @@ def generate_tests(type_list, base_name, major, minor):
                 api_vectors.append((api_type, name, alt_numbers))
                 j = j + 1
 
-            f = open(test_file_name, "w")
-            f.write(Template(template).render(type_list = test_vectors,
-                                              api_types = api_vectors,
-                                              major = major,
-                                              minor = minor))
-            f.close()
+            write_if_changed(test_file_name,
+                             Template(template).render(type_list = test_vectors,
+                                                       api_types = api_vectors,
+                                                       major = major,
+                                                       minor = minor))
 
 
 def generate_array_tests(type_list, base_name, major, minor):
@@ -151,11 +151,10 @@ def generate_array_tests(type_list, base_name, major, minor):
             test_vectors.append((array_type, name, value))
             j = j + 1
 
-        f = open(test_file_name, "w")
-        f.write(Template(template).render(type_list = test_vectors,
-                                          major = major,
-                                          minor = minor))
-        f.close()
+        write_if_changed(test_file_name,
+                         Template(template).render(type_list = test_vectors,
+                                                   major = major,
+                                                   minor = minor))
 
 # These are a set of pseudo random values used by the number sequence
 # generator.  See get_value above.
@@ -0,0 +1,131 @@
+# coding=utf-8
+#
+# Copyright © 2012 Intel Corporation
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+
+# Helpers shared by the test generators in this directory.
+#
+# A generator describes each test as an object with a filename()
+# method and a generate() method that writes the test using
+# write_if_changed().  generate_tests() runs generate() for every test
+# across a pool of worker processes and prints the filenames, in
+# order, for the build system's file list.
+#
+# Since write_if_changed() leaves files whose contents haven't changed
+# alone, re-running a generator doesn't bump the mtimes of tests it
+# didn't modify, and doesn't invalidate anything keyed on them.
+
+import hashlib
+import multiprocessing
+import os
+import os.path
+
+
+def content_hash(contents):
+    return hashlib.sha1(contents).hexdigest()
+
+
+def file_hash(filename):
+    """Return the content hash of filename, or None if it can't be
+    read.
+    """
+    try:
+	with open(filename, 'r') as f:
+	    return content_hash(f.read())
+    except IOError:
+	return None
+
+
+def write_if_changed(filename, contents):
+    """Write contents to filename, unless the file already holds
+    exactly those contents.  Return True if the file was written.
+    """
+    if file_hash(filename) == content_hash(contents):
+	return False
+    dirname = os.path.dirname(filename)
+    if dirname and not os.path.isdir(dirname):
+	try:
+	    os.makedirs(dirname)
+	except OSError:
+	    # Another worker may have created it in the meantime.
+	    if not os.path.isdir(dirname):
+		raise
+    with open(filename, 'w') as f:
+	f.write(contents)
+    return True
+
+
+def add_jobs_option(parser):
+    """Add a -j/--jobs option to an optparse.OptionParser."""
+    parser.add_option(
+	'-j', '--jobs', dest='jobs', type='int', default=None,
+	help='Number of worker processes (default: one per CPU)')
+
+
+# The tests being generated.  Worker processes forked from the parent
+# inherit this; on platforms without fork(), each worker rebuilds it by
+# calling the generator's all_tests() function again.
+_tests = None
+
+
+def _init_worker(all_tests):
+    global _tests
+    if _tests is None:
+	_tests = list(all_tests())
+
+
+def _generate(index):
+    return _tests[index].generate()
+
+
+def generate_tests(all_tests, jobs=None):
+    """Generate every test yielded by all_tests(), using up to jobs
+    worker processes, and print each test's filename.
+
+    all_tests must be a module-level function, so that it can be
+    passed to worker processes.
+    """
+    global _tests
+    _tests = list(all_tests())
+
+    if jobs is None:
+	try:
+	    jobs = multiprocessing.cpu_count()
+	except NotImplementedError:
+	    jobs = 1
+    jobs = max(1, min(jobs, len(_tests)))
+
+    if jobs == 1:
+	for test in _tests:
+	    test.generate()
+    else:
+	pool = multiprocessing.Pool(jobs, _init_worker, (all_tests,))
+	try:
+	    # Tests are cheap to generate individually, so hand them
+	    # out in chunks to keep the IPC overhead down.
+	    chunksize = max(1, len(_tests) // (jobs * 8))
+	    pool.map(_generate, range(len(_tests)), chunksize)
+	finally:
+	    pool.close()
+	    pool.join()
+
+    for test in _tests:
+	print test.filename()
@@ -0,0 +1,104 @@
+#!/usr/bin/env python
+#
+# Permission is hereby granted, free of charge, to any person
+# obtaining a copy of this software and associated documentation
+# files (the "Software"), to deal in the Software without
+# restriction, including without limitation the rights to use,
+# copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following
+# conditions:
+#
+# This permission notice shall be included in all copies or
+# substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY
+# KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+# WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+# PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHOR(S) BE
+# LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+# AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+# OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+
+
+from getopt import getopt, GetoptError
+from cStringIO import StringIO
+import os.path as path
+import sys, os
+
+#############################################################################
+##### Main program
+#############################################################################
+def usage():
+	USAGE = """\
+Usage: %(progName)s [options] [profile.tests] [profile.manifest]
+
+Load a test profile and write a manifest of its tests, which
+piglit-run.py can load in place of the profile without executing it.
+The manifest is only rewritten if its contents change.
+
+Options:
+  -h, --help                Show this message
+  -b dir, --build-dir=dir   Take test binaries and generated tests from
+                            the build directory dir, like PIGLIT_BUILD_DIR
+Example:
+  %(progName)s tests/all.tests tests/all.manifest
+  piglit-run.py -t ^glean/ tests/all.manifest results/glean
+         Write a manifest of all.tests, then run the glean tests in it
+"""
+	print USAGE % {'progName': sys.argv[0]}
+	sys.exit(1)
+
+def main():
+	try:
+		option_list = [
+			 "help",
+			 "build-dir=",
+			 ]
+		options, args = getopt(sys.argv[1:], "hb:", option_list)
+	except GetoptError:
+		usage()
+
+	for name, value in options:
+		if name in ('-h', '--help'):
+			usage()
+		elif name in ('-b', '--build-dir'):
+			os.environ['PIGLIT_BUILD_DIR'] = path.realpath(value)
+
+	if len(args) != 2:
+		usage()
+
+	profileFilename = args[0]
+	manifestFilename = path.realpath(args[1])
+
+	# testBinDir is computed when the framework is imported, so this
+	# has to wait until PIGLIT_BUILD_DIR is set.
+	sys.path.append(path.dirname(path.realpath(sys.argv[0])))
+	import framework.core as core
+
+	# Change to the piglit's path
+	piglit_dir = path.dirname(path.realpath(sys.argv[0]))
+	os.chdir(piglit_dir)
+
+	profile = core.loadTestProfile(profileFilename, core.MANIFEST_RES_DIR)
+
+	manifest = StringIO()
+	core.writeTestManifest(profile, manifest)
+	manifest = manifest.getvalue()
+
+	# Leave an up to date manifest alone, so that its mtime only
+	# changes when the test list does.
+	try:
+		with open(manifestFilename, 'r') as f:
+			if f.read() == manifest:
+				return
+	except IOError:
+		pass
+
+	core.checkDir(path.dirname(manifestFilename), False)
+	with open(manifestFilename, 'w') as f:
+		f.write(manifest)
+
+if __name__ == "__main__":
+	main()
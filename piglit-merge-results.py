@@ -23,6 +23,7 @@
 
 
 from getopt import getopt, GetoptError
+import heapq
 import sys, os.path
 
 sys.path.append(os.path.dirname(os.path.realpath(sys.argv[0])))
@@ -30,15 +31,89 @@ import framework.core as core
 
 
 
+def taggedSpans(reader, index):
+	for (path, start, end) in reader.testSpans():
+		yield (path, index, start, end)
+
+def mergedSpans(readers):
+	'''
+	Merge the sorted test lists of all readers, and yield
+	(path, reader index, start, end) once per path.  When several
+	results files have the same test, the last one on the command line
+	wins.
+	'''
+	current = None
+	streams = [taggedSpans(r, i) for (i, r) in enumerate(readers)]
+	for span in heapq.merge(*streams):
+		if current is not None and span[0] != current[0]:
+			yield current
+		current = span
+	if current is not None:
+		yield current
+
+def verifyShards(readers):
+	'''
+	If the results come from a sharded run, check that all shards of
+	the same partition are present and that each one has a result for
+	every test it was given.  Print what is wrong to stderr and return
+	False otherwise.
+	'''
+	shards = [r.options.get('shard') for r in readers]
+	if not [s for s in shards if s]:
+		return True
+
+	errors = []
+	if None in shards:
+		errors.append('sharded and unsharded results cannot be merged')
+	else:
+		first = shards[0]
+		for (reader, shard) in zip(readers, shards):
+			if shard['count'] != first['count'] or \
+			   shard['partition'] != first['partition']:
+				errors.append('%s is from a different sharding '
+					      'of the tests' % reader.filename)
+
+		indexes = [s['index'] for s in shards]
+		for i in range(1, first['count'] + 1):
+			if indexes.count(i) == 0:
+				errors.append('shard %d/%d is missing' %
+					      (i, first['count']))
+			elif indexes.count(i) > 1:
+				errors.append('shard %d/%d is given more '
+					      'than once' % (i, first['count']))
+
+		for (reader, shard) in zip(readers, shards):
+			present = set(reader.testNames())
+			missing = [t for t in shard['tests'] if t not in present]
+			if missing:
+				errors.append('%s lacks %d of its %d tests, '
+					      'e.g. %s' % (reader.filename,
+					      len(missing), len(shard['tests']),
+					      ', '.join(missing[:3])))
+
+	for error in errors:
+		print >>sys.stderr, 'Error: ' + error
+	return not errors
+
 #############################################################################
 ##### Main program
 #############################################################################
 def usage():
 	USAGE = """\
-Usage: %(progName)s [options] [main results file]
+Usage: %(progName)s [options] [main results file] [results file]...
 
 Options:
   -h, --help                Show this message
+  -f, --force               Merge the results of a sharded run even if
+                            shards or tests are missing
+
+The results are merged test by test, so the whole of each results file
+never needs to be in memory at once.  Test results in later files replace
+those of the same test in earlier files; everything else comes from the
+first file.
+
+Results of a run split with piglit-run.py --shard are checked to contain
+every shard, each with all of its tests.
 
 Example:
   %(progName)s results/main > results/summary
@@ -50,29 +125,48 @@ def main():
 	env = core.Environment()
 
 	try:
-		options, args = getopt(sys.argv[1:], "h", [ "help" ])
+		options, args = getopt(sys.argv[1:], "hf", [ "help", "force" ])
 	except GetoptError:
 		usage()
 
 	OptionName = ''
+	OptionForce = False
 
 	for name, value in options:
 		if name in ('-h', '--help'):
 			usage()
+		elif name in ('-f', '--force'):
+			OptionForce = True
 
 	if len(args) < 2:
 		usage()
 
-	combined = core.loadTestResults(args[0])
-	del args[0]
+	readers = [core.TestrunResultReader(path) for path in args]
+	if not verifyShards(readers) and not OptionForce:
+		sys.exit(1)
+
+	# The merged results are no longer one shard.
+	items = dict(readers[0].items)
+	if 'shard' in items.get('options', {}):
+		items['options'] = dict(items['options'])
+		del items['options']['shard']
+
+	json_writer = core.JSONWriter(sys.stdout)
+	json_writer.open_dict()
+	for (key, value) in sorted(items.items()):
+		json_writer.write_dict_item(key, value)
 
-	for resultsDir in args:
-		results = core.loadTestResults(resultsDir)
+	json_writer.write_dict_key('tests')
+	json_writer.open_dict()
+	for (path, index, start, end) in mergedSpans(readers):
+		json_writer.write_dict_item(path,
+			readers[index].readTest(start, end))
+	json_writer.close_dict()
 
-		for testname, result in results.tests.items():
-			combined.tests[testname] = result
+	json_writer.close_dict()
 
-	combined.write(sys.stdout)
+	for reader in readers:
+		reader.close()
 
 
 if __name__ == "__main__":
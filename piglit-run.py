@@ -32,6 +32,8 @@ import json
 
 sys.path.append(path.dirname(path.realpath(sys.argv[0])))
 import framework.core as core
+from framework.exectest import ExecTest
+from framework.threads import MemoryBudget, ThreadBudget
 from framework.threads import synchronized_self
 
 #############################################################################
@@ -53,6 +55,31 @@ Options:
   -c bool, --concurrent=bool  Enable/disable concurrent test runs. Valid
 			      option values are: 0, 1, on, off.  (default: on)
   --valgrind                Run tests in valgrind's memcheck.
+  -z, --zygote              Fork repeated runs of a test executable from
+                            a copy of it that has already started up.
+                            Libraries named in the colon-separated
+                            PIGLIT_ZYGOTE_PRELOAD, e.g. the DRI driver,
+                            are loaded before forking too.  With Mesa,
+                            that is where most of the saving comes from.
+  --shard=i/N               Run only the i-th of N parts of the test list.
+                            Every part takes about the same time if
+                            --shard-times is given.
+  --shard-times=results     Balance shards using the test times stored in
+                            a previous results file
+  --memory-budget=size      Don't start tests whose expected memory use,
+                            with that of the tests already running, is
+                            more than size bytes (with suffix K, M or G),
+                            or than a percentage of physical memory, e.g.
+                            50%%.  0 disables it.  (default: 75%%)
+  --memory-hints=results    Expect each test to use as much memory as it
+                            did in a previous results file
+  --threads-per-test=n      Give each concurrently running test n CPUs
+                            of its own, and tell drivers like llvmpipe to
+                            start that many threads.  'auto' picks n by
+                            the tests finished per second, 'off' leaves
+                            tests to share all CPUs.  Tests that run on
+                            their own are never restricted.
+                            (default: off)
 Example:
   %(progName)s tests/all.tests results/all
          Run all tests, store the results in the directory results/all
@@ -64,6 +91,18 @@ Example:
          Run all tests that are in the 'glean' group or whose path contains
 		 the substring 'tex'
 
+  %(progName)s tests/all.manifest results/all
+         Run all tests in a manifest written by piglit-manifest.py, which
+         loads much faster than the profile it was made from
+
+  %(progName)s --shard=2/4 --shard-times=results/last tests/all.tests results/all-2
+         Run the second quarter of all tests, by run time; merge the four
+         shards with piglit-merge-results.py
+
+  %(progName)s -c on --memory-hints=results/last tests/all.tests results/all
+         Run all tests, as many at a time as fit in 75%% of physical
+         memory by their use in the previous run
+
   %(progName)s -r -x bad-test results/all
          Resume an interrupted test run whose results are stored in the
          directory results/all, skipping bad-test.
@@ -71,6 +110,31 @@ Example:
 	print USAGE % {'progName': sys.argv[0]}
 	sys.exit(1)
 
+def physicalMemory():
+	try:
+		return os.sysconf('SC_PHYS_PAGES') * os.sysconf('SC_PAGE_SIZE')
+	except (AttributeError, ValueError, OSError):
+		return None
+
+def parseMemorySize(value):
+	'''
+	Return the number of bytes that a --memory-budget value means, or
+	None if there is no limit.
+	'''
+	m = re.match(r'^(\d+)([KMG%]?)$', value.upper())
+	if m is None:
+		print "--memory-budget expects a size or a percentage."
+		usage()
+	size = int(m.group(1))
+	if m.group(2) == '%':
+		memory = physicalMemory()
+		if memory is None:
+			return None
+		size = memory * size / 100
+	else:
+		size <<= {'': 0, 'K': 10, 'M': 20, 'G': 30}[m.group(2)]
+	return size or None
+
 def main():
 	env = core.Environment()
 
@@ -80,17 +144,25 @@ def main():
 			 "dry-run",
 			 "resume",
 			 "valgrind",
+			 "zygote",
 			 "tests=",
 			 "name=",
 			 "exclude-tests=",
 			 "concurrent=",
+			 "shard=",
+			 "shard-times=",
+			 "memory-budget=",
+			 "memory-hints=",
+			 "threads-per-test=",
 			 ]
-		options, args = getopt(sys.argv[1:], "hdrt:n:x:c:", option_list)
+		options, args = getopt(sys.argv[1:], "hdrzt:n:x:c:", option_list)
 	except GetoptError:
 		usage()
 
 	OptionName = ''
 	OptionResume = False
+	memory_budget = '75%'
+	threads_per_test = 'off'
 	test_filter = []
 	exclude_filter = []
 
@@ -103,6 +175,8 @@ def main():
 			OptionResume = True
 		elif name in ('--valgrind'):
 			env.valgrind = True
+		elif name in ('-z', '--zygote'):
+			ExecTest.useZygotes = True
 		elif name in ('-t', '--tests'):
 			test_filter.append(value)
 			env.filter.append(re.compile(value))
@@ -118,10 +192,39 @@ def main():
 				env.concurrent = False
 			else:
 				usage()
+		elif name == '--shard':
+			m = re.match(r'^(\d+)/(\d+)$', value)
+			if m is None or not \
+			   1 <= int(m.group(1)) <= int(m.group(2)):
+				print "--shard expects i/N with 1 <= i <= N."
+				usage()
+			env.shard = {'index': int(m.group(1)),
+				     'count': int(m.group(2))}
+		elif name == '--shard-times':
+			env.shard_times = core.loadTestTimes(value)
+		elif name == '--memory-budget':
+			memory_budget = value
+		elif name == '--memory-hints':
+			env.memory_hints = core.loadTestMemory(value)
+		elif name == '--threads-per-test':
+			if not re.match(r'^([1-9]\d*|auto|off)$', value):
+				print "--threads-per-test expects a number, auto or off."
+				usage()
+			threads_per_test = value
+
+	memory_budget = parseMemorySize(memory_budget)
+	if memory_budget is not None:
+		env.memory_budget = MemoryBudget(memory_budget)
+
+	# Tests that run one at a time may use every CPU.
+	if env.concurrent and threads_per_test == 'auto':
+		ExecTest.threadBudget = ThreadBudget(1, tune=True)
+	elif env.concurrent and threads_per_test != 'off':
+		ExecTest.threadBudget = ThreadBudget(int(threads_per_test))
 
 	if OptionResume:
-		if test_filter or OptionName:
-			print "-r is not compatible with -t or -n."
+		if test_filter or OptionName or env.shard:
+			print "-r is not compatible with -t, -n or --shard."
 			usage()
 		if len(args) != 1:
 			usage()
@@ -136,6 +239,11 @@ def main():
 		for value in old_results.options['exclude_filter']:
 			exclude_filter.append(value)
 			env.exclude_filter.append(re.compile(value))
+		# Resume the same shard, with the test list it was given.
+		env.shard = old_results.options.get('shard')
+		# Don't run the tests that already have results.
+		for key in old_results.tests:
+			env.exclude_tests.add(key)
 	else:
 		if len(args) != 2:
 			usage()
@@ -157,6 +265,12 @@ def main():
 	else:
 		results.name = OptionName
 
+	profile = core.loadTestProfile(profileFilename, resultsDir)
+
+	# Prepare the test list up front, so that the shard's tests can be
+	# recorded in the options.
+	profile.prepare_test_list(env)
+
 	# Begin json.
 	result_filepath = os.path.join(resultsDir, 'main')
 	result_file = open(result_filepath, 'w')
@@ -171,23 +285,21 @@ def main():
 	result_file.write(json.dumps(test_filter))
 	json_writer.write_dict_key('exclude_filter')
 	result_file.write(json.dumps(exclude_filter))
+	if env.shard:
+		json_writer.write_dict_item('shard', env.shard)
 	json_writer.close_dict()
 
 	json_writer.write_dict_item('name', results.name)
 	for (key, value) in env.collectData().items():
 		json_writer.write_dict_item(key, value)
 
-	profile = core.loadTestProfile(profileFilename, resultsDir)
-
 	json_writer.write_dict_key('tests')
 	json_writer.open_dict()
 	# If resuming an interrupted test run, re-write all of the existing
-	# results since we clobbered the results file.  Also, exclude them
-	# from being run again.
+	# results since we clobbered the results file.
 	if OptionResume:
 		for (key, value) in old_results.tests.items():
 			json_writer.write_dict_item(key, value)
-			env.exclude_tests.add(key)
 
 	time_start = time.time()
 	profile.run(env, json_writer)
@@ -0,0 +1,335 @@
+#!/usr/bin/env python
+#
+# Permission is hereby granted, free of charge, to any person
+# obtaining a copy of this software and associated documentation
+# files (the "Software"), to deal in the Software without
+# restriction, including without limitation the rights to use,
+# copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following
+# conditions:
+#
+# This permission notice shall be included in all copies or
+# substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY
+# KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+# WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+# PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHOR(S) BE
+# LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+# AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+# OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+
+
+from getopt import getopt, GetoptError
+from threading import Lock, Thread
+import math
+import multiprocessing
+import os.path as path
+import re
+import subprocess
+import sys, os
+
+TABLE_HEADER = '# piglit shader compile latency table 1'
+COLUMNS = ['path', 'status', 'samples', 'compile', 'compile_mad',
+	   'link', 'link_mad']
+SHADER_EXTENSIONS = ('.shader_test', '.vert', '.geom', '.frag')
+
+# Files handed to one shader-compile-latency process.  Big enough to
+# amortize context creation, small enough that a crash loses little.
+CHUNK_SIZE = 20
+
+# Scale factors turning a MAD into the standard error of a median,
+# assuming normally distributed samples.
+MAD_TO_SIGMA = 1.4826
+MEDIAN_EFFICIENCY = 1.2533
+
+#############################################################################
+##### Running the corpus
+#############################################################################
+def findShaders(roots, include_filter, exclude_filter):
+	shaders = []
+	for root in roots:
+		for dirpath, dirnames, filenames in os.walk(root):
+			dirnames.sort()
+			for filename in sorted(filenames):
+				if not filename.endswith(SHADER_EXTENSIONS):
+					continue
+				name = path.join(dirpath, filename)
+				if include_filter and \
+				   not any(f.search(name) for f in include_filter):
+					continue
+				if any(f.search(name) for f in exclude_filter):
+					continue
+				shaders.append(name)
+	return shaders
+
+def runChunk(binary, repeat, files):
+	"""Run one shader-compile-latency process and return a dict mapping
+	each file it reported on to its row."""
+	command = [binary, '-auto', '-fbo', '-repeat', str(repeat)] + files
+	try:
+		proc = subprocess.Popen(command, stdout=subprocess.PIPE,
+					stderr=subprocess.PIPE)
+		out, err = proc.communicate()
+	except OSError, e:
+		print >>sys.stderr, 'Failed to run %s: %s' % (binary, e)
+		sys.exit(1)
+
+	rows = {}
+	for line in out.splitlines():
+		fields = line.split('\t')
+		if fields[0] != 'shader' or len(fields) != len(COLUMNS) + 1:
+			continue
+		rows[fields[1]] = fields[1:]
+	return rows
+
+def runCorpus(binary, shaders, repeat, jobs):
+	chunks = [shaders[i:i + CHUNK_SIZE]
+		  for i in range(0, len(shaders), CHUNK_SIZE)]
+	rows = {}
+	lock = Lock()
+
+	def worker():
+		while True:
+			with lock:
+				if not chunks:
+					return
+				chunk = chunks.pop(0)
+			result = runChunk(binary, repeat, chunk)
+
+			# A crash takes the rest of its chunk with it, so give
+			# every file that went missing a process of its own.
+			for name in chunk:
+				if name not in result:
+					single = runChunk(binary, repeat, [name])
+					result[name] = single.get(name,
+						[name, 'crash', '0', '-', '-', '-', '-'])
+
+			with lock:
+				rows.update(result)
+				sys.stdout.write('\r%d/%d shaders' %
+						 (len(rows), len(shaders)))
+				sys.stdout.flush()
+
+	threads = [Thread(target=worker) for i in range(jobs)]
+	for t in threads:
+		t.start()
+	for t in threads:
+		t.join()
+	print
+
+	return [rows[name] for name in sorted(rows)]
+
+def writeTable(filename, rows):
+	with open(filename, 'w') as f:
+		f.write(TABLE_HEADER + '\n')
+		f.write('# ' + '\t'.join(COLUMNS) + '\n')
+		for row in rows:
+			f.write('\t'.join(row) + '\n')
+
+def readTable(filename):
+	rows = {}
+	with open(filename, 'r') as f:
+		if f.readline().rstrip('\n') != TABLE_HEADER:
+			print >>sys.stderr, '%s is not a shader compile ' \
+				'latency table' % filename
+			sys.exit(1)
+		for line in f:
+			if line.startswith('#'):
+				continue
+			fields = line.rstrip('\n').split('\t')
+			if len(fields) == len(COLUMNS):
+				rows[fields[0]] = dict(zip(COLUMNS, fields))
+	return rows
+
+def percentile(sorted_values, p):
+	if not sorted_values:
+		return 0.0
+	pos = p * (len(sorted_values) - 1)
+	i = int(pos)
+	if i + 1 >= len(sorted_values):
+		return sorted_values[-1]
+	return sorted_values[i] + (pos - i) * \
+		(sorted_values[i + 1] - sorted_values[i])
+
+def printSummary(rows):
+	statuses = {}
+	for row in rows:
+		statuses[row[1]] = statuses.get(row[1], 0) + 1
+	print 'Shaders: %d (%s)' % (len(rows), ', '.join(
+		'%d %s' % (statuses[s], s) for s in sorted(statuses)))
+
+	for column, title in ((3, 'Compile'), (5, 'Link')):
+		values = sorted(float(row[column]) for row in rows
+				if row[column] != '-')
+		if not values:
+			continue
+		print '%-8s p50 %8.3f ms  p90 %8.3f ms  p99 %8.3f ms  ' \
+			'max %8.3f ms  total %.3f s' % (title,
+			1e3 * percentile(values, 0.5),
+			1e3 * percentile(values, 0.9),
+			1e3 * percentile(values, 0.99),
+			1e3 * values[-1], sum(values))
+
+#############################################################################
+##### Comparing tables
+#############################################################################
+def standardError(mad, samples):
+	return MAD_TO_SIGMA * MEDIAN_EFFICIENCY * mad / math.sqrt(samples)
+
+def compareTimes(old, new, key, threshold, min_z):
+	"""Return (slowdown, z) if new[key] is significantly slower than
+	old[key], otherwise None."""
+	if old[key] == '-' or new[key] == '-':
+		return None
+	m1, m2 = float(old[key]), float(new[key])
+	if m1 <= 0.0 or m2 / m1 - 1.0 <= threshold:
+		return None
+
+	se1 = standardError(float(old[key + '_mad']), int(old['samples']))
+	se2 = standardError(float(new[key + '_mad']), int(new['samples']))
+	se = math.sqrt(se1 * se1 + se2 * se2)
+	z = (m2 - m1) / se if se > 0.0 else float('inf')
+	if z <= min_z:
+		return None
+	return (m2 / m1 - 1.0, z)
+
+def compareTables(old_filename, new_filename, threshold, min_z):
+	old = readTable(old_filename)
+	new = readTable(new_filename)
+
+	regressions = []
+	for name in sorted(set(old) & set(new)):
+		if old[name]['status'] != new[name]['status']:
+			print '%s: status changed from %s to %s' % \
+				(name, old[name]['status'], new[name]['status'])
+			continue
+		for key in ('compile', 'link'):
+			slower = compareTimes(old[name], new[name], key,
+					      threshold, min_z)
+			if slower:
+				regressions.append((slower[0], name, key,
+						    old[name][key],
+						    new[name][key], slower[1]))
+
+	regressions.sort(reverse=True)
+	for slowdown, name, key, t1, t2, z in regressions:
+		print '%s: %s %.3f ms -> %.3f ms (+%.1f%%, z = %.1f)' % \
+			(name, key, 1e3 * float(t1), 1e3 * float(t2),
+			 100.0 * slowdown, z)
+
+	print '%d shaders compared, %d significant slowdowns' % \
+		(len(set(old) & set(new)), len(regressions))
+	return len(regressions) == 0
+
+#############################################################################
+##### Main program
+#############################################################################
+def usage():
+	USAGE = """\
+Usage: %(progName)s [options] run [table]
+       %(progName)s [options] compare [old table] [new table]
+
+Time the GLSL compiler and linker on every shader_runner script and
+glslparsertest shader in the tree, or compare two such timing tables.
+
+run writes a table with the median compile and link times of each
+shader, and prints percentiles over the whole corpus.  compare lists
+the shaders whose compile or link time got slower by more than the
+threshold, where the difference is also statistically significant.
+It exits with status 1 if there are any.
+
+Options:
+  -h, --help                Show this message
+  -t regexp, --tests=regexp Only time shaders whose path matches regexp
+                            (can be used more than once)
+  -x regexp, --exclude-tests=regexp
+                            Skip shaders whose path matches regexp
+                            (can be used more than once)
+  -j n, --jobs=n            Run n processes in parallel (default: the
+                            number of CPUs)
+  -r n, --repeat=n          Compile each shader n times (default: 5)
+  --threshold=percent       Ignore slowdowns smaller than percent
+                            (default: 5)
+Example:
+  %(progName)s run before.tsv
+  %(progName)s run after.tsv
+  %(progName)s compare before.tsv after.tsv
+"""
+	print USAGE % {'progName': sys.argv[0]}
+	sys.exit(1)
+
+def main():
+	try:
+		option_list = [
+			 "help",
+			 "tests=",
+			 "exclude-tests=",
+			 "jobs=",
+			 "repeat=",
+			 "threshold=",
+			 ]
+		options, args = getopt(sys.argv[1:], "ht:x:j:r:", option_list)
+	except GetoptError:
+		usage()
+
+	include_filter = []
+	exclude_filter = []
+	jobs = multiprocessing.cpu_count()
+	repeat = 5
+	threshold = 5.0
+	try:
+		for name, value in options:
+			if name in ('-h', '--help'):
+				usage()
+			elif name in ('-t', '--tests'):
+				include_filter.append(re.compile(value))
+			elif name in ('-x', '--exclude-tests'):
+				exclude_filter.append(re.compile(value))
+			elif name in ('-j', '--jobs'):
+				jobs = max(int(value), 1)
+			elif name in ('-r', '--repeat'):
+				repeat = max(int(value), 1)
+			elif name == '--threshold':
+				threshold = float(value)
+	except ValueError:
+		usage()
+
+	if len(args) == 3 and args[0] == 'compare':
+		if not compareTables(args[1], args[2], threshold / 100.0, 3.0):
+			sys.exit(1)
+		return
+
+	if len(args) != 2 or args[0] != 'run':
+		usage()
+
+	tableFilename = path.realpath(args[1])
+
+	sys.path.append(path.dirname(path.realpath(sys.argv[0])))
+	import framework.core as core
+
+	# Change to the piglit's path
+	piglit_dir = path.dirname(path.realpath(sys.argv[0]))
+	os.chdir(piglit_dir)
+
+	roots = ['tests']
+	if 'PIGLIT_BUILD_DIR' in os.environ:
+		roots.append(path.join(os.environ['PIGLIT_BUILD_DIR'],
+				       'generated_tests'))
+	else:
+		roots.append('generated_tests')
+
+	shaders = findShaders(roots, include_filter, exclude_filter)
+	if not shaders:
+		print 'No shaders found'
+		sys.exit(1)
+
+	binary = path.join(core.testBinDir, 'shader-compile-latency')
+	rows = runCorpus(binary, shaders, repeat, jobs)
+	writeTable(tableFilename, rows)
+	printSummary(rows)
+
+if __name__ == "__main__":
+	main()
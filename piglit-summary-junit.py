@@ -29,7 +29,6 @@ import os
 import sys
 
 import framework.core
-import framework.summary
 from framework import junit
 
 
@@ -40,28 +39,26 @@ class Writer:
 		self.path = []
 
 	def write(self, arg):
-		results = [framework.core.loadTestResults(arg)]
-		summary = framework.summary.Summary(results)
+		# Results are read one test at a time, in path order, so that
+		# each suite is opened exactly once.
+		reader = framework.core.TestrunResultReader(arg)
 
 		self.report.start()
 		self.report.startSuite('piglit')
 		try:
-			for test in summary.allTests():
-				self.write_test(summary, test)
+			for (path, result) in reader.iterTests():
+				self.write_test(path, result)
 		finally:
 			self.enter_path([])
 			self.report.stopSuite()
 			self.report.stop()
+			reader.close()
 
-	def write_test(self, summary, test):
-		test_path = test.path.split('/')
+	def write_test(self, path, result):
+		test_path = path.split('/')
 		test_name = test_path.pop()
 		self.enter_path(test_path)
 
-		assert len(summary.testruns) == 1
-		tr = summary.testruns[0]
-		result = test.results[0]
-
 		self.report.startCase(test_name)
 		duration = None
 		try:
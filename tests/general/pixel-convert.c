@@ -0,0 +1,426 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file pixel-convert.c
+ *
+ * Check piglit's client pixel conversion library (piglit-pixel-convert.h)
+ * without GL.
+ *
+ * Every packed type, GL_UNSIGNED_INT_5_9_9_9_REV and
+ * GL_UNSIGNED_INT_10F_11F_11F_REV is unpacked and compared against a
+ * decoder written here, then packed again, which must give back the same
+ * encoding.  The 8- and 16-bit types are checked exhaustively, the 32-bit
+ * ones on a sample of encodings.  The vectorized paths for RGBA pixels
+ * are compared against converting one pixel at a time, which takes the
+ * scalar path.
+ */
+
+#include "piglit-util-gl-common.h"
+#include "piglit-pixel-convert.h"
+#include "rgb9e5.h"
+
+int piglit_width = 16, piglit_height = 16;
+int piglit_window_mode = GLUT_RGBA | GLUT_DOUBLE;
+
+/** Encodings of the 32-bit types that are checked. */
+#define NUM_SAMPLES 65536
+
+/** Mismatches to print per type before staying quiet. */
+#define MAX_REPORTS 5
+
+struct packed_type {
+	GLenum type;
+	const char *name;
+	unsigned bytes;
+	unsigned components;
+	/* Fields in RGBA order. */
+	unsigned shift[4];
+	unsigned bits[4];
+};
+
+static const struct packed_type packed_types[] = {
+	{ GL_UNSIGNED_BYTE_3_3_2, "GL_UNSIGNED_BYTE_3_3_2", 1, 3,
+	  { 5, 2, 0 }, { 3, 3, 2 } },
+	{ GL_UNSIGNED_BYTE_2_3_3_REV, "GL_UNSIGNED_BYTE_2_3_3_REV", 1, 3,
+	  { 0, 3, 6 }, { 3, 3, 2 } },
+	{ GL_UNSIGNED_SHORT_5_6_5, "GL_UNSIGNED_SHORT_5_6_5", 2, 3,
+	  { 11, 5, 0 }, { 5, 6, 5 } },
+	{ GL_UNSIGNED_SHORT_5_6_5_REV, "GL_UNSIGNED_SHORT_5_6_5_REV", 2, 3,
+	  { 0, 5, 11 }, { 5, 6, 5 } },
+	{ GL_UNSIGNED_SHORT_4_4_4_4, "GL_UNSIGNED_SHORT_4_4_4_4", 2, 4,
+	  { 12, 8, 4, 0 }, { 4, 4, 4, 4 } },
+	{ GL_UNSIGNED_SHORT_4_4_4_4_REV, "GL_UNSIGNED_SHORT_4_4_4_4_REV", 2, 4,
+	  { 0, 4, 8, 12 }, { 4, 4, 4, 4 } },
+	{ GL_UNSIGNED_SHORT_5_5_5_1, "GL_UNSIGNED_SHORT_5_5_5_1", 2, 4,
+	  { 11, 6, 1, 0 }, { 5, 5, 5, 1 } },
+	{ GL_UNSIGNED_SHORT_1_5_5_5_REV, "GL_UNSIGNED_SHORT_1_5_5_5_REV", 2, 4,
+	  { 0, 5, 10, 15 }, { 5, 5, 5, 1 } },
+	{ GL_UNSIGNED_INT_8_8_8_8, "GL_UNSIGNED_INT_8_8_8_8", 4, 4,
+	  { 24, 16, 8, 0 }, { 8, 8, 8, 8 } },
+	{ GL_UNSIGNED_INT_8_8_8_8_REV, "GL_UNSIGNED_INT_8_8_8_8_REV", 4, 4,
+	  { 0, 8, 16, 24 }, { 8, 8, 8, 8 } },
+	{ GL_UNSIGNED_INT_10_10_10_2, "GL_UNSIGNED_INT_10_10_10_2", 4, 4,
+	  { 22, 12, 2, 0 }, { 10, 10, 10, 2 } },
+	{ GL_UNSIGNED_INT_2_10_10_10_REV, "GL_UNSIGNED_INT_2_10_10_10_REV", 4, 4,
+	  { 0, 10, 20, 30 }, { 10, 10, 10, 2 } },
+};
+
+static unsigned reports;
+
+static bool
+report(const char *name, unsigned word, const char *what)
+{
+	if (reports++ < MAX_REPORTS)
+		printf("%s 0x%08x: %s\n", name, word, what);
+	return false;
+}
+
+static unsigned
+read_word(const void *p, unsigned bytes)
+{
+	switch (bytes) {
+	case 1:
+		return *(const GLubyte *) p;
+	case 2:
+		return *(const GLushort *) p;
+	default:
+		return *(const GLuint *) p;
+	}
+}
+
+static void
+write_word(void *p, unsigned bytes, unsigned word)
+{
+	switch (bytes) {
+	case 1:
+		*(GLubyte *) p = word;
+		break;
+	case 2:
+		*(GLushort *) p = word;
+		break;
+	default:
+		*(GLuint *) p = word;
+		break;
+	}
+}
+
+/**
+ * The encodings of a type to check: all of them for 8- and 16-bit types,
+ * else the all-zero and all-one words and a pseudo-random sample.
+ */
+static unsigned
+encodings(unsigned bytes, unsigned *words)
+{
+	unsigned n, i, x = 1;
+
+	if (bytes < 4) {
+		n = 1u << (8 * bytes);
+		for (i = 0; i < n; i++)
+			words[i] = i;
+		return n;
+	}
+
+	words[0] = 0;
+	words[1] = 0xffffffff;
+	for (i = 2; i < NUM_SAMPLES; i++) {
+		/* xorshift32 */
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		words[i] = x;
+	}
+	return NUM_SAMPLES;
+}
+
+static bool
+check_packed(const struct packed_type *t, unsigned *words, float *rgba,
+	     void *data, void *repacked)
+{
+	const GLenum format = t->components == 3 ? GL_RGB : GL_RGBA;
+	const unsigned n = encodings(t->bytes, words);
+	bool pass = true;
+	unsigned i, c;
+
+	reports = 0;
+	for (i = 0; i < n; i++)
+		write_word((GLubyte *) data + i * t->bytes, t->bytes, words[i]);
+
+	if (!piglit_pixels_unpack(format, t->type, data, n, rgba) ||
+	    !piglit_pixels_pack(format, t->type, rgba, n, repacked)) {
+		printf("%s: not supported\n", t->name);
+		return false;
+	}
+
+	for (i = 0; i < n; i++) {
+		const float *px = rgba + 4 * i;
+
+		for (c = 0; c < 4; c++) {
+			float expected = 1.0f;
+
+			if (c < t->components) {
+				const unsigned max = (1u << t->bits[c]) - 1;
+
+				expected = (float) ((words[i] >> t->shift[c])
+						    & max) / max;
+			}
+			if (fabsf(px[c] - expected) > 1e-6f) {
+				pass = report(t->name, words[i],
+					      "unpacked wrong");
+				break;
+			}
+		}
+
+		if (read_word((GLubyte *) repacked + i * t->bytes, t->bytes) !=
+		    words[i])
+			pass = report(t->name, words[i],
+				      "didn't pack back to itself");
+	}
+
+	return pass;
+}
+
+/**
+ * Decode an unsigned float with a 5-bit exponent and \c mbits of
+ * mantissa, as in GL_UNSIGNED_INT_10F_11F_11F_REV.
+ */
+static float
+decode_ufloat(unsigned bits, unsigned mbits)
+{
+	const unsigned e = bits >> mbits;
+	const unsigned m = bits & ((1u << mbits) - 1);
+
+	if (e == 0)
+		return ldexp(m, -14 - (int) mbits);
+	if (e == 31)
+		return m ? NAN : INFINITY;
+	return ldexp((1u << mbits) + m, (int) e - 15 - (int) mbits);
+}
+
+static bool
+check_r11g11b10f(unsigned *words, float *rgba, GLuint *data,
+		 GLuint *repacked)
+{
+	static const unsigned shift[3] = { 0, 11, 22 };
+	static const unsigned mbits[3] = { 6, 6, 5 };
+	const char *name = "GL_UNSIGNED_INT_10F_11F_11F_REV";
+	const unsigned n = encodings(4, words);
+	bool pass = true;
+	unsigned i, c;
+
+	reports = 0;
+	memcpy(data, words, n * sizeof(GLuint));
+	if (!piglit_pixels_unpack(GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV,
+				  data, n, rgba) ||
+	    !piglit_pixels_pack(GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV,
+				rgba, n, repacked)) {
+		printf("%s: not supported\n", name);
+		return false;
+	}
+
+	for (i = 0; i < n; i++) {
+		bool finite = true;
+
+		for (c = 0; c < 3; c++) {
+			const unsigned bits = (words[i] >> shift[c]) &
+				((1u << (mbits[c] + 5)) - 1);
+			const float expected = decode_ufloat(bits, mbits[c]);
+			const float got = rgba[4 * i + c];
+
+			finite = finite && (bits >> mbits[c]) != 31;
+			if (isnan(expected) ? !isnan(got) : got != expected) {
+				pass = report(name, words[i],
+					      "unpacked wrong");
+				break;
+			}
+		}
+
+		/* NaNs and infinities needn't come back as the same
+		 * encoding, and two unused bits are dropped.
+		 */
+		if (finite && repacked[i] != words[i])
+			pass = report(name, words[i],
+				      "didn't pack back to itself");
+	}
+
+	return pass;
+}
+
+static bool
+check_rgb9e5(unsigned *words, float *rgba, GLuint *data, GLuint *repacked)
+{
+	const char *name = "GL_UNSIGNED_INT_5_9_9_9_REV";
+	const unsigned n = encodings(4, words);
+	float *again = malloc(4 * n * sizeof(float));
+	bool pass = true;
+	unsigned i, c;
+
+	reports = 0;
+	memcpy(data, words, n * sizeof(GLuint));
+	if (!piglit_pixels_unpack(GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV,
+				  data, n, rgba) ||
+	    !piglit_pixels_pack(GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV,
+				rgba, n, repacked) ||
+	    !piglit_pixels_unpack(GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV,
+				  repacked, n, again)) {
+		printf("%s: not supported\n", name);
+		free(again);
+		return false;
+	}
+
+	for (i = 0; i < n; i++) {
+		float expected[3];
+
+		rgb9e5_to_float3(words[i], expected);
+		for (c = 0; c < 3; c++) {
+			if (rgba[4 * i + c] != expected[c]) {
+				pass = report(name, words[i],
+					      "unpacked wrong");
+				break;
+			}
+		}
+
+		/* A value has several encodings with different shared
+		 * exponents, so only the value has to survive.
+		 */
+		for (c = 0; c < 3; c++) {
+			if (again[4 * i + c] != rgba[4 * i + c]) {
+				pass = report(name, words[i],
+					      "didn't pack back to itself");
+				break;
+			}
+		}
+	}
+
+	free(again);
+	return pass;
+}
+
+/**
+ * Convert \c n RGBA pixels in one call, which takes the vectorized path
+ * where there is one, and one pixel at a time, which doesn't, and
+ * compare.
+ */
+static bool
+check_fast_path(GLenum type, const char *name, const void *src,
+		const float *rgba, unsigned n)
+{
+	const unsigned size = piglit_pixels_size(GL_RGBA, type);
+	float *unpacked = malloc(4 * n * sizeof(float));
+	float *unpacked_one = malloc(4 * n * sizeof(float));
+	GLubyte *packed = malloc(n * size);
+	GLubyte *packed_one = malloc(n * size);
+	bool pass = true;
+	unsigned i;
+
+	reports = 0;
+	piglit_pixels_unpack(GL_RGBA, type, src, n, unpacked);
+	piglit_pixels_pack(GL_RGBA, type, rgba, n, packed);
+	for (i = 0; i < n; i++) {
+		piglit_pixels_unpack(GL_RGBA, type,
+				     (const GLubyte *) src + i * size, 1,
+				     unpacked_one + 4 * i);
+		piglit_pixels_pack(GL_RGBA, type, rgba + 4 * i, 1,
+				   packed_one + i * size);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (memcmp(unpacked + 4 * i, unpacked_one + 4 * i,
+			   4 * sizeof(float)) != 0)
+			pass = report(name, i, "unpacked differently");
+		if (memcmp(packed + i * size, packed_one + i * size,
+			   size) != 0)
+			pass = report(name, i, "packed differently");
+	}
+
+	free(unpacked);
+	free(unpacked_one);
+	free(packed);
+	free(packed_one);
+	return pass;
+}
+
+static bool
+check_fast_paths(void)
+{
+	/* Not a multiple of four, so that the vectorized loops leave a
+	 * tail to the scalar ones.
+	 */
+	const unsigned n = 1027;
+	GLubyte *ubytes = malloc(4 * n);
+	GLushort *halves = malloc(4 * n * sizeof(GLushort));
+	float *rgba = malloc(4 * n * sizeof(float));
+	bool pass = true;
+	unsigned i;
+
+	for (i = 0; i < 4 * n; i++) {
+		ubytes[i] = i * 7;
+		/* Finite halves of both signs. */
+		halves[i] = (i * 97) & 0xfbff;
+		/* Out of range too, to check the clamping. */
+		rgba[i] = (float) (i % 331) / 220.0f - 0.25f;
+	}
+
+	pass = check_fast_path(GL_UNSIGNED_BYTE, "GL_UNSIGNED_BYTE", ubytes,
+			       rgba, n) && pass;
+	pass = check_fast_path(GL_HALF_FLOAT, "GL_HALF_FLOAT", halves,
+			       rgba, n) && pass;
+	pass = check_fast_path(GL_FLOAT, "GL_FLOAT", rgba, rgba, n) && pass;
+
+	free(ubytes);
+	free(halves);
+	free(rgba);
+	return pass;
+}
+
+enum piglit_result
+piglit_display(void)
+{
+	/* UNREACHED */
+	return PIGLIT_FAIL;
+}
+
+void
+piglit_init(int argc, char **argv)
+{
+	unsigned *words = malloc(NUM_SAMPLES * sizeof(unsigned));
+	float *rgba = malloc(4 * NUM_SAMPLES * sizeof(float));
+	GLuint *data = malloc(NUM_SAMPLES * sizeof(GLuint));
+	GLuint *repacked = malloc(NUM_SAMPLES * sizeof(GLuint));
+	bool pass = true;
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(packed_types); i++)
+		pass = check_packed(&packed_types[i], words, rgba, data,
+				    repacked) && pass;
+	pass = check_r11g11b10f(words, rgba, data, repacked) && pass;
+	pass = check_rgb9e5(words, rgba, data, repacked) && pass;
+	pass = check_fast_paths() && pass;
+
+	free(words);
+	free(rgba);
+	free(data);
+	free(repacked);
+
+	piglit_report_result(pass ? PIGLIT_PASS : PIGLIT_FAIL);
+}
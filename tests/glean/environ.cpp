@@ -151,9 +151,9 @@ Environment::imageFileName(string& dbName, string& testName, int n) {
 	sn[1] = static_cast<char>('0' + (n / 10) % 10);
 	sn[0] = static_cast<char>('0' + (n / 100) % 10);
 #   if defined(__UNIX__)
-	string fileName(dbName + '/' + testName + "/i" + sn + ".tif");
+	string fileName(dbName + '/' + testName + "/i" + sn + ".raw");
 #   elif defined(__MS__)
-	string fileName(dbName + '/' + testName + "/i" + sn + ".tif");
+	string fileName(dbName + '/' + testName + "/i" + sn + ".raw");
 #   endif
 	return fileName;
 } // Environment::imageFileName
@@ -88,7 +88,7 @@ class Environment {
 	string imageFileName(string& dbName, string& testName, int n);
 				// Return name of image file number ``n''
 				// associated with the given test.  Suitable
-				// for use with Image::readTIFF(), etc.
+				// for use with Image::readRaw(), etc.
 				// XXX Doesn't create results directory,
 				// so resultFileName() must be called before
 				// using this.
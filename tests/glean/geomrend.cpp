@@ -247,11 +247,11 @@ bool GeomRenderer::renderPrimitives(GLenum mode)
         // Should we lock?
         if (compileArrays)
         {
-            PFNGLLOCKARRAYSEXTPROC glLockArraysEXT = 0;
+            PFNGLLOCKARRAYSEXTPROC lockArrays = 0;
             assert(GLUtils::haveExtension("GL_EXT_compiled_vertex_array"));
-            glLockArraysEXT = reinterpret_cast<PFNGLLOCKARRAYSEXTPROC>
+            lockArrays = reinterpret_cast<PFNGLLOCKARRAYSEXTPROC>
                 (GLUtils::getProcAddress("glLockArraysEXT"));
-            glLockArraysEXT(0, arrayLength);
+            lockArrays(0, arrayLength);
         }
 
         // Okay, arrays configured; what exactly are we doing?
@@ -277,11 +277,11 @@ bool GeomRenderer::renderPrimitives(GLenum mode)
         // Done.  If we locked, unlock.
         if (compileArrays)
         {
-            PFNGLUNLOCKARRAYSEXTPROC glUnlockArraysEXT = 0;
+            PFNGLUNLOCKARRAYSEXTPROC unlockArrays = 0;
             assert(GLUtils::haveExtension("GL_EXT_compiled_vertex_array"));
-            glUnlockArraysEXT = reinterpret_cast<PFNGLUNLOCKARRAYSEXTPROC>
+            unlockArrays = reinterpret_cast<PFNGLUNLOCKARRAYSEXTPROC>
                 (GLUtils::getProcAddress("glUnlockArraysEXT"));
-            glUnlockArraysEXT();
+            unlockArrays();
         }
     }
 
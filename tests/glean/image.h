@@ -233,7 +233,14 @@ class Image {
 	// XXX image difference
 	// XXX minmax, histogram, contrast stretch?
 
-	// TIFF I/O utilities:
+	// Raw dump I/O utilities (see tests/util/piglit-image-io.h):
+
+	void readRaw(const char* filename);
+	inline void readRaw(const std::string& s)  { readRaw(s.c_str()); }
+	void writeRaw(const char* filename);
+	inline void writeRaw(const std::string& s)  { writeRaw(s.c_str()); }
+
+	// TIFF I/O utilities (only when glean is built with libtiff):
 
 	void readTIFF(const char* filename);
 	inline void readTIFF(const std::string& s)  { readTIFF(s.c_str()); }
@@ -149,9 +149,21 @@ bool Image::operator==(const Image &img) const
 
 	const char *p1 = img1.pixels();
 	const char *p2 = img2.pixels();
-	const int n = img1.rowSizeInBytes() * img1.height();
-	if (memcmp(p1, p2, n) != 0)
-		return false;
+	const int rowSize = img1.rowSizeInBytes();
+	const int used = img1.width() * img1.pixelSizeInBytes();
+
+	// Without row padding, one memcmp covers the whole image.
+	// Otherwise the padding isn't part of the image (glReadPixels
+	// doesn't write it), so skip it.
+	if (used == rowSize)
+		return memcmp(p1, p2, rowSize * img1.height()) == 0;
+
+	for (int i = 0; i < img1.height(); ++i) {
+		if (memcmp(p1, p2, used) != 0)
+			return false;
+		p1 += rowSize;
+		p2 += rowSize;
+	}
 
 	return true;
 }
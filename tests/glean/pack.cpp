@@ -43,7 +43,7 @@ namespace {
 // templates) wouldn't compile under VC6, but this slight variant
 // using static member functions in a class template will compile.
 
-template<class component, int num, unsigned int denom, int bias>
+template<class component, unsigned int num, unsigned int denom, int bias>
 class Pack
 {
 public :
@@ -0,0 +1,88 @@
+// BEGIN_COPYRIGHT -*- glean -*-
+//
+// Copyright (C) 2012  Intel Corporation   All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use,
+// copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following
+// conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY
+// KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL INTEL BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+// AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// END_COPYRIGHT
+
+
+
+
+// Raw image dump I/O, using piglit's image writer
+
+#include <string.h>
+#include <algorithm>
+#include "image.h"
+#include "piglit-image-io.h"
+
+namespace GLEAN {
+
+///////////////////////////////////////////////////////////////////////////////
+// readRaw - read image from raw dump, set attributes to match the file
+///////////////////////////////////////////////////////////////////////////////
+void
+Image::readRaw(const char* filename) {
+	piglit_raw_image raw;
+	if (!piglit_map_raw_image(filename, &raw))
+		throw CantOpen(filename);
+
+	width(raw.header.width);
+	height(raw.header.height);
+	format(raw.header.format);
+	type(raw.header.type);
+
+	// The dump keeps glReadPixels' row padding, which need not
+	// match ours, so copy row by row.
+	try {
+		reserve();
+	} catch (...) {
+		piglit_unmap_raw_image(&raw);
+		throw;
+	}
+	GLsizei rowStep = rowSizeInBytes();
+	GLsizei rowBytes = std::min<GLsizei>(rowStep, raw.header.row_stride);
+	const char* src = static_cast<const char*>(raw.pixels);
+	char* dst = pixels();
+	for (GLsizei i = 0; i < height(); ++i) {
+		memcpy(dst, src, rowBytes);
+		src += raw.header.row_stride;
+		dst += rowStep;
+	}
+
+	piglit_unmap_raw_image(&raw);
+} // Image::readRaw
+
+///////////////////////////////////////////////////////////////////////////////
+// writeRaw - write image to raw dump
+///////////////////////////////////////////////////////////////////////////////
+void
+Image::writeRaw(const char* filename) {
+	// The background writer copies the pixels, so the image may be
+	// changed or destroyed as soon as this returns.  Errors are
+	// reported on stderr rather than thrown.
+	piglit_write_image_async(filename, width(), height(), format(),
+		type(), rowSizeInBytes(), pixels());
+} // Image::writeRaw
+
+}; // namespace GLEAN
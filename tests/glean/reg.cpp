@@ -32,10 +32,287 @@
 // Image registration.
 
 #include <cfloat>
+#include <vector>
 #include "image.h"
 
 #include <cmath>	// for fabs
 
+#if defined(__UNIX__)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace {
+
+using GLEAN::Image;
+using GLEAN::BasicStats;
+
+typedef unsigned long long SAD;
+
+// Registrations that compare at least this many samples in total are
+// split across threads.
+const double parallelThreshold = 1 << 20;
+const int maxThreads = 8;
+
+///////////////////////////////////////////////////////////////////////////////
+// Sum of absolute differences of n components.  The sums for 8- and
+// 16-bit components are exact, so the search for the best offset can be
+// done on the native data without unpacking it.
+///////////////////////////////////////////////////////////////////////////////
+SAD
+sumAbsDiff(const GLubyte* a, const GLubyte* b, int n) {
+	SAD sum = 0;
+	int i = 0;
+#ifdef __SSE2__
+	__m128i acc = _mm_setzero_si128();
+	for (; i + 16 <= n; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*) (b + i));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+	}
+	SAD lanes[2];
+	_mm_storeu_si128((__m128i*) lanes, acc);
+	sum = lanes[0] + lanes[1];
+#endif
+	for (; i < n; ++i)
+		sum += a[i] > b[i]? a[i] - b[i]: b[i] - a[i];
+	return sum;
+}
+
+SAD
+sumAbsDiff(const GLushort* a, const GLushort* b, int n) {
+	SAD sum = 0;
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	while (i + 8 <= n) {
+		// Each 32-bit lane gains at most 2 * 65535 per iteration,
+		// so flush to 64 bits well before that can overflow.
+		__m128i acc = _mm_setzero_si128();
+		int end = i + 8 * 8192;
+		for (; i + 8 <= n && i < end; i += 8) {
+			__m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+			__m128i vb = _mm_loadu_si128((const __m128i*) (b + i));
+			__m128i d = _mm_or_si128(_mm_subs_epu16(va, vb),
+						 _mm_subs_epu16(vb, va));
+			acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(d, zero));
+			acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(d, zero));
+		}
+		GLuint lanes[4];
+		_mm_storeu_si128((__m128i*) lanes, acc);
+		sum += (SAD) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+#endif
+	for (; i < n; ++i)
+		sum += a[i] > b[i]? a[i] - b[i]: b[i] - a[i];
+	return sum;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Work split across threads by rows.  The first job runs on the calling
+// thread.
+///////////////////////////////////////////////////////////////////////////////
+struct Job {
+	int firstRow;
+	int lastRow;		// exclusive
+	virtual void run() = 0;
+	virtual ~Job() { }
+};
+
+#if defined(__UNIX__)
+void*
+jobThread(void* job) {
+	static_cast<Job*>(job)->run();
+	return 0;
+}
+#endif
+
+int
+threadCount(double samples, int rows) {
+#if defined(__UNIX__)
+	if (samples >= parallelThreshold && rows > 1) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		int n = cpus < 1? 1: (cpus > maxThreads? maxThreads: cpus);
+		return n < rows? n: rows;
+	}
+#endif
+	return 1;
+}
+
+void
+splitRows(std::vector<Job*>& jobs, int rows) {
+	int n = jobs.size();
+	for (int t = 0; t < n; ++t) {
+		jobs[t]->firstRow = rows * t / n;
+		jobs[t]->lastRow = rows * (t + 1) / n;
+	}
+}
+
+void
+runJobs(std::vector<Job*>& jobs) {
+#if defined(__UNIX__)
+	std::vector<pthread_t> threads(jobs.size());
+	std::vector<bool> started(jobs.size(), false);
+	for (size_t t = 1; t < jobs.size(); ++t)
+		started[t] = pthread_create(&threads[t], 0, jobThread,
+					    jobs[t]) == 0;
+	jobs[0]->run();
+	for (size_t t = 1; t < jobs.size(); ++t) {
+		if (started[t])
+			pthread_join(threads[t], 0);
+		else
+			jobs[t]->run();
+	}
+#else
+	for (size_t t = 0; t < jobs.size(); ++t)
+		jobs[t]->run();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Search a range of vertical offsets for the one with the smallest sum of
+// absolute differences over all components.  When every stored component
+// counts equally in the unpacked RGBA pixel, which Image::reg checks, that
+// is the offset with the smallest sum of mean absolute errors.  Offsets that can no longer beat
+// the best one so far are abandoned early.  Ties go to the first offset in
+// row-major order, as in the generic registration below.
+///////////////////////////////////////////////////////////////////////////////
+template<class T>
+struct SearchJob: public Job {
+	Image* test;
+	Image* ref;
+	int dw;			// Difference in widths, in pixels.
+	SAD bestSAD;
+	int bestI;
+	int bestJ;
+
+	void run() {
+		const int comps = ref->pixelSizeInBytes() / sizeof(T);
+		const int n = ref->width() * comps;
+		const int hr = ref->height();
+		bestSAD = ~(SAD) 0;
+		bestI = bestJ = -1;
+
+		for (int i = firstRow; i < lastRow; ++i)
+			for (int j = 0; j <= dw; ++j) {
+				SAD sum = 0;
+				const char* refRow = ref->pixels();
+				const char* testRow = test->pixels()
+					+ i * test->rowSizeInBytes()
+					+ j * test->pixelSizeInBytes();
+				int y;
+				for (y = 0; y < hr && sum <= bestSAD; ++y) {
+					sum += sumAbsDiff(
+						reinterpret_cast<const T*>(refRow),
+						reinterpret_cast<const T*>(testRow),
+						n);
+					refRow += ref->rowSizeInBytes();
+					testRow += test->rowSizeInBytes();
+				}
+				if (sum < bestSAD) {
+					bestSAD = sum;
+					bestI = i;
+					bestJ = j;
+				}
+			}
+	}
+};
+
+template<class T>
+void
+searchOffset(Image& test, Image& ref, int dh, int dw, int& hOffset,
+    int& wOffset) {
+	double samples = (double) (dh + 1) * (dw + 1) * ref.width()
+		* ref.height() * (ref.pixelSizeInBytes() / sizeof(T));
+	int n = threadCount(samples, dh + 1);
+
+	std::vector<SearchJob<T> > search(n);
+	std::vector<Job*> jobs(n);
+	for (int t = 0; t < n; ++t) {
+		search[t].test = &test;
+		search[t].ref = &ref;
+		search[t].dw = dw;
+		jobs[t] = &search[t];
+	}
+	splitRows(jobs, dh + 1);
+	runJobs(jobs);
+
+	// The jobs cover increasing rows, so the first of equally good
+	// offsets wins here too.
+	SAD bestSAD = ~(SAD) 0;
+	for (int t = 0; t < n; ++t)
+		if (search[t].bestI >= 0 && search[t].bestSAD < bestSAD) {
+			bestSAD = search[t].bestSAD;
+			hOffset = search[t].bestI;
+			wOffset = search[t].bestJ;
+		}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gather the absolute error statistics of a range of reference image rows
+// at one offset.
+///////////////////////////////////////////////////////////////////////////////
+struct StatsJob: public Job {
+	Image* test;
+	Image* ref;
+	int hOffset;
+	int wOffset;
+	BasicStats stats[4];
+
+	void run() {
+		const int wr4 = 4 * ref->width();
+		std::vector<double> refPix(wr4);
+		std::vector<double> testPix(wr4);
+		char* refRow = ref->pixels() + firstRow * ref->rowSizeInBytes();
+		char* testRow = test->pixels()
+			+ (firstRow + hOffset) * test->rowSizeInBytes()
+			+ wOffset * test->pixelSizeInBytes();
+
+		for (int i = firstRow; i < lastRow; ++i) {
+			ref->unpack(ref->width(), &refPix[0], refRow);
+			test->unpack(ref->width(), &testPix[0], testRow);
+			refRow += ref->rowSizeInBytes();
+			testRow += test->rowSizeInBytes();
+
+			for (int m = 0; m < wr4; m += 4) {
+				stats[0].sample(fabs(refPix[m+0] - testPix[m+0]));
+				stats[1].sample(fabs(refPix[m+1] - testPix[m+1]));
+				stats[2].sample(fabs(refPix[m+2] - testPix[m+2]));
+				stats[3].sample(fabs(refPix[m+3] - testPix[m+3]));
+			}
+		}
+	}
+};
+
+void
+statsAtOffset(Image& test, Image& ref, Image::Registration& r) {
+	int n = threadCount(4.0 * ref.width() * ref.height(), ref.height());
+
+	std::vector<StatsJob> rows(n);
+	std::vector<Job*> jobs(n);
+	for (int t = 0; t < n; ++t) {
+		rows[t].test = &test;
+		rows[t].ref = &ref;
+		rows[t].hOffset = r.hOffset;
+		rows[t].wOffset = r.wOffset;
+		jobs[t] = &rows[t];
+	}
+	splitRows(jobs, ref.height());
+	runJobs(jobs);
+
+	for (int c = 0; c < 4; ++c) {
+		r.stats[c] = rows[0].stats[c];
+		for (int t = 1; t < n; ++t)
+			r.stats[c].merge(rows[t].stats[c]);
+	}
+}
+
+}; // anonymous namespace
+
 
 namespace GLEAN {
 
@@ -53,6 +330,13 @@ namespace GLEAN {
 //	Returns an Image::Registration struct that specifies the position at
 //	which the sum of mean absolute errors was minimal, plus the statistics
 //	at that position.
+//
+//	When both images have the same format and an 8- or 16-bit unsigned
+//	type, the position is found by comparing the packed pixels directly,
+//	and the statistics are only gathered at that position.  Large images
+//	are split across threads.  This is not done for GL_LUMINANCE_ALPHA,
+//	whose luminance lands in three of the four RGBA channels and so
+//	outweighs alpha in the sum of mean absolute errors.
 ///////////////////////////////////////////////////////////////////////////////
 Image::Registration
 Image::reg(Image& ref) {
@@ -67,6 +351,34 @@ Image::reg(Image& ref) {
 	if (dh < 0 || dw < 0)
 		throw RefImageTooLarge();
 
+	if (format() == ref.format() && type() == ref.type()
+	 && format() != GL_LUMINANCE_ALPHA
+	 && (type() == GL_UNSIGNED_BYTE || type() == GL_UNSIGNED_SHORT)) {
+		// Select the unpackers and compute the row sizes up front,
+		// since the jobs share the images.
+		double dummy[4];
+		unpack(0, dummy, pixels());
+		ref.unpack(0, dummy, ref.pixels());
+		rowSizeInBytes();
+		ref.rowSizeInBytes();
+		pixelSizeInBytes();
+		ref.pixelSizeInBytes();
+
+		Registration r;
+		r.hOffset = 0;
+		r.wOffset = 0;
+		if (dh > 0 || dw > 0) {
+			if (type() == GL_UNSIGNED_BYTE)
+				searchOffset<GLubyte>(*this, ref, dh, dw,
+					r.hOffset, r.wOffset);
+			else
+				searchOffset<GLushort>(*this, ref, dh, dw,
+					r.hOffset, r.wOffset);
+		}
+		statsAtOffset(*this, ref, r);
+		return r;
+	}
+
 	int wt4 = 4 * wt;		// Width of test image, in RGBA samples.
 	int wr4 = 4 * wr;		// Width of ref image, in RGBA samples.
 	int dw4 = 4 * dw;		// Difference in widths, in samples.
@@ -133,6 +445,14 @@ Image::reg(Image& ref) {
 					stats[j][k+3].sample( fabs(
 						refPix[m+3]-testPix[j][m+k+3]));
 				}
+
+		// Slide the window of test rows down by one, so that
+		// testPix[j] holds test row i + 1 + j for the next
+		// reference row:
+		double* oldest = testPix[0];
+		for (int j = 0; j < dh; ++j)
+			testPix[j] = testPix[j + 1];
+		testPix[dh] = oldest;
 	}
 
 	// Now find the position for which the sum of the mean absolute errors
@@ -77,6 +77,17 @@ class BasicStats {
 		_sum += d;
 		_sum2 += d*d;
 	}
+	// Combine with statistics gathered separately, e.g. on another
+	// thread:
+	inline void merge(const BasicStats& s) {
+		_n += s._n;
+		if (s._min < _min)
+			_min = s._min;
+		if (s._max > _max)
+			_max = s._max;
+		_sum += s._sum;
+		_sum2 += s._sum2;
+	}
 
 	BasicStats() {init();}
 	template<class T> BasicStats(std::vector<T>& v) {
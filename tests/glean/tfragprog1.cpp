@@ -44,6 +44,7 @@
 #include <cmath>
 #include <math.h>
 #include "tfragprog1.h"
+#include "piglit-util.h"
 
 
 namespace GLEAN {
@@ -1132,12 +1133,19 @@ FragmentProgramTest::runOne(MultiTestResult &r, Window &w)
 #if DEVEL_MODE
 			glViewport(0, i * 20, windowWidth, 20);
 #endif
-			if (!testProgram(Programs[i])) {
+			bool pass = testProgram(Programs[i]);
+			if (!pass) {
 				r.numFailed++;
 			}
 			else {
 				r.numPassed++;
 			}
+
+			// when running all sub-tests, report each one to
+			// piglit so the results can be filed separately
+			if (!single)
+				piglit_report_subtest_result(pass ? PIGLIT_PASS : PIGLIT_FAIL,
+							     Programs[i].name);
 		}
 	}
 
@@ -37,6 +37,7 @@
 #include <cstring>
 #include <math.h>
 #include "tglsl1.h"
+#include "piglit-util.h"
 
 
 namespace GLEAN {
@@ -4847,17 +4848,25 @@ GLSLTest::runOne(MultiTestResult &r, Window &w)
 		}
 	}
 	else {
-		// loop over all tests
+		// loop over all tests, reporting each one to piglit so that
+		// the results can be filed under the sub-test names
 		for (int i = 0; Programs[i].name; i++) {
-			if ((Programs[i].flags & FLAG_VERSION_1_20) && !glsl_120)
-				continue; // skip non-applicable tests
-			if ((Programs[i].flags & FLAG_VERSION_1_30) && !glsl_130)
-				continue; // skip non-applicable tests
+			if (((Programs[i].flags & FLAG_VERSION_1_20) && !glsl_120) ||
+			    ((Programs[i].flags & FLAG_VERSION_1_30) && !glsl_130)) {
+				// skip non-applicable tests
+				piglit_report_subtest_result(PIGLIT_SKIP,
+							     Programs[i].name);
+				continue;
+			}
 			if (testProgram(Programs[i])) {
 				r.numPassed++;
+				piglit_report_subtest_result(PIGLIT_PASS,
+							     Programs[i].name);
 			}
 			else {
 				r.numFailed++;
+				piglit_report_subtest_result(PIGLIT_FAIL,
+							     Programs[i].name);
 			}
 		}
 	}
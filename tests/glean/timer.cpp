@@ -39,18 +39,11 @@
 // <faith@valinux.com>, December 2000
 
 #include "timer.h"
+#include "piglit-util.h"
 #include <vector>
 #include <algorithm>
 using namespace std;
 
-#if defined(__UNIX__)
-#    include <sys/time.h>	// for gettimeofday, used by getClock
-#elif defined(__MS__)
-#    include <windows.h>
-#    include <sys/types.h>
-#    include <sys/timeb.h>	// for _ftime(), used by getClock
-#endif
-
 namespace GLEAN {
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -104,41 +97,12 @@ Timer::chooseRunTime() {
 } // Timer::chooseRunTime
 
 ///////////////////////////////////////////////////////////////////////////////
-// getClock - get current wall-clock time (expressed in seconds)
+// getClock - get current time (expressed in seconds)
 ///////////////////////////////////////////////////////////////////////////////
 double
 Timer::getClock() {
-#if defined(__MS__)
-	static int once = 1;
-	static double freq;
-
-	if (once) {
-	    LARGE_INTEGER fr;
-	    freq = (double) (QueryPerformanceFrequency(&fr) ?
-			     1.0 / fr.QuadPart : 0);
-	    once = 0;
-	}
-
-	// Use high-resolution counter, if available
-	if (freq) {
-	    LARGE_INTEGER pc;
-	    QueryPerformanceCounter(&pc);
-	    return freq * (double) pc.QuadPart;
-	} else {
-	    struct _timeb t;
-
-	    _ftime(&t);
-
-	    return (double) t.time + (double) t.millitm * 1E-3;
-	}
-#elif defined(__UNIX__)
-	struct timeval t;
-
-	// XXX gettimeofday is different on SysV, if I remember correctly
-	gettimeofday(&t, 0);
-
-	return (double) t.tv_sec + (double) t.tv_usec * 1E-6;
-#endif
+	// Monotonic, so that NTP adjustments can't skew the measurement.
+	return piglit_time_get_nano() * 1E-9;
 } // Timer::getClock
 
 ///////////////////////////////////////////////////////////////////////////////
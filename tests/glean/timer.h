@@ -59,7 +59,7 @@ public:
 	
 	void         calibrate();
 	double       time();
-	double       getClock();    // Get wall-clock time, in seconds
+	double       getClock();    // Get monotonic time, in seconds
 	double       waitForTick(); // Wait for next clock tick; return time
 	void         measure(int count,
 			     double* low, double* avg, double* high);
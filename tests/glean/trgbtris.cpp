@@ -26,13 +26,14 @@
 // 
 // END_COPYRIGHT
 
-// trgbtris.cpp:  example image-based test to show use of TIFF images
+// trgbtris.cpp:  example image-based test to show use of stored images
 
 #include "trgbtris.h"
 #include "stats.h"
 #include "rand.h"
 #include "geomutil.h"
 #include "image.h"
+#include <stdio.h>
 
 #if 0
 #if defined __UNIX__
@@ -62,6 +63,28 @@ logStats(GLEAN::BasicStats& stats, GLEAN::Environment* env) {
 		<< stats.deviation() << '\n';
 }
 
+// Results databases written before glean stored raw dumps hold TIFF
+// images under the same name with a .tif suffix.  Those can still be
+// compared when glean is built with libtiff.
+void
+readImage(GLEAN::Image& image, const std::string& fileName) {
+#if defined(GLEAN_HAVE_TIFF)
+	FILE* f = fopen(fileName.c_str(), "rb");
+	if (!f) {
+		std::string tiffName(fileName, 0, fileName.rfind('.'));
+		tiffName += ".tif";
+		f = fopen(tiffName.c_str(), "rb");
+		if (f) {
+			fclose(f);
+			image.readTIFF(tiffName);
+			return;
+		}
+	} else
+		fclose(f);
+#endif
+	image.readRaw(fileName);
+}
+
 } // anonymous namespace
 
 namespace GLEAN {
@@ -106,7 +129,7 @@ RGBTriStripTest::runOne(RGBTriStripResult& r, Window& w) {
 
 	Image image(drawingSize + 2, drawingSize + 2, GL_RGB, GL_FLOAT);
 	image.read(0, 0);	// Invoke glReadPixels to read the image.
-	image.writeTIFF(env->imageFileName(name, r.imageNumber));
+	image.writeRaw(env->imageFileName(name, r.imageNumber));
 
 	r.pass = true;
 } // RGBTriStripTest::runOne
@@ -134,9 +157,9 @@ void
 RGBTriStripTest::compareOne(RGBTriStripResult& oldR, RGBTriStripResult& newR) {
 	// Fetch the old and new images:
 	Image oldI;
-	oldI.readTIFF(env->image1FileName(name, oldR.imageNumber));
+	readImage(oldI, env->image1FileName(name, oldR.imageNumber));
 	Image newI;
-	newI.readTIFF(env->image2FileName(name, newR.imageNumber));
+	readImage(newI, env->image2FileName(name, newR.imageNumber));
 
 	// Register the images, and gather statistics about the differences
 	// for each color channel:
@@ -26,7 +26,7 @@
 // 
 // END_COPYRIGHT
 
-// trgbtris.h:  example image-based test to show use of TIFF images
+// trgbtris.h:  example image-based test to show use of stored images
 
 #ifndef __trgbtris_h__
 #define __trgbtris_h__
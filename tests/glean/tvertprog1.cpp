@@ -37,6 +37,7 @@
 #include <cstring>
 #include <math.h>
 #include "tvertprog1.h"
+#include "piglit-util.h"
 
 
 namespace GLEAN {
@@ -1116,16 +1117,27 @@ VertexProgramTest::runOne(MultiTestResult &r, Window &w)
 
 		if (!single || strcmp(single, Programs[i].name) == 0) {
 
-			if (!testProgram(Programs[i])) {
+			bool pass = testProgram(Programs[i]);
+			if (!pass) {
 				r.numFailed++;
 			}
 			else {
 				r.numPassed++;
 			}
+
+			// when running all sub-tests, report each one to
+			// piglit so the results can be filed separately
+			if (!single)
+				piglit_report_subtest_result(pass ? PIGLIT_PASS : PIGLIT_FAIL,
+							     Programs[i].name);
 		}
 	}
 
+	int failed = r.numFailed;
 	testBadProgram(r);
+	if (!single)
+		piglit_report_subtest_result(r.numFailed == failed ? PIGLIT_PASS : PIGLIT_FAIL,
+					     "Invalid program");
 
 	r.pass = (r.numFailed == 0);
 }
@@ -423,12 +423,12 @@ ColoredLitPerf::runOne(VPResult& r, Window& w) {
 	}
 
 	bool passed = true;
-	PFNGLLOCKARRAYSEXTPROC glLockArraysEXT = 0;
-	PFNGLUNLOCKARRAYSEXTPROC glUnlockArraysEXT = 0;
+	PFNGLLOCKARRAYSEXTPROC lockArrays = 0;
+	PFNGLUNLOCKARRAYSEXTPROC unlockArrays = 0;
 	if (GLUtils::haveExtension("GL_EXT_compiled_vertex_array")) {
-		glLockArraysEXT = reinterpret_cast<PFNGLLOCKARRAYSEXTPROC>
+		lockArrays = reinterpret_cast<PFNGLLOCKARRAYSEXTPROC>
 			(GLUtils::getProcAddress("glLockArraysEXT"));
-		glUnlockArraysEXT = reinterpret_cast<PFNGLUNLOCKARRAYSEXTPROC>
+		unlockArrays = reinterpret_cast<PFNGLUNLOCKARRAYSEXTPROC>
 			(GLUtils::getProcAddress("glUnlockArraysEXT"));
 	}
 
@@ -606,13 +606,13 @@ ColoredLitPerf::runOne(VPResult& r, Window& w) {
 	//	XXX This is probably unrealistically favorable to
 	//	locked arrays.
 	////////////////////////////////////////////////////////////
-	if (glLockArraysEXT)
-		glLockArraysEXT(0, nVertices);
+	if (lockArrays)
+		lockArrays(0, nVertices);
 	daIndTri.measure(5, &r.ldaTri.tpsLow, &r.ldaTri.tps,
 			 &r.ldaTri.tpsHigh);
-	if (glUnlockArraysEXT)
-		glUnlockArraysEXT();
-	if (!glLockArraysEXT)
+	if (unlockArrays)
+		unlockArrays();
+	if (!lockArrays)
 		r.ldaTri.tps = r.ldaTri.tpsLow = r.ldaTri.tpsHigh = 0.0;
 	verifyVtxPerf(testImage, colorGen, 0, lastID, imTriImage,
 		passed, name, r.config, r.ldaTri, env,
@@ -630,13 +630,13 @@ ColoredLitPerf::runOne(VPResult& r, Window& w) {
 	////////////////////////////////////////////////////////////
 	// Locked DrawElements on independent triangles
 	////////////////////////////////////////////////////////////
-	if (glLockArraysEXT)
-		glLockArraysEXT(0, nVertices);
+	if (lockArrays)
+		lockArrays(0, nVertices);
 	deIndTri.measure(5, &r.ldeTri.tpsLow, &r.ldeTri.tps,
 			 &r.ldeTri.tpsHigh);
-	if (glUnlockArraysEXT)
-		glUnlockArraysEXT();
-	if (!glLockArraysEXT)
+	if (unlockArrays)
+		unlockArrays();
+	if (!lockArrays)
 		r.ldeTri.tps = r.ldeTri.tpsLow = r.ldeTri.tpsHigh = 0.0;
 	verifyVtxPerf(testImage, colorGen, 0, lastID, imTriImage,
 	       passed, name, r.config, r.ldeTri, env,
@@ -725,12 +725,12 @@ ColoredLitPerf::runOne(VPResult& r, Window& w) {
 	////////////////////////////////////////////////////////////
 	// Locked DrawArrays on triangle strips
 	////////////////////////////////////////////////////////////
-	if (glLockArraysEXT)
-		glLockArraysEXT(0, nVertices);
+	if (lockArrays)
+		lockArrays(0, nVertices);
 	daTriStrip.measure(5, &r.ldaTS.tpsLow, &r.ldaTS.tps, &r.ldaTS.tpsHigh);
-	if (glUnlockArraysEXT)
-		glUnlockArraysEXT();
-	if (!glLockArraysEXT)
+	if (unlockArrays)
+		unlockArrays();
+	if (!lockArrays)
 		r.ldaTS.tps = r.ldaTS.tpsLow = r.ldaTS.tpsHigh = 0.0;
 	verifyVtxPerf(testImage, colorGen, 0, lastID, imTriImage,
 	       passed, name, r.config, r.ldaTS, env,
@@ -748,12 +748,12 @@ ColoredLitPerf::runOne(VPResult& r, Window& w) {
 	////////////////////////////////////////////////////////////
 	// Locked DrawElements on triangle strips
 	////////////////////////////////////////////////////////////
-	if (glLockArraysEXT)
-		glLockArraysEXT(0, nVertices);
+	if (lockArrays)
+		lockArrays(0, nVertices);
 	deTriStrip.measure(5, &r.ldeTS.tpsLow, &r.ldeTS.tps, &r.ldeTS.tpsHigh);
-	if (glUnlockArraysEXT)
-		glUnlockArraysEXT();
-	if (!glLockArraysEXT)
+	if (unlockArrays)
+		unlockArrays();
+	if (!lockArrays)
 		r.ldeTS.tps = r.ldeTS.tpsLow = r.ldeTS.tpsHigh = 0.0;
 	
 	verifyVtxPerf(testImage, colorGen, 0, lastID, imTriImage,
@@ -923,12 +923,12 @@ ColoredTexPerf::runOne(VPResult& r, Window& w) {
 		return;
 	}
 
-	PFNGLLOCKARRAYSEXTPROC glLockArraysEXT = 0;
-	PFNGLUNLOCKARRAYSEXTPROC glUnlockArraysEXT = 0;
+	PFNGLLOCKARRAYSEXTPROC lockArrays = 0;
+	PFNGLUNLOCKARRAYSEXTPROC unlockArrays = 0;
 	if (GLUtils::haveExtension("GL_EXT_compiled_vertex_array")) {
-		glLockArraysEXT = reinterpret_cast<PFNGLLOCKARRAYSEXTPROC>
+		lockArrays = reinterpret_cast<PFNGLLOCKARRAYSEXTPROC>
 			(GLUtils::getProcAddress("glLockArraysEXT"));
-		glUnlockArraysEXT = reinterpret_cast<PFNGLUNLOCKARRAYSEXTPROC>
+		unlockArrays = reinterpret_cast<PFNGLUNLOCKARRAYSEXTPROC>
 			(GLUtils::getProcAddress("glUnlockArraysEXT"));
 	}
 
@@ -1124,13 +1124,13 @@ ColoredTexPerf::runOne(VPResult& r, Window& w) {
 	//	XXX This is probably unrealistically favorable to
 	//	locked arrays.
 	////////////////////////////////////////////////////////////
-	if (glLockArraysEXT)
-		glLockArraysEXT(0, nVertices);
+	if (lockArrays)
+		lockArrays(0, nVertices);
 	daIndTri.measure(5, &r.ldaTri.tpsLow, &r.ldaTri.tps,
 			 &r.ldaTri.tpsHigh);
-	if (glUnlockArraysEXT)
-		glUnlockArraysEXT();
-	if (!glLockArraysEXT)
+	if (unlockArrays)
+		unlockArrays();
+	if (!lockArrays)
 		r.ldaTri.tps = r.ldaTri.tpsLow = r.ldaTri.tpsHigh = 0.0;
 	verifyVtxPerf(testImage, colorGen, 0, lastID, imTriImage,
 	       passed, name, r.config, r.ldaTri, env,
@@ -1148,13 +1148,13 @@ ColoredTexPerf::runOne(VPResult& r, Window& w) {
 	////////////////////////////////////////////////////////////
 	// Locked DrawElements on independent triangles
 	////////////////////////////////////////////////////////////
-	if (glLockArraysEXT)
-		glLockArraysEXT(0, nVertices);
+	if (lockArrays)
+		lockArrays(0, nVertices);
 	deIndTri.measure(5, &r.ldeTri.tpsLow, &r.ldeTri.tps,
 			 &r.ldeTri.tpsHigh);
-	if (glUnlockArraysEXT)
-		glUnlockArraysEXT();
-	if (!glLockArraysEXT)
+	if (unlockArrays)
+		unlockArrays();
+	if (!lockArrays)
 		r.ldeTri.tps = r.ldeTri.tpsLow = r.ldeTri.tpsHigh = 0.0;
 	verifyVtxPerf(testImage, colorGen, 0, lastID, imTriImage,
 	       passed, name, r.config, r.ldeTri, env,
@@ -1242,12 +1242,12 @@ ColoredTexPerf::runOne(VPResult& r, Window& w) {
 	////////////////////////////////////////////////////////////
 	// Locked DrawArrays on triangle strips
 	////////////////////////////////////////////////////////////
-	if (glLockArraysEXT)
-		glLockArraysEXT(0, nVertices);
+	if (lockArrays)
+		lockArrays(0, nVertices);
 	daTriStrip.measure(5, &r.ldaTS.tpsLow, &r.ldaTS.tps, &r.ldaTS.tpsHigh);
-	if (glUnlockArraysEXT)
-		glUnlockArraysEXT();
-	if (!glLockArraysEXT)
+	if (unlockArrays)
+		unlockArrays();
+	if (!lockArrays)
 		r.ldaTS.tps = r.ldaTS.tpsLow = r.ldaTS.tpsHigh = 0.0;
 	verifyVtxPerf(testImage, colorGen, 0, lastID, imTriImage,
 		passed, name, r.config, r.ldaTS, env,
@@ -1265,12 +1265,12 @@ ColoredTexPerf::runOne(VPResult& r, Window& w) {
 	////////////////////////////////////////////////////////////
 	// Locked DrawElements on triangle strips
 	////////////////////////////////////////////////////////////
-	if (glLockArraysEXT)
-		glLockArraysEXT(0, nVertices);
+	if (lockArrays)
+		lockArrays(0, nVertices);
 	deTriStrip.measure(5, &r.ldeTS.tpsLow, &r.ldeTS.tps, &r.ldeTS.tpsHigh);
-	if (glUnlockArraysEXT)
-		glUnlockArraysEXT();
-	if (!glLockArraysEXT)
+	if (unlockArrays)
+		unlockArrays();
+	if (!lockArrays)
 		r.ldeTS.tps = r.ldeTS.tpsLow = r.ldeTS.tpsHigh = 0.0;
 	verifyVtxPerf(testImage, colorGen, 0, lastID, imTriImage,
 	       passed, name, r.config, r.ldeTS, env,
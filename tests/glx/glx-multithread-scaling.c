@@ -0,0 +1,403 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file glx-multithread-scaling.c
+ *
+ * Measure how draw throughput scales with the number of threads
+ * rendering at the same time, each with its own GLX context and its own
+ * FBO.  Where glx-multithread checks that this works, this shows how much
+ * the driver's locking lets it scale.
+ *
+ * Usage: glx-multithread-scaling [-threads N] [-share] [-time S]
+ *
+ * The benchmark runs with 1, 2, 4, ... threads up to N (default: the
+ * number of CPUs the process may run on), for S seconds each (default 1, or
+ * PIGLIT_BENCH_MAX_TIME).  Every thread draws small textured quads in
+ * batches, and the time per draw of each batch is a latency sample.  For
+ * each thread count, the aggregate draw rate, its efficiency relative to
+ * perfect scaling from one thread, and the median and 95th percentile
+ * per-draw latency over all threads are reported.
+ *
+ * With -share, all contexts share objects with a common context and draw
+ * with the same texture, which also exercises the locking around shared
+ * state.  Otherwise every thread creates its own texture.
+ */
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include "piglit-util-gl-common.h"
+#include "piglit-glx-util.h"
+#include "piglit-bench.h"
+#include "pthread.h"
+
+#if defined(HAVE_SCHED_SETAFFINITY)
+#include <sched.h>
+#endif
+
+int piglit_width = 64, piglit_height = 64;
+
+#define MAX_THREADS 64
+#define MAX_SAMPLES 4096
+#define BATCH_DRAWS 64
+#define FBO_SIZE 64
+
+struct thread_state {
+	pthread_t thread;
+	GLXContext ctx;
+
+	/** Time per draw of each batch, in seconds. */
+	double *samples;
+	unsigned num_samples;
+	unsigned draws;
+
+	int64_t end;
+	bool pass;
+};
+
+static Display *dpy;
+static Window win;
+static XVisualInfo *visinfo;
+static GLXContext main_ctx;
+static GLuint shared_tex;
+
+static unsigned max_threads;
+static bool share;
+static double run_time = 1.0;
+
+static pthread_barrier_t start_barrier;
+
+static const float green[4] = {0.0, 1.0, 0.0, 1.0};
+
+static GLuint
+create_texture(void)
+{
+	GLfloat texels[4 * 4 * 4];
+	GLuint tex;
+	int i;
+
+	for (i = 0; i < 4 * 4; i++)
+		memcpy(&texels[i * 4], green, sizeof(green));
+
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 4, 4, 0,
+		     GL_RGBA, GL_FLOAT, texels);
+
+	return tex;
+}
+
+/**
+ * Create and bind an FBO with a single color renderbuffer.  Returns false
+ * if it is incomplete.
+ */
+static bool
+create_fbo(GLuint *fbo, GLuint *rb)
+{
+	glGenRenderbuffersEXT(1, rb);
+	glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, *rb);
+	glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_RGBA8,
+				 FBO_SIZE, FBO_SIZE);
+	glGenFramebuffersEXT(1, fbo);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, *fbo);
+	glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT,
+				     GL_COLOR_ATTACHMENT0_EXT,
+				     GL_RENDERBUFFER_EXT, *rb);
+
+	return glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) ==
+		GL_FRAMEBUFFER_COMPLETE_EXT;
+}
+
+static void
+destroy_fbo(GLuint fbo, GLuint rb)
+{
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+	glDeleteFramebuffersEXT(1, &fbo);
+	glDeleteRenderbuffersEXT(1, &rb);
+}
+
+static void *
+thread_func(void *arg)
+{
+	struct thread_state *state = arg;
+	struct piglit_dispatch_table *dispatch;
+	GLuint fbo, rb, tex;
+	int64_t deadline;
+	Bool ret;
+
+	ret = glXMakeCurrent(dpy, win, state->ctx);
+	assert(ret);
+
+	/* Each thread fills in its own dispatch table. */
+	dispatch = piglit_dispatch_create_table();
+	piglit_dispatch_make_current(dispatch);
+
+	state->pass = create_fbo(&fbo, &rb);
+
+	glViewport(0, 0, FBO_SIZE, FBO_SIZE);
+	piglit_ortho_projection(FBO_SIZE, FBO_SIZE, GL_FALSE);
+	glClearColor(0.5, 0.5, 0.5, 1.0);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	tex = share ? shared_tex : create_texture();
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glEnable(GL_TEXTURE_2D);
+	glFinish();
+
+	pthread_barrier_wait(&start_barrier);
+	deadline = piglit_time_get_nano() + (int64_t) (run_time * 1e9);
+
+	while (state->pass && state->num_samples < MAX_SAMPLES) {
+		int64_t start = piglit_time_get_nano();
+		int64_t end;
+		int i;
+
+		for (i = 0; i < BATCH_DRAWS; i++) {
+			piglit_draw_rect_tex(i % (FBO_SIZE / 2), 0,
+					     FBO_SIZE / 2, FBO_SIZE,
+					     0, 0, 1, 1);
+		}
+		glFinish();
+
+		end = piglit_time_get_nano();
+		state->samples[state->num_samples++] =
+			(end - start) * 1e-9 / BATCH_DRAWS;
+		state->draws += BATCH_DRAWS;
+		if (end >= deadline)
+			break;
+	}
+	state->end = piglit_time_get_nano();
+
+	state->pass = state->pass &&
+		piglit_probe_pixel_rgba(FBO_SIZE / 2, FBO_SIZE / 2, green);
+
+	destroy_fbo(fbo, rb);
+	if (!share)
+		glDeleteTextures(1, &tex);
+	glXMakeCurrent(dpy, None, NULL);
+	piglit_dispatch_destroy_table(dispatch);
+
+	return NULL;
+}
+
+/**
+ * Render with \c count threads at once and report the results as
+ * "threads-<count>".  \c single_rate is the aggregate rate of the
+ * single-threaded run, or zero if this is it.
+ */
+static bool
+run(unsigned count, double *single_rate)
+{
+	struct thread_state threads[MAX_THREADS];
+	struct piglit_bench_stats stats;
+	double *samples;
+	double rate, efficiency, fairness;
+	unsigned total_draws = 0, min_draws = ~0u, max_draws = 0;
+	unsigned n = 0, i;
+	int64_t start, end = 0;
+	bool pass = true;
+
+	samples = malloc(count * MAX_SAMPLES * sizeof(double));
+	if (samples == NULL)
+		return false;
+
+	/* Create the contexts up front, so that the threads only contend
+	 * for the driver while they render.
+	 */
+	memset(threads, 0, sizeof(threads));
+	for (i = 0; i < count; i++) {
+		threads[i].ctx = piglit_get_glx_context_share(dpy, visinfo,
+							      share ? main_ctx : NULL);
+		threads[i].samples = samples + i * MAX_SAMPLES;
+	}
+
+	pthread_barrier_init(&start_barrier, NULL, count + 1);
+	for (i = 0; i < count; i++)
+		pthread_create(&threads[i].thread, NULL, thread_func,
+			       &threads[i]);
+
+	/* The threads set up their FBOs before the barrier, so that isn't
+	 * part of the measurement.
+	 */
+	pthread_barrier_wait(&start_barrier);
+	start = piglit_time_get_nano();
+
+	for (i = 0; i < count; i++) {
+		pthread_join(threads[i].thread, NULL);
+		glXDestroyContext(dpy, threads[i].ctx);
+
+		pass = pass && threads[i].pass;
+		total_draws += threads[i].draws;
+		min_draws = MIN2(min_draws, threads[i].draws);
+		max_draws = MAX2(max_draws, threads[i].draws);
+		end = MAX2(end, threads[i].end);
+
+		memmove(samples + n, threads[i].samples,
+			threads[i].num_samples * sizeof(double));
+		n += threads[i].num_samples;
+	}
+	pthread_barrier_destroy(&start_barrier);
+
+	piglit_bench_compute_stats(samples, n, 0.0, &stats);
+	free(samples);
+
+	rate = end > start ? total_draws / ((end - start) * 1e-9) : 0.0;
+	if (*single_rate == 0.0)
+		*single_rate = rate;
+	efficiency = *single_rate > 0.0 ? rate / (*single_rate * count) : 0.0;
+	fairness = max_draws > 0 ? (double) min_draws / max_draws : 0.0;
+
+	printf("%2u threads: %.6g draws/s (%.0f%% of linear scaling), "
+	       "latency median %.4g us/draw, p95 %.4g us/draw, "
+	       "fairness %.2f%s\n",
+	       count, rate, 100.0 * efficiency, stats.median * 1e6,
+	       stats.p95 * 1e6, fairness, pass ? "" : " (FAILED)");
+	printf("PIGLIT: {'bench': {'threads-%u': {'unit': 'draws', "
+	       "'threads': %u, 'share': %s, 'rate': %.9g, "
+	       "'efficiency': %.9g, 'fairness': %.9g, 'median': %.9g, "
+	       "'mad': %.9g, 'p05': %.9g, 'p95': %.9g, 'samples': %u}}}\n",
+	       count, count, share ? "True" : "False", rate, efficiency,
+	       fairness, stats.median, stats.mad, stats.p05, stats.p95,
+	       stats.samples);
+	fflush(stdout);
+
+	return pass;
+}
+
+enum piglit_result
+draw(Display *dpy)
+{
+	double single_rate = 0.0;
+	GLuint fbo, rb;
+	unsigned count;
+	bool pass = true;
+
+	main_ctx = piglit_get_glx_context(dpy, visinfo);
+	glXMakeCurrent(dpy, win, main_ctx);
+	glewInit();
+
+	piglit_require_extension("GL_EXT_framebuffer_object");
+
+	/* Check that drawing works before timing it. */
+	shared_tex = create_texture();
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glEnable(GL_TEXTURE_2D);
+	piglit_ortho_projection(piglit_width, piglit_height, GL_FALSE);
+	piglit_draw_rect_tex(0, 0, piglit_width, piglit_height, 0, 0, 1, 1);
+	pass = piglit_probe_pixel_rgba(piglit_width / 2, piglit_height / 2,
+				       green);
+	glXSwapBuffers(dpy, win);
+	if (create_fbo(&fbo, &rb))
+		piglit_draw_rect_tex(0, 0, FBO_SIZE, FBO_SIZE, 0, 0, 1, 1);
+	destroy_fbo(fbo, rb);
+	glFinish();
+
+	/* Keep the common context current on no thread, so that the
+	 * threads share objects with an idle context.
+	 */
+	glXMakeCurrent(dpy, None, NULL);
+
+	for (count = 1; pass; count *= 2) {
+		count = MIN2(count, max_threads);
+		pass = run(count, &single_rate);
+		if (count == max_threads)
+			break;
+	}
+
+	glXMakeCurrent(dpy, win, main_ctx);
+	glDeleteTextures(1, &shared_tex);
+	glXMakeCurrent(dpy, None, NULL);
+	glXDestroyContext(dpy, main_ctx);
+
+	return pass ? PIGLIT_PASS : PIGLIT_FAIL;
+}
+
+/**
+ * Return the number of CPUs this process may run on, which is less than
+ * the number online under taskset or when piglit gives the test its own
+ * CPUs.
+ */
+static long
+usable_cpus(void)
+{
+#if defined(HAVE_SCHED_SETAFFINITY)
+	cpu_set_t set;
+
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		return CPU_COUNT(&set);
+#endif
+	return sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *env;
+	int i;
+
+	max_threads = CLAMP(usable_cpus(), 1, MAX_THREADS);
+
+	env = getenv("PIGLIT_BENCH_MAX_TIME");
+	if (env != NULL && atof(env) > 0.0)
+		run_time = atof(env);
+
+	for (i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-auto")) {
+			piglit_automatic = 1;
+		} else if (!strcmp(argv[i], "-share")) {
+			share = true;
+		} else if (!strcmp(argv[i], "-threads") && i + 1 < argc) {
+			max_threads = CLAMP(atoi(argv[++i]), 1, MAX_THREADS);
+		} else if (!strcmp(argv[i], "-time") && i + 1 < argc) {
+			run_time = atof(argv[++i]);
+			if (run_time <= 0.0) {
+				fprintf(stderr, "Invalid time: %s\n", argv[i]);
+				piglit_report_result(PIGLIT_FAIL);
+			}
+		} else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+		}
+	}
+
+	/* The threads make their contexts current concurrently. */
+	XInitThreads();
+
+	dpy = XOpenDisplay(NULL);
+	if (dpy == NULL) {
+		fprintf(stderr, "couldn't open display\n");
+		piglit_report_result(PIGLIT_FAIL);
+	}
+	visinfo = piglit_get_glx_visual(dpy);
+	win = piglit_get_glx_window(dpy, visinfo);
+
+	XMapWindow(dpy, win);
+
+	piglit_glx_event_loop(dpy, draw);
+
+	XFree(visinfo);
+
+	return 0;
+}
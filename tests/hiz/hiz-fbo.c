@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file hiz-fbo.c
+ *
+ * Runs each of the HiZ FBO tests against each combination of depth and
+ * stencil attachments, in one process.  The color attachment is always
+ * GL_RGBA.  The attachment configurations are:
+ *     - d0-s8: GL_STENCIL_INDEX8
+ *     - d24-s0: GL_DEPTH_COMPONENT24
+ *     - d24-s8: GL_DEPTH_COMPONENT24 and GL_STENCIL_INDEX8
+ *     - d24s8: GL_DEPTH24_STENCIL8
+ *
+ * Each combination is reported as a subtest named "<test> <config>", for
+ * example "depth-read d24s8".  Pass "-subtest '<test> <config>'" to run
+ * only one of them.
+ */
+
+#include "piglit-util-gl-common.h"
+#include "hiz/hiz-util.h"
+
+int piglit_width = 400;
+int piglit_height = 400;
+int piglit_window_mode = GLUT_RGB;
+
+static const struct {
+	bool (*run)(const struct hiz_fbo_options *options);
+	bool needs_depth;
+	bool needs_stencil;
+} tests[] = {
+	{ hiz_run_test_depth_test_fbo,		true,	false },
+	{ hiz_run_test_depth_read_fbo,		true,	false },
+	{ hiz_run_test_stencil_test_fbo,	false,	true },
+	{ hiz_run_test_stencil_read_fbo,	false,	true },
+	{ hiz_run_test_depth_stencil_test_fbo,	false,	false },
+};
+
+static const char *const test_names[] = {
+	"depth-test",
+	"depth-read",
+	"stencil-test",
+	"stencil-read",
+	"depth-stencil-test",
+	NULL
+};
+
+static const struct hiz_fbo_options configs[] = {
+	{ GL_RGBA, 0,			GL_STENCIL_INDEX8,	0 },
+	{ GL_RGBA, GL_DEPTH_COMPONENT24, 0,			0 },
+	{ GL_RGBA, GL_DEPTH_COMPONENT24, GL_STENCIL_INDEX8,	0 },
+	{ GL_RGBA, 0,			0,			GL_DEPTH24_STENCIL8 },
+};
+
+static const char *const config_names[] = {
+	"d0-s8",
+	"d24-s0",
+	"d24-s8",
+	"d24s8",
+	NULL
+};
+
+static const struct piglit_subtest_param params[] = {
+	{ "test", test_names },
+	{ "config", config_names },
+	{ NULL, NULL }
+};
+
+static enum piglit_result
+run_subtest(const unsigned *choice, void *data)
+{
+	const struct hiz_fbo_options *config = &configs[choice[1]];
+	bool has_depth = config->depth_format || config->depth_stencil_format;
+	bool has_stencil = config->stencil_format || config->depth_stencil_format;
+
+	if ((tests[choice[0]].needs_depth && !has_depth) ||
+	    (tests[choice[0]].needs_stencil && !has_stencil))
+		return PIGLIT_SKIP;
+
+	return tests[choice[0]].run(config) ? PIGLIT_PASS : PIGLIT_FAIL;
+}
+
+void
+piglit_init(int argc, char **argv)
+{
+	piglit_require_extension("GL_ARB_framebuffer_object");
+}
+
+enum piglit_result
+piglit_display()
+{
+	return piglit_run_subtests(params, run_subtest, NULL);
+}
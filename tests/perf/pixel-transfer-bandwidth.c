@@ -0,0 +1,409 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file pixel-transfer-bandwidth.c
+ *
+ * Measure pixel transfer bandwidth (GB/s) and per-call latency over a
+ * matrix of internal format x client format/type x image size x path.
+ * glean's readPixSanity/readpixPerf cover a fixed set of read formats and
+ * glean's pbo test only checks correctness; this covers both directions,
+ * including the packed formats from sized-internalformats.c and RGB9_E5.
+ *
+ * Paths:
+ *  - readpixels:         glReadPixels into client memory
+ *  - readpixels-pbo:     glReadPixels into a pixel pack buffer
+ *  - readpixels-pbo-map: as above, then map the buffer and read it
+ *  - getteximage:        glGetTexImage into client memory
+ *  - texsubimage:        glTexSubImage2D from client memory
+ *
+ * The read paths read from an FBO with the internal format's texture
+ * attached, and are skipped for formats that aren't color-renderable.
+ *
+ * Usage: pixel-transfer-bandwidth [path] [-size N]
+ */
+
+#include "piglit-util-gl-common.h"
+#include "piglit-bench.h"
+#include "sized-internalformats.h"
+#include "rgb9e5.h"
+
+int piglit_width = 64, piglit_height = 64;
+int piglit_window_mode = GLUT_RGBA | GLUT_DOUBLE;
+
+enum transfer_path {
+	READPIXELS,
+	READPIXELS_PBO,
+	READPIXELS_PBO_MAP,
+	GETTEXIMAGE,
+	TEXSUBIMAGE,
+};
+
+static const struct {
+	const char *name;
+	enum transfer_path path;
+	bool reads_framebuffer;
+	bool uses_pbo;
+} paths[] = {
+	{ "readpixels", READPIXELS, true, false },
+	{ "readpixels-pbo", READPIXELS_PBO, true, true },
+	{ "readpixels-pbo-map", READPIXELS_PBO_MAP, true, true },
+	{ "getteximage", GETTEXIMAGE, false, false },
+	{ "texsubimage", TEXSUBIMAGE, false, false },
+};
+
+static const struct transfer_format {
+	GLenum internal_format;
+	GLenum format;
+	GLenum type;
+	unsigned bytes_per_pixel;
+	const char *extensions[2];
+} formats[] = {
+	{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+	{ GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, 4 },
+	{ GL_RGBA8, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, 4 },
+	{ GL_RGBA8, GL_RGBA, GL_FLOAT, 16 },
+	{ GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, 3 },
+	{ GL_RGB5, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 2 },
+	{ GL_RGBA4, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, 2 },
+	{ GL_RGB5_A1, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, 2 },
+	{ GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, 4 },
+	{ GL_RGBA16, GL_RGBA, GL_UNSIGNED_SHORT, 8 },
+	{ GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT_ARB, 8,
+	  { "GL_ARB_texture_float", "GL_ARB_half_float_pixel" } },
+	{ GL_RGBA32F, GL_RGBA, GL_FLOAT, 16,
+	  { "GL_ARB_texture_float" } },
+	{ GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, 4,
+	  { "GL_EXT_packed_float" } },
+	{ GL_RGB9_E5, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, 4,
+	  { "GL_EXT_texture_shared_exponent" } },
+};
+
+static const unsigned default_sizes[] = { 64, 256, 1024 };
+
+struct transfer {
+	const struct transfer_format *f;
+	enum transfer_path path;
+	unsigned size;
+	GLsizeiptr bytes;
+	void *client;
+};
+
+static const char *selected_path;
+static unsigned selected_size;
+static GLuint tex, fbo, pbo;
+
+static bool
+format_supported(const struct transfer_format *f)
+{
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(f->extensions); i++) {
+		if (f->extensions[i] &&
+		    !piglit_is_extension_supported(f->extensions[i]))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Fill \c data with valid, non-trivial pixels.  Random bits would
+ * produce NaNs and denormals for the float types, which can send drivers
+ * down slow paths that real applications never hit.
+ */
+static void
+fill_client_data(const struct transfer_format *f, void *data,
+		 unsigned pixels)
+{
+	unsigned n = pixels * f->bytes_per_pixel;
+	unsigned i;
+
+	switch (f->type) {
+	case GL_FLOAT:
+		for (i = 0; i < n / 4; i++)
+			((float *) data)[i] = (i % 256) / 255.0f;
+		break;
+	case GL_HALF_FLOAT_ARB:
+		for (i = 0; i < n / 2; i++)
+			((GLushort *) data)[i] =
+				piglit_half_from_float((i % 256) / 255.0f);
+		break;
+	case GL_UNSIGNED_INT_5_9_9_9_REV:
+		for (i = 0; i < pixels; i++) {
+			float rgb[3];
+
+			rgb[0] = (i % 256) / 255.0f;
+			rgb[1] = ((i / 256) % 256) / 255.0f;
+			rgb[2] = 0.5f;
+			((GLuint *) data)[i] = float3_to_rgb9e5(rgb);
+		}
+		break;
+	case GL_UNSIGNED_INT_10F_11F_11F_REV:
+		/* Exponent 15 (1.0) with varying mantissas. */
+		for (i = 0; i < pixels; i++)
+			((GLuint *) data)[i] = (15u << 6 | (i & 0x3f)) |
+				(15u << 6 | (i & 0x3f)) << 11 |
+				(15u << 5 | (i & 0x1f)) << 22;
+		break;
+	default:
+		for (i = 0; i < n; i++)
+			((GLubyte *) data)[i] = (GLubyte) (i * 7);
+		break;
+	}
+}
+
+static void
+finish(void *data)
+{
+	glFinish();
+}
+
+static void
+transfer_op(void *data)
+{
+	const struct transfer *t = data;
+	const struct transfer_format *f = t->f;
+	const GLubyte *map;
+	volatile GLubyte sink;
+	GLsizeiptr i;
+
+	switch (t->path) {
+	case READPIXELS:
+		glReadPixels(0, 0, t->size, t->size, f->format, f->type,
+			     t->client);
+		break;
+	case READPIXELS_PBO:
+		glReadPixels(0, 0, t->size, t->size, f->format, f->type,
+			     NULL);
+		break;
+	case READPIXELS_PBO_MAP:
+		glReadPixels(0, 0, t->size, t->size, f->format, f->type,
+			     NULL);
+		map = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+		if (map == NULL) {
+			fprintf(stderr, "glMapBuffer failed: %s\n",
+				piglit_get_gl_error_name(glGetError()));
+			piglit_report_result(PIGLIT_FAIL);
+		}
+		/* Touch every page so that lazily mapped memory counts. */
+		for (i = 0; i < t->bytes; i += 4096)
+			sink = map[i];
+		(void) sink;
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		break;
+	case GETTEXIMAGE:
+		glGetTexImage(GL_TEXTURE_2D, 0, f->format, f->type, t->client);
+		break;
+	case TEXSUBIMAGE:
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, t->size, t->size,
+				f->format, f->type, t->client);
+		break;
+	}
+}
+
+static bool
+setup(struct transfer *t, bool reads_framebuffer, bool uses_pbo)
+{
+	const struct transfer_format *f = t->f;
+
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, f->internal_format, t->size, t->size,
+		     0, f->format, f->type, t->client);
+	if (glGetError() != GL_NO_ERROR)
+		return false;
+
+	if (reads_framebuffer) {
+		if (!piglit_is_extension_supported("GL_EXT_framebuffer_object"))
+			return false;
+
+		glGenFramebuffersEXT(1, &fbo);
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+		glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT,
+					  GL_COLOR_ATTACHMENT0_EXT,
+					  GL_TEXTURE_2D, tex, 0);
+		if (glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) !=
+		    GL_FRAMEBUFFER_COMPLETE_EXT)
+			return false;
+		glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+	}
+
+	if (uses_pbo) {
+		if (!piglit_is_extension_supported("GL_ARB_pixel_buffer_object"))
+			return false;
+
+		glGenBuffers(1, &pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, t->bytes, NULL,
+			     GL_STREAM_READ);
+	}
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+static void
+cleanup(void)
+{
+	if (pbo) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glDeleteBuffers(1, &pbo);
+		pbo = 0;
+	}
+	if (fbo) {
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, piglit_winsys_fbo);
+		glDeleteFramebuffersEXT(1, &fbo);
+		fbo = 0;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDeleteTextures(1, &tex);
+	tex = 0;
+
+	/* Don't let a failed setup leak into the next case. */
+	while (glGetError() != GL_NO_ERROR)
+		;
+}
+
+static enum piglit_result
+run_case(unsigned p, const struct transfer_format *f, unsigned size)
+{
+	const struct sized_internalformat *sized =
+		get_sized_internalformat(f->internal_format);
+	struct piglit_bench_options options;
+	struct piglit_bench bench;
+	struct piglit_bench_result bench_result;
+	struct transfer t;
+	char name[256];
+	enum piglit_result result = PIGLIT_PASS;
+
+	snprintf(name, sizeof(name), "%s %s %s/%s %ux%u",
+		 paths[p].name,
+		 sized ? sized->name :
+		 piglit_get_gl_enum_name(f->internal_format),
+		 piglit_get_gl_enum_name(f->format),
+		 piglit_get_gl_enum_name(f->type),
+		 size, size);
+
+	t.f = f;
+	t.path = paths[p].path;
+	t.size = size;
+	t.bytes = (GLsizeiptr) size * size * f->bytes_per_pixel;
+	t.client = malloc(t.bytes);
+	if (t.client == NULL)
+		return PIGLIT_FAIL;
+	fill_client_data(f, t.client, size * size);
+
+	if (!setup(&t, paths[p].reads_framebuffer, paths[p].uses_pbo)) {
+		printf("%s: not supported, skipping\n", name);
+		cleanup();
+		free(t.client);
+		return PIGLIT_SKIP;
+	}
+
+	memset(&bench, 0, sizeof(bench));
+	bench.name = name;
+	bench.unit = "GB";
+	bench.work_per_op = t.bytes * 1e-9;
+	bench.op = transfer_op;
+	bench.finish = finish;
+	bench.data = &t;
+	bench.secondary_unit = "calls";
+	bench.secondary_work_per_op = 1.0;
+
+	/* The matrix is large; trade some precision for run time. */
+	piglit_bench_default_options(&options);
+	options.max_warmup_time = 0.25;
+	options.max_time = MIN2(options.max_time, 1.0);
+
+	if (piglit_bench_run(&bench, &options, &bench_result) &&
+	    piglit_check_gl_error(GL_NO_ERROR))
+		piglit_bench_report(&bench, &bench_result);
+	else
+		result = PIGLIT_FAIL;
+
+	cleanup();
+	free(t.client);
+	return result;
+}
+
+void
+piglit_init(int argc, char **argv)
+{
+	int i;
+
+	piglit_require_gl_version(15);
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-size") == 0 && i + 1 < argc) {
+			selected_size = atoi(argv[++i]);
+		} else {
+			unsigned p;
+
+			for (p = 0; p < ARRAY_SIZE(paths); p++) {
+				if (strcmp(argv[i], paths[p].name) == 0)
+					break;
+			}
+			if (p == ARRAY_SIZE(paths)) {
+				fprintf(stderr, "Unknown path: %s\n", argv[i]);
+				piglit_report_result(PIGLIT_FAIL);
+			}
+			selected_path = argv[i];
+		}
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+}
+
+enum piglit_result
+piglit_display(void)
+{
+	enum piglit_result result = PIGLIT_SKIP;
+	unsigned p, f, s;
+
+	for (p = 0; p < ARRAY_SIZE(paths); p++) {
+		if (selected_path && strcmp(selected_path, paths[p].name) != 0)
+			continue;
+
+		for (f = 0; f < ARRAY_SIZE(formats); f++) {
+			if (!format_supported(&formats[f]))
+				continue;
+
+			for (s = 0; s < ARRAY_SIZE(default_sizes); s++) {
+				unsigned size = selected_size ?
+					selected_size : default_sizes[s];
+
+				piglit_merge_result(&result,
+						    run_case(p, &formats[f],
+							     size));
+				if (selected_size)
+					break;
+			}
+		}
+	}
+
+	piglit_present_results();
+
+	return result;
+}
@@ -0,0 +1,442 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file shader-compile-latency.c
+ *
+ * Time how long the GLSL compiler and linker take on a set of shaders,
+ * so that piglit's shader corpus doubles as a compiler workload.
+ *
+ * Usage: shader-compile-latency [-repeat N] file...
+ *
+ * Each file is either a shader_runner script (*.shader_test), whose
+ * vertex, geometry and fragment shaders are compiled and linked
+ * together, or a glslparsertest shader (*.vert, *.geom, *.frag), which
+ * is only compiled.  Every file is compiled (and linked) N times, 5 by
+ * default, with fresh shader and program objects each time, and one
+ * line is printed per file:
+ *
+ *	shader <TAB> path <TAB> status <TAB> samples <TAB>
+ *	compile median <TAB> compile MAD <TAB> link median <TAB> link MAD
+ *
+ * Times are in seconds, and the link fields are "-" for files that
+ * aren't linked.  status is "ok", "compile-error", "link-error", "skip"
+ * (the file needs a newer GLSL version, or has more than three
+ * shaders) or "read-error".  Compile errors are expected for some
+ * glslparsertest shaders; their timings are still reported, and the
+ * info log of each shader that failed is printed to stderr once.
+ *
+ * piglit-shader-compile-bench.py runs this over the whole corpus.
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include "piglit-util-gl-common.h"
+#include "piglit-bench.h"
+
+int piglit_width = 16, piglit_height = 16;
+int piglit_window_mode = GLUT_RGBA | GLUT_DOUBLE;
+
+#define MAX_STAGES 3
+#define MAX_REPEAT 1000
+
+struct stage {
+	GLenum target;
+	char *source;
+};
+
+static int glsl_version;
+static unsigned repeat = 5;
+static char **files;
+static unsigned num_files;
+
+/**
+ * Parse a "major.minor" version string into major * 100 + minor.
+ */
+static int
+parse_version(const char *s)
+{
+	int major = 0, minor = 0;
+
+	sscanf(s, "%d.%d", &major, &minor);
+	return major * 100 + minor;
+}
+
+static bool
+has_suffix(const char *s, const char *suffix)
+{
+	const size_t len = strlen(s), suffix_len = strlen(suffix);
+
+	return len >= suffix_len && strcmp(s + len - suffix_len, suffix) == 0;
+}
+
+static char *
+copy_text(const char *start, const char *end)
+{
+	char *s = malloc(end - start + 1);
+
+	memcpy(s, start, end - start);
+	s[end - start] = '\0';
+	return s;
+}
+
+/**
+ * Concatenate the shader files listed in a "[... shader file]" section,
+ * which are relative to the directory of \c script.
+ */
+static char *
+load_shader_files(const char *script, const char *start, const char *end)
+{
+	const char *slash = strrchr(script, '/');
+	const size_t dir_len = slash ? slash - script + 1 : 0;
+	char *source = calloc(1, 1);
+	size_t len = 0;
+	const char *line;
+
+	for (line = start; line < end; line = strchrnul(line, '\n') + 1) {
+		const char *name_end = strchrnul(line, '\n');
+		char *name, *path, *text;
+		unsigned size;
+
+		while (line < name_end && isspace(*line))
+			line++;
+		while (name_end > line && isspace(name_end[-1]))
+			name_end--;
+		if (line == name_end || *line == '#')
+			continue;
+
+		name = copy_text(line, name_end);
+		path = malloc(dir_len + strlen(name) + 1);
+		memcpy(path, script, dir_len);
+		strcpy(path + dir_len, name);
+		text = piglit_load_text_file(path, &size);
+		free(name);
+		free(path);
+		if (text == NULL) {
+			free(source);
+			return NULL;
+		}
+
+		source = realloc(source, len + size + 1);
+		memcpy(source + len, text, size);
+		len += size;
+		source[len] = '\0';
+		free(text);
+	}
+
+	return source;
+}
+
+/**
+ * Split a shader_runner script into its GLSL stages, and find its GLSL
+ * version requirement.  Returns the number of stages, -1 if a shader
+ * file couldn't be read, or -2 if there are more than MAX_STAGES.
+ */
+static int
+parse_shader_test(const char *script, const char *text,
+		  struct stage *stages, int *required_version)
+{
+	static const struct {
+		const char *header;
+		GLenum target;
+		bool from_files;
+	} sections[] = {
+		{ "[vertex shader]", GL_VERTEX_SHADER, false },
+		{ "[vertex shader file]", GL_VERTEX_SHADER, true },
+		{ "[geometry shader]", GL_GEOMETRY_SHADER, false },
+		{ "[geometry shader file]", GL_GEOMETRY_SHADER, true },
+		{ "[fragment shader]", GL_FRAGMENT_SHADER, false },
+		{ "[fragment shader file]", GL_FRAGMENT_SHADER, true },
+	};
+	const char *line = text;
+	const char *section_start = NULL;
+	int section = -1;
+	bool in_require = false;
+	int n = 0;
+
+	*required_version = 0;
+
+	for (;;) {
+		const bool at_end = *line == '\0';
+
+		if (at_end || line[0] == '[') {
+			/* Close the current section. */
+			if (section >= 0 && n == MAX_STAGES) {
+				/* Timing only some of them would time
+				 * a different program.
+				 */
+				while (n > 0)
+					free(stages[--n].source);
+				return -2;
+			}
+			if (section >= 0) {
+				char *source = sections[section].from_files ?
+					load_shader_files(script, section_start,
+							  line) :
+					copy_text(section_start, line);
+
+				if (source == NULL)
+					return -1;
+				stages[n].target = sections[section].target;
+				stages[n].source = source;
+				n++;
+			}
+			section = -1;
+			in_require = false;
+
+			if (at_end || strncmp(line, "[test]", 6) == 0)
+				break;
+
+			if (strncmp(line, "[require]", 9) == 0) {
+				in_require = true;
+			} else {
+				unsigned i;
+
+				for (i = 0; i < ARRAY_SIZE(sections); i++) {
+					const char *h = sections[i].header;
+
+					if (strncmp(line, h, strlen(h)) == 0)
+						section = i;
+				}
+			}
+
+			line = strchrnul(line, '\n');
+			if (*line)
+				line++;
+			section_start = line;
+			continue;
+		}
+
+		if (in_require && strncmp(line, "GLSL >= ", 8) == 0)
+			*required_version = parse_version(line + 8);
+
+		line = strchrnul(line, '\n');
+		if (*line)
+			line++;
+	}
+
+	return n;
+}
+
+/**
+ * Find the glsl_version in a glslparsertest shader's config section.
+ */
+static int
+parse_parser_test_version(const char *text)
+{
+	const char *s = strstr(text, "glsl_version:");
+
+	if (s == NULL)
+		return 0;
+	s += strlen("glsl_version:");
+	return parse_version(s + strspn(s, " \t"));
+}
+
+static void
+print_time(double seconds, bool valid)
+{
+	if (valid)
+		printf("\t%.9g", seconds);
+	else
+		printf("\t-");
+}
+
+static void
+print_info_log(const char *file, GLuint shader)
+{
+	GLint size = 0;
+	char *log;
+
+	piglit_GetShaderiv(shader, GL_INFO_LOG_LENGTH, &size);
+	log = malloc(size + 1);
+	log[0] = '\0';
+	if (size > 0)
+		piglit_GetShaderInfoLog(shader, size, NULL, log);
+	fprintf(stderr, "%s: failed to compile:\n%s\n", file, log);
+	free(log);
+}
+
+static void
+time_file(const char *file)
+{
+	struct stage stages[MAX_STAGES];
+	double compile_samples[MAX_REPEAT], link_samples[MAX_REPEAT];
+	struct piglit_bench_stats compile_stats, link_stats;
+	const char *status = "ok";
+	bool link = false;
+	int required_version, n, i;
+	unsigned size, rep;
+	char *text;
+
+	text = piglit_load_text_file(file, &size);
+	if (text == NULL) {
+		printf("shader\t%s\tread-error\t0\t-\t-\t-\t-\n", file);
+		return;
+	}
+
+	if (has_suffix(file, ".shader_test")) {
+		n = parse_shader_test(file, text, stages, &required_version);
+		link = true;
+	} else {
+		stages[0].target = has_suffix(file, ".vert") ?
+			GL_VERTEX_SHADER : has_suffix(file, ".geom") ?
+			GL_GEOMETRY_SHADER : GL_FRAGMENT_SHADER;
+		stages[0].source = text;
+		text = NULL;
+		required_version = parse_parser_test_version(stages[0].source);
+		n = 1;
+	}
+	free(text);
+
+	if (n == -1) {
+		printf("shader\t%s\tread-error\t0\t-\t-\t-\t-\n", file);
+		return;
+	}
+	if (n < 0) {
+		printf("shader\t%s\tskip\t0\t-\t-\t-\t-\n", file);
+		return;
+	}
+	if (n == 0 || required_version > glsl_version) {
+		printf("shader\t%s\tskip\t0\t-\t-\t-\t-\n", file);
+		goto done;
+	}
+
+	for (rep = 0; rep < repeat; rep++) {
+		GLuint shaders[MAX_STAGES];
+		GLint ok[MAX_STAGES];
+		GLuint prog = 0;
+		bool compiled = true;
+		int64_t start, compile_end, link_end;
+
+		/* Only the compiles, and the status query that waits for
+		 * them, are timed; the info logs are fetched afterwards.
+		 */
+		start = piglit_time_get_nano();
+		for (i = 0; i < n; i++) {
+			const GLchar *source = stages[i].source;
+
+			shaders[i] = piglit_CreateShader(stages[i].target);
+			piglit_ShaderSource(shaders[i], 1, &source, NULL);
+			piglit_CompileShader(shaders[i]);
+			piglit_GetShaderiv(shaders[i], GL_COMPILE_STATUS,
+					   &ok[i]);
+		}
+		compile_end = piglit_time_get_nano();
+
+		for (i = 0; i < n; i++) {
+			if (ok[i])
+				continue;
+			compiled = false;
+			if (rep == 0)
+				print_info_log(file, shaders[i]);
+		}
+
+		if (!compiled) {
+			status = "compile-error";
+			link = false;
+		} else if (link) {
+			GLint linked;
+
+			prog = piglit_CreateProgram();
+			for (i = 0; i < n; i++)
+				piglit_AttachShader(prog, shaders[i]);
+			piglit_LinkProgram(prog);
+			piglit_GetProgramiv(prog, GL_LINK_STATUS, &linked);
+			if (!linked) {
+				status = "link-error";
+				link = false;
+			}
+		}
+		link_end = piglit_time_get_nano();
+
+		compile_samples[rep] = (compile_end - start) * 1e-9;
+		link_samples[rep] = (link_end - compile_end) * 1e-9;
+
+		if (prog)
+			piglit_DeleteProgram(prog);
+		for (i = 0; i < n; i++)
+			piglit_DeleteShader(shaders[i]);
+	}
+
+	piglit_bench_compute_stats(compile_samples, repeat, 0.0,
+				   &compile_stats);
+	piglit_bench_compute_stats(link_samples, repeat, 0.0, &link_stats);
+
+	printf("shader\t%s\t%s\t%u", file, status, repeat);
+	print_time(compile_stats.median, true);
+	print_time(compile_stats.mad, true);
+	print_time(link_stats.median, link);
+	print_time(link_stats.mad, link);
+	printf("\n");
+	fflush(stdout);
+
+done:
+	for (i = 0; i < n; i++)
+		free(stages[i].source);
+}
+
+enum piglit_result
+piglit_display(void)
+{
+	unsigned i;
+
+	for (i = 0; i < num_files; i++)
+		time_file(files[i]);
+
+	return PIGLIT_PASS;
+}
+
+void
+piglit_init(int argc, char **argv)
+{
+	static const char *warmup_vs =
+		"void main() { gl_Position = gl_Vertex; }\n";
+	bool es;
+	int major, minor, i;
+	GLuint shader;
+
+	piglit_require_GLSL();
+	piglit_get_glsl_version(&es, &major, &minor);
+	glsl_version = major * 100 + minor;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) {
+			repeat = atoi(argv[++i]);
+			if (repeat < 1 || repeat > MAX_REPEAT) {
+				fprintf(stderr, "-repeat must be between 1 "
+					"and %d\n", MAX_REPEAT);
+				piglit_report_result(PIGLIT_FAIL);
+			}
+		} else {
+			break;
+		}
+	}
+	files = argv + i;
+	num_files = argc - i;
+
+	/* Keep one-time compiler initialization out of the first
+	 * file's timings.
+	 */
+	shader = piglit_compile_shader_text(GL_VERTEX_SHADER, warmup_vs);
+	piglit_DeleteShader(shader);
+}
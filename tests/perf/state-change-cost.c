@@ -0,0 +1,595 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file state-change-cost.c
+ *
+ * Measure the cost of a state change followed by a small draw, for the
+ * kinds of state that applications churn the most.  This generalizes
+ * glean's texBindPerf, which only covers texture binds.
+ *
+ * Every case alternates between two values of one piece of state and
+ * draws a tiny quad after each change.  The "draw-only" case does the
+ * same draws with no state change, and the cost of a change is printed
+ * relative to it.
+ *
+ * Usage: state-change-cost [case]
+ * With no case, all supported cases are run.
+ */
+
+#include "piglit-util-gl-common.h"
+#include "piglit-bench.h"
+
+int piglit_width = 64, piglit_height = 64;
+int piglit_window_mode = GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH;
+
+static const char *vs_text =
+	"void main()\n"
+	"{\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+	"	gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+	"}\n";
+
+static const char *fs_vector_text =
+	"uniform vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = color;\n"
+	"}\n";
+
+static const char *fs_scalar_text =
+	"uniform float r, g, b, a;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = vec4(r, g, b, a);\n"
+	"}\n";
+
+static const char *fs_ubo_text =
+	"#extension GL_ARB_uniform_buffer_object : require\n"
+	"uniform block {\n"
+	"	vec4 color;\n"
+	"};\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = color;\n"
+	"}\n";
+
+static const char *fs_texture_text =
+	"uniform sampler2D tex;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = texture2D(tex, gl_TexCoord[0].xy);\n"
+	"}\n";
+
+static const float colors[2][4] = {
+	{ 1.0, 0.0, 0.0, 1.0 },
+	{ 0.0, 1.0, 0.0, 1.0 },
+};
+
+/* Objects that the cases alternate between. */
+static GLuint progs[2];
+static GLuint textures[2];
+static GLuint samplers[2];
+static GLuint fbos[2];
+static GLuint vaos[2];
+static GLuint vbo, ubo;
+static GLint ubo_stride;
+static GLint uniform_locs[4];
+static unsigned toggle;
+
+static GLuint
+build_program(const char *fs_text)
+{
+	GLuint vs, fs, prog;
+
+	vs = piglit_compile_shader_text(GL_VERTEX_SHADER, vs_text);
+	fs = piglit_compile_shader_text(GL_FRAGMENT_SHADER, fs_text);
+	prog = piglit_link_simple_program(vs, fs);
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+
+	return prog;
+}
+
+static void
+setup_quad(void)
+{
+	/* 4x4 pixel quad: position xy, texcoord st. */
+	static const float verts[4][4] = {
+		{ 0, 0, 0, 0 },
+		{ 4, 0, 1, 0 },
+		{ 0, 4, 0, 1 },
+		{ 4, 4, 1, 1 },
+	};
+
+	if (vbo == 0) {
+		glGenBuffers(1, &vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts,
+			     GL_STATIC_DRAW);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glVertexPointer(2, GL_FLOAT, 4 * sizeof(float), (void *) 0);
+	glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(float),
+			  (void *) (2 * sizeof(float)));
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+}
+
+static void
+draw(void)
+{
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+static GLuint
+create_texture(const float *color)
+{
+	GLuint tex;
+
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_FLOAT,
+		     color);
+
+	return tex;
+}
+
+static bool
+setup_vector_program(void)
+{
+	progs[0] = build_program(fs_vector_text);
+	if (!progs[0])
+		return false;
+	glUseProgram(progs[0]);
+	glUniform4fv(glGetUniformLocation(progs[0], "color"), 1, colors[0]);
+	return true;
+}
+
+static bool
+setup_draw_only(void)
+{
+	return setup_vector_program();
+}
+
+static void
+op_draw_only(void *data)
+{
+	draw();
+}
+
+static bool
+setup_program(void)
+{
+	unsigned i;
+
+	for (i = 0; i < 2; i++) {
+		progs[i] = build_program(fs_vector_text);
+		if (!progs[i])
+			return false;
+		glUseProgram(progs[i]);
+		glUniform4fv(glGetUniformLocation(progs[i], "color"), 1,
+			     colors[i]);
+	}
+	return true;
+}
+
+static void
+op_program(void *data)
+{
+	glUseProgram(progs[toggle++ & 1]);
+	draw();
+}
+
+static bool
+setup_uniform_scalar(void)
+{
+	progs[0] = build_program(fs_scalar_text);
+	if (!progs[0])
+		return false;
+	glUseProgram(progs[0]);
+	uniform_locs[0] = glGetUniformLocation(progs[0], "r");
+	uniform_locs[1] = glGetUniformLocation(progs[0], "g");
+	uniform_locs[2] = glGetUniformLocation(progs[0], "b");
+	uniform_locs[3] = glGetUniformLocation(progs[0], "a");
+	return true;
+}
+
+static void
+op_uniform_scalar(void *data)
+{
+	const float *c = colors[toggle++ & 1];
+
+	glUniform1f(uniform_locs[0], c[0]);
+	glUniform1f(uniform_locs[1], c[1]);
+	glUniform1f(uniform_locs[2], c[2]);
+	glUniform1f(uniform_locs[3], c[3]);
+	draw();
+}
+
+static bool
+setup_uniform_vector(void)
+{
+	if (!setup_vector_program())
+		return false;
+	uniform_locs[0] = glGetUniformLocation(progs[0], "color");
+	return true;
+}
+
+static void
+op_uniform_vector(void *data)
+{
+	glUniform4fv(uniform_locs[0], 1, colors[toggle++ & 1]);
+	draw();
+}
+
+static bool
+setup_ubo(void)
+{
+	GLint align;
+	GLubyte *data;
+	unsigned i;
+
+	if (!piglit_is_extension_supported("GL_ARB_uniform_buffer_object"))
+		return false;
+
+	progs[0] = build_program(fs_ubo_text);
+	if (!progs[0])
+		return false;
+	glUseProgram(progs[0]);
+	glUniformBlockBinding(progs[0],
+			      glGetUniformBlockIndex(progs[0], "block"), 0);
+
+	/* One copy of each color, each at a legal binding offset. */
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+	ubo_stride = MAX2(align, (GLint) sizeof(colors[0]));
+
+	data = calloc(2, ubo_stride);
+	for (i = 0; i < 2; i++)
+		memcpy(data + i * ubo_stride, colors[i], sizeof(colors[i]));
+
+	glGenBuffers(1, &ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferData(GL_UNIFORM_BUFFER, 2 * ubo_stride, data,
+		     GL_DYNAMIC_DRAW);
+	glBindBufferRange(GL_UNIFORM_BUFFER, 0, ubo, 0, sizeof(colors[0]));
+	free(data);
+
+	return true;
+}
+
+static void
+op_ubo_update(void *data)
+{
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(colors[0]),
+			colors[toggle++ & 1]);
+	draw();
+}
+
+static void
+op_ubo_bind_range(void *data)
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, 0, ubo,
+			  (toggle++ & 1) * ubo_stride, sizeof(colors[0]));
+	draw();
+}
+
+static bool
+setup_textures(void)
+{
+	progs[0] = build_program(fs_texture_text);
+	if (!progs[0])
+		return false;
+	glUseProgram(progs[0]);
+	glUniform1i(glGetUniformLocation(progs[0], "tex"), 0);
+
+	textures[0] = create_texture(colors[0]);
+	textures[1] = create_texture(colors[1]);
+	return true;
+}
+
+static void
+op_texture(void *data)
+{
+	glBindTexture(GL_TEXTURE_2D, textures[toggle++ & 1]);
+	draw();
+}
+
+static bool
+setup_sampler(void)
+{
+	if (!piglit_is_extension_supported("GL_ARB_sampler_objects"))
+		return false;
+	if (!setup_textures())
+		return false;
+
+	glGenSamplers(2, samplers);
+	glSamplerParameteri(samplers[0], GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glSamplerParameteri(samplers[0], GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glSamplerParameteri(samplers[1], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(samplers[1], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	return true;
+}
+
+static void
+op_sampler(void *data)
+{
+	glBindSampler(0, samplers[toggle++ & 1]);
+	draw();
+}
+
+static bool
+setup_fbo(void)
+{
+	unsigned i;
+
+	if (!piglit_is_extension_supported("GL_EXT_framebuffer_object"))
+		return false;
+	if (!setup_vector_program())
+		return false;
+
+	glGenFramebuffersEXT(2, fbos);
+	for (i = 0; i < 2; i++) {
+		glGenTextures(1, &textures[i]);
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+			     piglit_width, piglit_height, 0,
+			     GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbos[i]);
+		glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT,
+					  GL_COLOR_ATTACHMENT0_EXT,
+					  GL_TEXTURE_2D, textures[i], 0);
+		if (glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) !=
+		    GL_FRAMEBUFFER_COMPLETE_EXT)
+			return false;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return true;
+}
+
+static void
+op_fbo(void *data)
+{
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbos[toggle++ & 1]);
+	draw();
+}
+
+static bool
+setup_vao(void)
+{
+	unsigned i;
+
+	if (!piglit_is_extension_supported("GL_ARB_vertex_array_object"))
+		return false;
+	if (!setup_vector_program())
+		return false;
+
+	glGenVertexArrays(2, vaos);
+	for (i = 0; i < 2; i++) {
+		glBindVertexArray(vaos[i]);
+		setup_quad();
+	}
+	return true;
+}
+
+static void
+op_vao(void *data)
+{
+	glBindVertexArray(vaos[toggle++ & 1]);
+	draw();
+}
+
+static bool
+setup_blend(void)
+{
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	return setup_vector_program();
+}
+
+static void
+op_blend(void *data)
+{
+	if (toggle++ & 1)
+		glEnable(GL_BLEND);
+	else
+		glDisable(GL_BLEND);
+	draw();
+}
+
+static bool
+setup_depth(void)
+{
+	glDepthFunc(GL_LEQUAL);
+	return setup_vector_program();
+}
+
+static void
+op_depth(void *data)
+{
+	if (toggle++ & 1)
+		glEnable(GL_DEPTH_TEST);
+	else
+		glDisable(GL_DEPTH_TEST);
+	draw();
+}
+
+static void
+finish(void *data)
+{
+	glFinish();
+}
+
+static void
+cleanup(void)
+{
+	unsigned i;
+
+	glUseProgram(0);
+	for (i = 0; i < 2; i++) {
+		if (progs[i])
+			glDeleteProgram(progs[i]);
+		progs[i] = 0;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDeleteTextures(2, textures);
+	memset(textures, 0, sizeof(textures));
+
+	if (samplers[0]) {
+		glBindSampler(0, 0);
+		glDeleteSamplers(2, samplers);
+		memset(samplers, 0, sizeof(samplers));
+	}
+	if (fbos[0]) {
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, piglit_winsys_fbo);
+		glDeleteFramebuffersEXT(2, fbos);
+		memset(fbos, 0, sizeof(fbos));
+	}
+	if (vaos[0]) {
+		glBindVertexArray(0);
+		glDeleteVertexArrays(2, vaos);
+		memset(vaos, 0, sizeof(vaos));
+	}
+	if (ubo) {
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glDeleteBuffers(1, &ubo);
+		ubo = 0;
+	}
+
+	glDisable(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+
+	/* Don't let a failed setup leak into the next case. */
+	while (glGetError() != GL_NO_ERROR)
+		;
+}
+
+static const struct {
+	const char *name;
+	bool (*setup)(void);
+	void (*op)(void *data);
+} cases[] = {
+	{ "draw-only", setup_draw_only, op_draw_only },
+	{ "program", setup_program, op_program },
+	{ "uniform-scalar", setup_uniform_scalar, op_uniform_scalar },
+	{ "uniform-vector", setup_uniform_vector, op_uniform_vector },
+	{ "ubo-update", setup_ubo, op_ubo_update },
+	{ "ubo-bind-range", setup_ubo, op_ubo_bind_range },
+	{ "texture", setup_textures, op_texture },
+	{ "sampler", setup_sampler, op_sampler },
+	{ "fbo", setup_fbo, op_fbo },
+	{ "vao", setup_vao, op_vao },
+	{ "blend", setup_blend, op_blend },
+	{ "depth", setup_depth, op_depth },
+};
+
+static const char *selected_case;
+
+void
+piglit_init(int argc, char **argv)
+{
+	unsigned i;
+
+	piglit_require_gl_version(20);
+
+	if (argc > 1) {
+		for (i = 0; i < ARRAY_SIZE(cases); i++) {
+			if (strcmp(argv[1], cases[i].name) == 0)
+				break;
+		}
+		if (i == ARRAY_SIZE(cases)) {
+			fprintf(stderr, "Unknown case: %s\n", argv[1]);
+			piglit_report_result(PIGLIT_FAIL);
+		}
+		selected_case = argv[1];
+	}
+
+	piglit_ortho_projection(piglit_width, piglit_height, GL_FALSE);
+}
+
+static enum piglit_result
+run_case(unsigned i, struct piglit_bench_result *bench_result)
+{
+	struct piglit_bench bench;
+
+	toggle = 0;
+	setup_quad();
+	if (!cases[i].setup()) {
+		printf("%s: not supported, skipping\n", cases[i].name);
+		return PIGLIT_SKIP;
+	}
+
+	memset(&bench, 0, sizeof(bench));
+	bench.name = cases[i].name;
+	bench.unit = "changes";
+	bench.work_per_op = 1.0;
+	bench.op = cases[i].op;
+	bench.finish = finish;
+	bench.secondary_unit = "draws";
+	bench.secondary_work_per_op = 1.0;
+
+	if (!piglit_bench_run(&bench, NULL, bench_result) ||
+	    !piglit_check_gl_error(GL_NO_ERROR))
+		return PIGLIT_FAIL;
+
+	piglit_bench_report(&bench, bench_result);
+	return PIGLIT_PASS;
+}
+
+enum piglit_result
+piglit_display(void)
+{
+	enum piglit_result result = PIGLIT_SKIP;
+	struct piglit_bench_result bench_result;
+	double baseline = 0.0;
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		enum piglit_result case_result;
+
+		if (selected_case && strcmp(selected_case, cases[i].name) != 0)
+			continue;
+
+		case_result = run_case(i, &bench_result);
+		if (case_result == PIGLIT_PASS) {
+			if (i == 0)
+				baseline = bench_result.stats.median;
+			else if (baseline > 0.0)
+				printf("%s: %.1f ns per change over draw-only\n",
+				       cases[i].name,
+				       (bench_result.stats.median - baseline) *
+				       1e9);
+		}
+		piglit_merge_result(&result, case_result);
+
+		cleanup();
+	}
+
+	piglit_present_results();
+
+	return result;
+}
@@ -0,0 +1,487 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file vertex-throughput.c
+ *
+ * Measure draws/s and vertices/s through the buffer object based submit
+ * paths.  glean's vertexPerf only covers immediate mode, client arrays,
+ * display lists and compiled vertex arrays; this covers what modern
+ * drivers actually see:
+ *
+ *  - vbo-static:  draws out of a GL_STATIC_DRAW buffer
+ *  - vbo-dynamic: glBufferSubData into a GL_DYNAMIC_DRAW buffer per draw
+ *  - vbo-stream:  orphan + glBufferSubData of a GL_STREAM_DRAW buffer
+ *  - map-range-unsynchronized: ring buffer filled with
+ *    GL_MAP_UNSYNCHRONIZED_BIT, invalidated on wrap
+ *  - map-range-invalidate: GL_MAP_INVALIDATE_BUFFER_BIT map per draw
+ *  - draw-elements-base-vertex: one shared index buffer, varying base vertex
+ *  - draw-instanced: GL_ARB_draw_instanced
+ *  - primitive-restart: one strip list split by the restart index
+ *
+ * Triangles are tiny so that rasterization stays out of the way and the
+ * numbers reflect vertex submission and driver CPU overhead.
+ *
+ * Usage: vertex-throughput [case]
+ * With no case, all supported cases are run.
+ */
+
+#include <stddef.h>
+
+#include "piglit-util-gl-common.h"
+#include "piglit-bench.h"
+
+int piglit_width = 256, piglit_height = 256;
+int piglit_window_mode = GLUT_RGB | GLUT_DOUBLE;
+
+#define TRIS_PER_DRAW 64
+#define VERTS_PER_DRAW (3 * TRIS_PER_DRAW)
+#define NUM_MESHES 64
+#define RING_MESHES 256
+#define NUM_INSTANCES 16
+#define RESTART_INDEX 0xffff
+
+struct vertex {
+	GLfloat pos[3];
+	GLubyte color[4];
+};
+
+static struct vertex meshes[NUM_MESHES][VERTS_PER_DRAW];
+static GLushort linear_indices[VERTS_PER_DRAW];
+static GLushort restart_indices[4 * TRIS_PER_DRAW];
+
+static GLuint vbo, ibo, prog;
+static unsigned current_mesh;
+static unsigned ring_slot;
+static enum {
+	RESTART_NONE,
+	RESTART_GL31,
+	RESTART_NV
+} restart_mode;
+
+static const char *instanced_vs_text =
+	"#extension GL_ARB_draw_instanced: require\n"
+	"void main()\n"
+	"{\n"
+	"	vec4 p = gl_Vertex;\n"
+	"	p.x += 4.0 * float(gl_InstanceIDARB);\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * p;\n"
+	"	gl_FrontColor = gl_Color;\n"
+	"}\n";
+
+static void
+generate_meshes(void)
+{
+	unsigned m, t, v;
+
+	for (m = 0; m < NUM_MESHES; m++) {
+		for (t = 0; t < TRIS_PER_DRAW; t++) {
+			/* 2x2 pixel triangles scattered over the window. */
+			float x = (float) ((m * 37 + t * 13) % (piglit_width - 4));
+			float y = (float) ((m * 11 + t * 29) % (piglit_height - 4));
+
+			for (v = 0; v < 3; v++) {
+				struct vertex *vert = &meshes[m][t * 3 + v];
+
+				vert->pos[0] = x + (v == 1 ? 2.0f : 0.0f);
+				vert->pos[1] = y + (v == 2 ? 2.0f : 0.0f);
+				vert->pos[2] = 0.0f;
+				vert->color[0] = (GLubyte) (m * 4);
+				vert->color[1] = (GLubyte) (t * 4);
+				vert->color[2] = (GLubyte) (v * 120);
+				vert->color[3] = 255;
+			}
+		}
+	}
+
+	for (v = 0; v < VERTS_PER_DRAW; v++)
+		linear_indices[v] = v;
+
+	for (t = 0; t < TRIS_PER_DRAW; t++) {
+		restart_indices[t * 4 + 0] = t * 3 + 0;
+		restart_indices[t * 4 + 1] = t * 3 + 1;
+		restart_indices[t * 4 + 2] = t * 3 + 2;
+		restart_indices[t * 4 + 3] = RESTART_INDEX;
+	}
+}
+
+static void
+set_vertex_pointers(void)
+{
+	glVertexPointer(3, GL_FLOAT, sizeof(struct vertex),
+			(void *) offsetof(struct vertex, pos));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(struct vertex),
+		       (void *) offsetof(struct vertex, color));
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+}
+
+static void
+create_buffer(GLenum target, GLuint *buf, GLsizeiptr size, const void *data,
+	      GLenum usage)
+{
+	glGenBuffers(1, buf);
+	glBindBuffer(target, *buf);
+	glBufferData(target, size, data, usage);
+}
+
+static unsigned
+next_mesh(void)
+{
+	current_mesh = (current_mesh + 1) % NUM_MESHES;
+	return current_mesh;
+}
+
+static void
+finish(void *data)
+{
+	glFinish();
+}
+
+static void
+op_vbo_static(void *data)
+{
+	glDrawArrays(GL_TRIANGLES, next_mesh() * VERTS_PER_DRAW,
+		     VERTS_PER_DRAW);
+}
+
+static void
+op_vbo_dynamic(void *data)
+{
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(meshes[0]),
+			meshes[next_mesh()]);
+	glDrawArrays(GL_TRIANGLES, 0, VERTS_PER_DRAW);
+}
+
+static void
+op_vbo_stream(void *data)
+{
+	glBufferData(GL_ARRAY_BUFFER, sizeof(meshes[0]), NULL,
+		     GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(meshes[0]),
+			meshes[next_mesh()]);
+	glDrawArrays(GL_TRIANGLES, 0, VERTS_PER_DRAW);
+}
+
+/**
+ * Map part of the vertex buffer for writing.  A failed mapping fails the
+ * benchmark rather than being timed as a fast one.
+ */
+static void *
+map_vertices(GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	void *ptr = glMapBufferRange(GL_ARRAY_BUFFER, offset, length, access);
+
+	if (ptr == NULL) {
+		fprintf(stderr, "glMapBufferRange failed: %s\n",
+			piglit_get_gl_error_name(glGetError()));
+		piglit_report_result(PIGLIT_FAIL);
+	}
+	return ptr;
+}
+
+static void
+op_map_range_unsynchronized(void *data)
+{
+	GLbitfield access = GL_MAP_WRITE_BIT;
+	void *ptr;
+
+	if (ring_slot == RING_MESHES) {
+		/* Start over in fresh storage instead of waiting for the
+		 * GPU to finish with the old contents.
+		 */
+		access |= GL_MAP_INVALIDATE_BUFFER_BIT;
+		ring_slot = 0;
+	} else {
+		access |= GL_MAP_UNSYNCHRONIZED_BIT |
+			GL_MAP_INVALIDATE_RANGE_BIT;
+	}
+
+	ptr = map_vertices(ring_slot * sizeof(meshes[0]), sizeof(meshes[0]),
+			   access);
+	memcpy(ptr, meshes[next_mesh()], sizeof(meshes[0]));
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+
+	glDrawArrays(GL_TRIANGLES, ring_slot * VERTS_PER_DRAW,
+		     VERTS_PER_DRAW);
+	ring_slot++;
+}
+
+static void
+op_map_range_invalidate(void *data)
+{
+	void *ptr = map_vertices(0, sizeof(meshes[0]),
+				 GL_MAP_WRITE_BIT |
+				 GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	memcpy(ptr, meshes[next_mesh()], sizeof(meshes[0]));
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	glDrawArrays(GL_TRIANGLES, 0, VERTS_PER_DRAW);
+}
+
+static void
+op_draw_elements_base_vertex(void *data)
+{
+	glDrawElementsBaseVertex(GL_TRIANGLES, VERTS_PER_DRAW,
+				 GL_UNSIGNED_SHORT, NULL,
+				 next_mesh() * VERTS_PER_DRAW);
+}
+
+static void
+op_draw_instanced(void *data)
+{
+	glDrawArraysInstancedARB(GL_TRIANGLES, next_mesh() * VERTS_PER_DRAW,
+				 VERTS_PER_DRAW, NUM_INSTANCES);
+}
+
+static void
+op_primitive_restart(void *data)
+{
+	glDrawElementsBaseVertex(GL_TRIANGLE_STRIP,
+				 ARRAY_SIZE(restart_indices),
+				 GL_UNSIGNED_SHORT, NULL,
+				 next_mesh() * VERTS_PER_DRAW);
+}
+
+static bool
+setup_vbo_static(void)
+{
+	create_buffer(GL_ARRAY_BUFFER, &vbo, sizeof(meshes), meshes,
+		      GL_STATIC_DRAW);
+	return true;
+}
+
+static bool
+setup_vbo_dynamic(void)
+{
+	create_buffer(GL_ARRAY_BUFFER, &vbo, sizeof(meshes[0]), meshes[0],
+		      GL_DYNAMIC_DRAW);
+	return true;
+}
+
+static bool
+setup_vbo_stream(void)
+{
+	create_buffer(GL_ARRAY_BUFFER, &vbo, sizeof(meshes[0]), meshes[0],
+		      GL_STREAM_DRAW);
+	return true;
+}
+
+static bool
+setup_map_range_unsynchronized(void)
+{
+	if (!piglit_is_extension_supported("GL_ARB_map_buffer_range"))
+		return false;
+
+	create_buffer(GL_ARRAY_BUFFER, &vbo, RING_MESHES * sizeof(meshes[0]),
+		      NULL, GL_STREAM_DRAW);
+	ring_slot = 0;
+	return true;
+}
+
+static bool
+setup_map_range_invalidate(void)
+{
+	if (!piglit_is_extension_supported("GL_ARB_map_buffer_range"))
+		return false;
+
+	create_buffer(GL_ARRAY_BUFFER, &vbo, sizeof(meshes[0]), NULL,
+		      GL_STREAM_DRAW);
+	return true;
+}
+
+static bool
+setup_draw_elements_base_vertex(void)
+{
+	if (!piglit_is_extension_supported("GL_ARB_draw_elements_base_vertex"))
+		return false;
+
+	create_buffer(GL_ARRAY_BUFFER, &vbo, sizeof(meshes), meshes,
+		      GL_STATIC_DRAW);
+	create_buffer(GL_ELEMENT_ARRAY_BUFFER, &ibo, sizeof(linear_indices),
+		      linear_indices, GL_STATIC_DRAW);
+	return true;
+}
+
+static bool
+setup_draw_instanced(void)
+{
+	GLuint vs;
+
+	if (!piglit_is_extension_supported("GL_ARB_draw_instanced") ||
+	    piglit_get_gl_version() < 20)
+		return false;
+
+	vs = piglit_compile_shader_text(GL_VERTEX_SHADER, instanced_vs_text);
+	prog = piglit_link_simple_program(vs, 0);
+	glDeleteShader(vs);
+	if (!prog)
+		return false;
+	glUseProgram(prog);
+
+	create_buffer(GL_ARRAY_BUFFER, &vbo, sizeof(meshes), meshes,
+		      GL_STATIC_DRAW);
+	return true;
+}
+
+static bool
+setup_primitive_restart(void)
+{
+	if (!piglit_is_extension_supported("GL_ARB_draw_elements_base_vertex"))
+		return false;
+
+	if (piglit_get_gl_version() >= 31) {
+		restart_mode = RESTART_GL31;
+		glEnable(GL_PRIMITIVE_RESTART);
+		glPrimitiveRestartIndex(RESTART_INDEX);
+	} else if (piglit_is_extension_supported("GL_NV_primitive_restart")) {
+		restart_mode = RESTART_NV;
+		glEnableClientState(GL_PRIMITIVE_RESTART_NV);
+		glPrimitiveRestartIndexNV(RESTART_INDEX);
+	} else {
+		return false;
+	}
+
+	create_buffer(GL_ARRAY_BUFFER, &vbo, sizeof(meshes), meshes,
+		      GL_STATIC_DRAW);
+	create_buffer(GL_ELEMENT_ARRAY_BUFFER, &ibo, sizeof(restart_indices),
+		      restart_indices, GL_STATIC_DRAW);
+	return true;
+}
+
+static void
+cleanup(void)
+{
+	if (prog) {
+		glUseProgram(0);
+		glDeleteProgram(prog);
+		prog = 0;
+	}
+	if (restart_mode == RESTART_GL31)
+		glDisable(GL_PRIMITIVE_RESTART);
+	else if (restart_mode == RESTART_NV)
+		glDisableClientState(GL_PRIMITIVE_RESTART_NV);
+	restart_mode = RESTART_NONE;
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glDeleteBuffers(1, &vbo);
+	glDeleteBuffers(1, &ibo);
+	vbo = ibo = 0;
+}
+
+static const struct {
+	const char *name;
+	bool (*setup)(void);
+	void (*op)(void *data);
+	unsigned vertices_per_draw;
+} cases[] = {
+	{ "vbo-static", setup_vbo_static, op_vbo_static,
+	  VERTS_PER_DRAW },
+	{ "vbo-dynamic", setup_vbo_dynamic, op_vbo_dynamic,
+	  VERTS_PER_DRAW },
+	{ "vbo-stream", setup_vbo_stream, op_vbo_stream,
+	  VERTS_PER_DRAW },
+	{ "map-range-unsynchronized", setup_map_range_unsynchronized,
+	  op_map_range_unsynchronized, VERTS_PER_DRAW },
+	{ "map-range-invalidate", setup_map_range_invalidate,
+	  op_map_range_invalidate, VERTS_PER_DRAW },
+	{ "draw-elements-base-vertex", setup_draw_elements_base_vertex,
+	  op_draw_elements_base_vertex, VERTS_PER_DRAW },
+	{ "draw-instanced", setup_draw_instanced, op_draw_instanced,
+	  VERTS_PER_DRAW * NUM_INSTANCES },
+	{ "primitive-restart", setup_primitive_restart, op_primitive_restart,
+	  VERTS_PER_DRAW },
+};
+
+static const char *selected_case;
+
+void
+piglit_init(int argc, char **argv)
+{
+	unsigned i;
+
+	piglit_require_gl_version(15);
+
+	if (argc > 1) {
+		for (i = 0; i < ARRAY_SIZE(cases); i++) {
+			if (strcmp(argv[1], cases[i].name) == 0)
+				break;
+		}
+		if (i == ARRAY_SIZE(cases)) {
+			fprintf(stderr, "Unknown case: %s\n", argv[1]);
+			piglit_report_result(PIGLIT_FAIL);
+		}
+		selected_case = argv[1];
+	}
+
+	generate_meshes();
+	piglit_ortho_projection(piglit_width, piglit_height, GL_FALSE);
+}
+
+enum piglit_result
+piglit_display(void)
+{
+	enum piglit_result result = PIGLIT_SKIP;
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		struct piglit_bench bench;
+		struct piglit_bench_result bench_result;
+
+		if (selected_case && strcmp(selected_case, cases[i].name) != 0)
+			continue;
+
+		if (!cases[i].setup()) {
+			printf("%s: not supported, skipping\n", cases[i].name);
+			cleanup();
+			continue;
+		}
+
+		set_vertex_pointers();
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		memset(&bench, 0, sizeof(bench));
+		bench.name = cases[i].name;
+		bench.unit = "draws";
+		bench.work_per_op = 1.0;
+		bench.op = cases[i].op;
+		bench.finish = finish;
+		bench.secondary_unit = "vertices";
+		bench.secondary_work_per_op = cases[i].vertices_per_draw;
+
+		if (piglit_bench_run(&bench, NULL, &bench_result) &&
+		    piglit_check_gl_error(GL_NO_ERROR)) {
+			piglit_bench_report(&bench, &bench_result);
+			piglit_merge_result(&result, PIGLIT_PASS);
+		} else {
+			piglit_merge_result(&result, PIGLIT_FAIL);
+		}
+
+		cleanup();
+	}
+
+	piglit_present_results();
+
+	return result;
+}
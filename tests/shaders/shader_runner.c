@@ -38,6 +38,7 @@
 #endif
 #include "piglit-util-gl-common.h"
 #include "piglit-vbo.h"
+#include "piglit-bench.h"
 
 int piglit_width = 250, piglit_height = 250;
 int piglit_window_mode = GLUT_RGB | GLUT_ALPHA | GLUT_DOUBLE;
@@ -49,6 +50,18 @@ static float glsl_version = 0.0;
 static int gl_max_fragment_uniform_components;
 static int gl_max_vertex_uniform_components;
 
+/** Set by -bench: time the draws in the [test] section. */
+static bool bench_mode = false;
+
+/**
+ * Set while the [test] commands are run again to time them, after the
+ * probes have checked the test's own run.  Probes are skipped then.
+ */
+static bool benchmarking = false;
+
+/** Batches timed with GL_TIME_ELAPSED per benchmark. */
+#define BENCH_GPU_SAMPLES 10
+
 const char *path = NULL;
 const char *test_start = NULL;
 
@@ -1123,19 +1136,223 @@ handle_texparameter(const char *line)
 	piglit_report_result(PIGLIT_FAIL);
 }
 
-enum piglit_result
-piglit_display(void)
+static bool
+run_test_commands(const char *line, const char *end);
+
+static bool
+is_draw_command(const char *line)
+{
+	return string_match("draw rect", line) ||
+		string_match("draw instanced rect", line) ||
+		string_match("draw arrays", line);
+}
+
+static bool
+is_probe_command(const char *line)
+{
+	return string_match("probe", line) ||
+		string_match("relative probe", line);
+}
+
+/**
+ * Return the start of the `bench end' line closing the block that starts
+ * at \c line.  A block is repeated as is, so it can't contain probes.
+ */
+static const char *
+find_bench_end(const char *line)
 {
+	while (line[0] != '\0') {
+		line = eat_whitespace(line);
+		if (string_match("bench end", line))
+			return line;
+		if (is_probe_command(line)) {
+			printf("probes can't be in a bench block\n");
+			piglit_report_result(PIGLIT_FAIL);
+		}
+		line = strchrnul(line, '\n');
+		if (line[0] != '\0')
+			line++;
+	}
+
+	printf("`bench begin' without `bench end'\n");
+	piglit_report_result(PIGLIT_FAIL);
+	return NULL;
+}
+
+struct bench_block {
+	const char *start;
+	const char *end;
+	bool pass;
+};
+
+static void
+bench_block_op(void *data)
+{
+	struct bench_block *block = data;
+
+	if (!run_test_commands(block->start, block->end))
+		block->pass = false;
+}
+
+static void
+bench_block_finish(void *data)
+{
+	glFinish();
+}
+
+static GLuint64
+get_query_result_ui64(GLuint query)
+{
+	GLuint64 result = 0;
+
+	if (gl_version >= 3.3 ||
+	    piglit_is_extension_supported("GL_ARB_timer_query"))
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+	else
+		glGetQueryObjectui64vEXT(query, GL_QUERY_RESULT, &result);
+
+	return result;
+}
+
+/**
+ * Time batches of the block with GL_TIME_ELAPSED queries, and report
+ * them like the CPU timings in \c cpu_result.
+ */
+static void
+report_gpu_time(const struct piglit_bench *bench,
+		const struct piglit_bench_result *cpu_result)
+{
+	struct piglit_bench gpu_bench = *bench;
+	struct piglit_bench_result result = *cpu_result;
+	struct piglit_bench_options options;
+	double samples[BENCH_GPU_SAMPLES];
+	char name[128];
+	GLuint query;
+	unsigned i, j;
+
+	glGenQueries(1, &query);
+	for (i = 0; i < BENCH_GPU_SAMPLES; i++) {
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		for (j = 0; j < cpu_result->batch_size; j++)
+			bench->op(bench->data);
+		glEndQuery(GL_TIME_ELAPSED);
+
+		samples[i] = get_query_result_ui64(query) * 1e-9 /
+			cpu_result->batch_size;
+	}
+	glDeleteQueries(1, &query);
+
+	piglit_bench_default_options(&options);
+	piglit_bench_compute_stats(samples, BENCH_GPU_SAMPLES,
+				   options.outlier_threshold, &result.stats);
+	result.warmup_batches = 0;
+	result.rate = 0.0;
+	result.secondary_rate = 0.0;
+	if (result.stats.median > 0.0) {
+		result.rate = (bench->work_per_op > 0.0 ?
+			       bench->work_per_op : 1.0) / result.stats.median;
+		result.secondary_rate =
+			bench->secondary_work_per_op / result.stats.median;
+	}
+
+	snprintf(name, sizeof(name), "%s (gpu)", bench->name);
+	gpu_bench.name = name;
+	piglit_bench_report(&gpu_bench, &result);
+}
+
+/**
+ * Run the commands from \c start to \c end once, counting the fragments
+ * they draw, and then benchmark them.  The benchmark is named by the text
+ * at \c label, the rest of a `bench begin' line, or after the commands if
+ * \c label is NULL.
+ */
+static bool
+run_bench_block(const char *label, const char *start, const char *end)
+{
+	static unsigned num_benchmarks = 0;
+	struct bench_block block;
+	struct piglit_bench bench;
+	struct piglit_bench_result result;
+	GLuint query = 0, fragments = 0;
 	const char *line;
-	bool pass = true;
-	GLbitfield clear_bits = 0;
+	char name[96];
+	int length;
+
+	num_benchmarks++;
+	if (label != NULL) {
+		label = eat_whitespace(label);
+		length = strchrnul(label, '\n') - label;
+		while (length > 0 && isspace((int) label[length - 1]))
+			length--;
+		if (length > 0)
+			snprintf(name, sizeof(name), "%.*s", length, label);
+		else
+			snprintf(name, sizeof(name), "bench %u",
+				 num_benchmarks);
+	} else {
+		snprintf(name, sizeof(name), "%u: %.*s", num_benchmarks,
+			 (int) (end - start), start);
+	}
 
-	if (test_start == NULL)
-		return PIGLIT_PASS;
+	if (gl_version >= 1.5) {
+		glGenQueries(1, &query);
+		glBeginQuery(GL_SAMPLES_PASSED, query);
+	}
+	block.start = start;
+	block.end = end;
+	block.pass = run_test_commands(start, end);
+	if (query != 0) {
+		glEndQuery(GL_SAMPLES_PASSED);
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT, &fragments);
+		glDeleteQueries(1, &query);
+	}
 
+	memset(&bench, 0, sizeof(bench));
+	bench.name = name;
+	bench.unit = "draws";
+	for (line = start; line < end && line[0] != '\0'; line++) {
+		line = eat_whitespace(line);
+		if (is_draw_command(line))
+			bench.work_per_op++;
+		line = strchrnul(line, '\n');
+	}
+	bench.op = bench_block_op;
+	bench.finish = bench_block_finish;
+	bench.data = &block;
+	if (query != 0) {
+		bench.secondary_unit = "fragments";
+		bench.secondary_work_per_op = fragments;
+	}
 
-	line = test_start;
-	while (line[0] != '\0') {
+	if (!piglit_bench_run(&bench, NULL, &result)) {
+		printf("%s: benchmark failed to run\n", name);
+		return false;
+	}
+	piglit_bench_report(&bench, &result);
+
+	if (gl_version >= 3.3 ||
+	    piglit_is_extension_supported("GL_ARB_timer_query") ||
+	    piglit_is_extension_supported("GL_EXT_timer_query"))
+		report_gpu_time(&bench, &result);
+
+	return block.pass;
+}
+
+static GLbitfield clear_bits = 0;
+
+/**
+ * Run the [test] commands from \c line up to \c end, or to the end of the
+ * script if \c end is NULL, and return whether all of their probes passed.
+ *
+ * While benchmarking, time each draw outside a bench block and each bench
+ * block, and skip the probes.
+ */
+static bool
+run_test_commands(const char *line, const char *end)
+{
+	bool pass = true;
+
+	while (line[0] != '\0' && (end == NULL || line < end)) {
 		float c[32];
 		double d[4];
 		int x, y, w, h, l, tex, level;
@@ -1143,7 +1360,33 @@ piglit_display(void)
 
 		line = eat_whitespace(line);
 
-		if (string_match("clear color", line)) {
+		if (benchmarking && end == NULL && is_draw_command(line)) {
+			pass = run_bench_block(NULL, line,
+					       strchrnul(line, '\n')) && pass;
+		} else if (benchmarking && is_probe_command(line)) {
+			/* The test's own run has been checked. */
+		} else if (string_match("bench begin", line)) {
+			const char *block = strchrnul(line, '\n');
+			const char *block_end;
+
+			if (end != NULL) {
+				printf("bench blocks can't be nested\n");
+				piglit_report_result(PIGLIT_FAIL);
+			}
+			if (block[0] != '\0')
+				block++;
+			block_end = find_bench_end(block);
+			if (benchmarking)
+				pass = run_bench_block(line + strlen("bench begin"),
+						       block, block_end) && pass;
+			else
+				pass = run_test_commands(block, block_end) &&
+					pass;
+			line = block_end;
+		} else if (string_match("bench end", line)) {
+			printf("`bench end' without `bench begin'\n");
+			piglit_report_result(PIGLIT_FAIL);
+		} else if (string_match("clear color", line)) {
 			get_floats(line + 11, c, 4);
 			glClearColor(c[0], c[1], c[2], c[3]);
 			clear_bits |= GL_COLOR_BUFFER_BIT;
@@ -1379,8 +1622,31 @@ piglit_display(void)
 			line++;
 	}
 
+	return pass;
+}
+
+enum piglit_result
+piglit_display(void)
+{
+	bool pass;
+
+	if (test_start == NULL)
+		return PIGLIT_PASS;
+
+	pass = run_test_commands(test_start, NULL);
+
 	piglit_present_results();
 
+	/* Time the draws only now, so that repeating them can't change
+	 * what the probes see.  Running all of the commands again gives
+	 * each draw the state it had in the test.
+	 */
+	if (bench_mode) {
+		benchmarking = true;
+		pass = run_test_commands(test_start, NULL) && pass;
+		benchmarking = false;
+	}
+
 	if (piglit_automatic) {
 		/* Free our resources, useful for valgrinding. */
 		piglit_DeleteProgram(prog);
@@ -1395,6 +1661,7 @@ void
 piglit_init(int argc, char **argv)
 {
 	const char *glsl_version_string;
+	int i;
 
 	piglit_require_GLSL();
 
@@ -1410,6 +1677,16 @@ piglit_init(int argc, char **argv)
 	glGetIntegerv(GL_MAX_VERTEX_UNIFORM_COMPONENTS,
 		      &gl_max_vertex_uniform_components);
 
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-bench") == 0) {
+			bench_mode = true;
+			memmove(&argv[i], &argv[i + 1],
+				(argc - i) * sizeof(char *));
+			argc--;
+			i--;
+		}
+	}
+
 	if (argc > 2) {
 		path = argv[2];
 	} else if (argc > 1) {
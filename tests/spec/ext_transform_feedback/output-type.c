@@ -26,6 +26,10 @@
  *
  * Test that writing a variable with a specific GLSL type into a TFB buffer
  * works as expected.
+ *
+ * The argument names the type to test.  With "all", every type is tested
+ * in one context, sharing one buffer, and each type's result is reported
+ * as a subtest.  "all -subtest <type>" tests just that type.
  */
 
 #include "piglit-util-gl-common.h"
@@ -1210,105 +1214,90 @@ struct test_desc {
 
 	{NULL}
 };
-struct test_desc *test;
+struct test_desc *test;	/* NULL when running every test */
 
 GLuint buf;
-GLuint prog;
+bool use_map_range;
 
 #define NUM_VERTICES 3
 #define DEFAULT_VALUE 0.123456
 
-void piglit_init(int argc, char **argv)
+/**
+ * Check the requirements of a single test.  With \c report set, report a
+ * skip and exit instead of returning false.
+ */
+static bool
+test_supported(const struct test_desc *t, bool report)
 {
-	GLuint vs;
-	unsigned i;
 	int maxcomps;
-	float *data;
 
-	/* Parse params. */
-	for (i = 1; i < argc; i++) {
-		struct test_desc *t;
+	if (!t->is_floating_point) {
+		bool es;
+		int major, minor;
 
-		for (t = tests; t->name; t++) {
-			if (!strcmp(argv[i], t->name)) {
-				test = t;
-				goto test_ready;
-			}
-		}
-		fprintf(stderr, "Unknown test name.\n");
-		exit(1);
+		if (report)
+			piglit_require_GLSL_version(130);
+		piglit_get_glsl_version(&es, &major, &minor);
+		if (es || 100 * major + minor < 130)
+			return false;
 	}
-	test = &tests[0];
-test_ready:
 
-	printf("Testing type: %s\n", test->name);
+	glGetIntegerv(GL_MAX_TRANSFORM_FEEDBACK_INTERLEAVED_COMPONENTS, &maxcomps);
+	if (maxcomps < t->num_elements) {
+		if (report)
+			piglit_report_result(PIGLIT_SKIP);
+		return false;
+	}
+	return true;
+}
 
-	piglit_ortho_projection(piglit_width, piglit_height, GL_FALSE);
+static enum piglit_result
+run_test(const struct test_desc *t)
+{
+	bool pass = true;
+	const void *ptr;
+	const float *ptr_float;
+	const GLint *ptr_int;
+	unsigned i, size = t->num_elements*NUM_VERTICES*sizeof(float);
+	GLuint vs, prog;
+	float *data;
+	static const float verts[NUM_VERTICES*2] = {
+		10, 10,
+		10, 20,
+		20, 20
+	};
 
-	/* Check the driver. */
-	if (piglit_get_gl_version() < 15) {
-		fprintf(stderr, "OpenGL 1.5 required.\n");
-		piglit_report_result(PIGLIT_SKIP);
-	}
-	piglit_require_GLSL();
-	piglit_require_transform_feedback();
-	if (!test->is_floating_point)
-		piglit_require_GLSL_version(130);
+	printf("Testing type: %s\n", t->name);
 
-	glGetIntegerv(GL_MAX_TRANSFORM_FEEDBACK_INTERLEAVED_COMPONENTS, &maxcomps);
-	if (maxcomps < test->num_elements) {
-		piglit_report_result(PIGLIT_SKIP);
-	}
+	if (!test_supported(t, false))
+		return PIGLIT_SKIP;
 
 	/* Create shaders. */
-	vs = piglit_compile_shader_text(GL_VERTEX_SHADER, test->vs);
+	vs = piglit_compile_shader_text(GL_VERTEX_SHADER, t->vs);
+	if (!vs)
+		return PIGLIT_FAIL;
 	prog = piglit_CreateProgram();
 	piglit_AttachShader(prog, vs);
-	piglit_TransformFeedbackVaryings(prog, test->num_varyings,
-					 test->varyings,
+	piglit_TransformFeedbackVaryings(prog, t->num_varyings,
+					 (const char **) t->varyings,
 					 GL_INTERLEAVED_ATTRIBS_EXT);
 	piglit_LinkProgram(prog);
+	piglit_DeleteShader(vs);
 	if (!piglit_link_check_status(prog)) {
 		piglit_DeleteProgram(prog);
-		piglit_report_result(PIGLIT_FAIL);
+		return PIGLIT_FAIL;
 	}
 
-	/* Set up the transform feedback buffer. */
-	data = malloc(test->num_elements*NUM_VERTICES*sizeof(float));
-	for (i = 0; i < test->num_elements*NUM_VERTICES; i++) {
+	/* Fill the part of the buffer this test writes with a default
+	 * value, so that a missing output is noticed even if the previous
+	 * test left the expected values there.
+	 */
+	data = malloc(size);
+	for (i = 0; i < t->num_elements*NUM_VERTICES; i++) {
 		data[i] = DEFAULT_VALUE;
 	}
-
-	glGenBuffers(1, &buf);
-	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER_EXT, buf);
-	glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER_EXT,
-		     test->num_elements*NUM_VERTICES*sizeof(float),
-		     data, GL_STREAM_READ);
-
-	assert(glGetError() == 0);
-
-	piglit_BindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER_EXT, 0, buf);
-
-	assert(glGetError() == 0);
-
-	glClearColor(0.2, 0.2, 0.2, 1.0);
-	glEnableClientState(GL_VERTEX_ARRAY);
-
+	glBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER_EXT, 0, size, data);
 	free(data);
-}
-
-enum piglit_result piglit_display(void)
-{
-	GLboolean pass = GL_TRUE;
-	void *ptr;
-	float *ptr_float;
-	GLint *ptr_int;
-	unsigned i;
-	static const float verts[NUM_VERTICES*2] = {
-		10, 10,
-		10, 20,
-		20, 20
-	};
 
 	glClear(GL_COLOR_BUFFER_BIT);
 
@@ -1320,28 +1309,38 @@ enum piglit_result piglit_display(void)
 	glVertexPointer(2, GL_FLOAT, 0, verts);
 	glDrawArrays(GL_TRIANGLES, 0, NUM_VERTICES);
 	piglit_EndTransformFeedback();
+	piglit_UseProgram(0);
+	piglit_DeleteProgram(prog);
 
 	assert(glGetError() == 0);
 
-	ptr = glMapBuffer(GL_TRANSFORM_FEEDBACK_BUFFER_EXT, GL_READ_ONLY);
+	/* The buffer is sized for the largest test; only map what this
+	 * one wrote.
+	 */
+	if (use_map_range)
+		ptr = glMapBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER_EXT, 0,
+				       size, GL_MAP_READ_BIT);
+	else
+		ptr = glMapBuffer(GL_TRANSFORM_FEEDBACK_BUFFER_EXT,
+				  GL_READ_ONLY);
 	ptr_float = ptr;
 	ptr_int = ptr;
-	for (i = 0; i < test->num_elements*NUM_VERTICES; i++) {
-		if (test->is_floating_point) {
-			float value = test->expected_float[i % test->num_elements];
+	for (i = 0; i < t->num_elements*NUM_VERTICES; i++) {
+		if (t->is_floating_point) {
+			float value = t->expected_float[i % t->num_elements];
 
 			if (fabs(ptr_float[i] - value) > 0.01) {
 				printf("Buffer[%i]: %f,  Expected: %f\n", i,
 				       ptr_float[i], value);
-				pass = GL_FALSE;
+				pass = false;
 			}
 		} else {
-			GLint value = test->expected_int[i % test->num_elements];
+			GLint value = t->expected_int[i % t->num_elements];
 
 			if (ptr_int[i] != value) {
 				printf("Buffer[%i]: %i,  Expected: %i\n", i,
 				       ptr_int[i], value);
-				pass = GL_FALSE;
+				pass = false;
 			}
 		}
 	}
@@ -1349,7 +1348,93 @@ enum piglit_result piglit_display(void)
 
 	assert(glGetError() == 0);
 
+	return pass ? PIGLIT_PASS : PIGLIT_FAIL;
+}
+
+void piglit_init(int argc, char **argv)
+{
+	unsigned i;
+	unsigned max_elements = 0;
+	struct test_desc *t;
+
+	/* Parse params.  "all" runs every test in this process. */
+	for (i = 1; i < argc; i++) {
+		const char *name = argv[i];
+
+		if (!strcmp(name, "all")) {
+			test = NULL;
+			if (!piglit_selected_subtest)
+				goto test_ready;
+			name = piglit_selected_subtest;
+		}
+		for (t = tests; t->name; t++) {
+			if (!strcmp(name, t->name)) {
+				test = t;
+				goto test_ready;
+			}
+		}
+		fprintf(stderr, "Unknown test name.\n");
+		exit(1);
+	}
+	test = &tests[0];
+test_ready:
+
+	piglit_ortho_projection(piglit_width, piglit_height, GL_FALSE);
+
+	/* Check the driver. */
+	if (piglit_get_gl_version() < 15) {
+		fprintf(stderr, "OpenGL 1.5 required.\n");
+		piglit_report_result(PIGLIT_SKIP);
+	}
+	piglit_require_GLSL();
+	piglit_require_transform_feedback();
+
+	if (test) {
+		test_supported(test, true);
+		max_elements = test->num_elements;
+	} else {
+		for (t = tests; t->name; t++)
+			max_elements = MAX2(max_elements, t->num_elements);
+	}
+
+	use_map_range = piglit_get_gl_version() >= 30 ||
+		piglit_is_extension_supported("GL_ARB_map_buffer_range");
+
+	/* Set up one transform feedback buffer for all tests. */
+	glGenBuffers(1, &buf);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER_EXT, buf);
+	glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER_EXT,
+		     max_elements*NUM_VERTICES*sizeof(float),
+		     NULL, GL_STREAM_READ);
+
+	assert(glGetError() == 0);
+
+	piglit_BindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER_EXT, 0, buf);
+
+	assert(glGetError() == 0);
+
+	glClearColor(0.2, 0.2, 0.2, 1.0);
+	glEnableClientState(GL_VERTEX_ARRAY);
+}
+
+enum piglit_result piglit_display(void)
+{
+	enum piglit_result result;
+	struct test_desc *t;
+
+	if (test) {
+		result = run_test(test);
+	} else {
+		result = PIGLIT_SKIP;
+		for (t = tests; t->name; t++) {
+			enum piglit_result r = run_test(t);
+
+			piglit_report_subtest_result(r, t->name);
+			piglit_merge_result(&result, r);
+		}
+	}
+
 	piglit_present_results();
 
-	return pass ? PIGLIT_PASS : PIGLIT_FAIL;
+	return result;
 }
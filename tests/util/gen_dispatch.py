@@ -65,17 +65,23 @@
 #   typedef GLvoid * (APIENTRY *PFNGLMAPBUFFERPROC)(GLenum, GLenum);
 #   typedef GLvoid * (APIENTRY *PFNGLMAPBUFFERARBPROC)(GLenum, GLenum);
 #
-# - A set of extern declarations for "dispatch function pointers".
-#   There is one dispatch function pointer for each set of synonymous
-#   functions in the GL API, e.g.:
+# - The struct piglit_dispatch_functions, which holds one "dispatch
+#   function pointer" for each set of synonymous functions in the GL
+#   API, named after the first function of the set without the "gl"
+#   prefix, e.g.:
 #
-#   extern PFNGLMAPBUFFERPROC piglit_dispatch_glMapBuffer;
+#   struct piglit_dispatch_functions {
+#     ...
+#     PFNGLMAPBUFFERPROC MapBuffer;
+#     ...
+#   };
 #
 # - A set of #defines mapping each function name to the corresponding
-#   dispatch function pointer, e.g.:
+#   dispatch function pointer of the current dispatch table (see
+#   piglit-dispatch.h), e.g.:
 #
-#   #define glMapBuffer piglit_dispatch_glMapBuffer
-#   #define glMapBufferARB piglit_dispatch_glMapBuffer
+#   #define glMapBuffer (piglit_dispatch_current->functions.MapBuffer)
+#   #define glMapBufferARB (piglit_dispatch_current->functions.MapBuffer)
 #
 # - A #define for each enum in the GL API, e.g.:
 #
@@ -97,22 +103,24 @@
 #   the synonymous names the implementation supports (by consulting
 #   the current GL version and/or the extension string), and calls
 #   either get_core_proc() or get_ext_proc() to get the function
-#   pointer.  It stores the result in the dispatch function pointer,
-#   and then returns it as a generic void(void) function pointer.  If
-#   the implementation does not support any of the synonymous names,
-#   it calls unsupported().  E.g.:
+#   pointer.  It stores the result in the dispatch function pointer
+#   of the current dispatch table, and then returns it as a generic
+#   void(void) function pointer.  If the implementation does not
+#   support any of the synonymous names, it calls unsupported().
+#   E.g.:
 #
 #   /* glMapBuffer (GL 1.5) */
 #   /* glMapbufferARB (GL_ARB_vertex_buffer_object) */
 #   static piglit_dispatch_function_ptr resolve_glMapBuffer()
 #   {
+#     struct piglit_dispatch_table *table = piglit_dispatch_current;
 #     if (check_version(15))
-#       piglit_dispatch_glMapBuffer = (PFNGLMAPBUFFERPROC) get_core_proc("glMapBuffer", 15);
+#       table->functions.MapBuffer = (PFNGLMAPBUFFERPROC) get_core_proc("glMapBuffer", 15);
 #     else if (check_extension("GL_ARB_vertex_buffer_object"))
-#       piglit_dispatch_glMapBuffer = (PFNGLMAPBUFFERARBPROC) get_ext_proc("glMapBufferARB");
+#       table->functions.MapBuffer = (PFNGLMAPBUFFERARBPROC) get_ext_proc("glMapBufferARB");
 #     else
 #       unsupported("MapBuffer");
-#     return (piglit_dispatch_function_ptr) piglit_dispatch_glMapBuffer;
+#     return (piglit_dispatch_function_ptr) table->functions.MapBuffer;
 #   }
 #
 # - A stub function corresponding to each set of synonymous functions
@@ -126,21 +134,39 @@
 #   {
 #     check_initialized();
 #     resolve_glMapBuffer();
-#     return piglit_dispatch_glMapBuffer(target, access);
+#     return piglit_dispatch_current->functions.MapBuffer(target, access);
 #   }
 #
-# - A declaration for each dispatch function pointer, e.g.:
+# - An instrumented wrapper corresponding to each set of synonymous
+#   functions, which times the call to the function the resolve
+#   function found.  When GL call instrumentation is enabled (see
+#   piglit-dispatch.c), the resolve function saves that function in
+#   the table's "real" functions and points the dispatch function
+#   pointer at the wrapper instead.  E.g.:
 #
-#   PFNGLMAPBUFFERPROC piglit_dispatch_glMapBuffer = stub_glMapBuffer;
+#   static GLvoid * APIENTRY instrumented_glMapBuffer(GLenum target, GLenum access)
+#   {
+#     GLvoid * call_result;
+#     const int64_t call_start = begin_call();
+#     call_result = piglit_dispatch_current->real.MapBuffer(target, access);
+#     end_call(1234, call_start);
+#     return call_result;
+#   }
 #
-# - An function, reset_dispatch_pointers(), which resets each dispatch
-#   pointer to the corresponding stub function.
+# - A table stub_functions, with each dispatch function pointer set to
+#   the corresponding stub function, from which new dispatch tables
+#   are initialized, and the dispatch table default_table, which
+#   starts out the same.
 #
 # - A table function_names, containing the name of each function in
 #   alphabetical order (including the "gl" prefix).
 #
 # - A table function_resolvers, containing a pointer to the resolve
 #   function corresponding to each entry in function_names.
+#
+# - A table dispatch_set_names, containing the name of the primary
+#   function of each set of synonymous functions.  The instrumented
+#   wrappers identify themselves by their index into this table.
 
 import collections
 import json
@@ -327,11 +353,16 @@ class DispatchSet(object):
     def primary_function(self):
 	return self.cat_fn_pairs[0][1]
 
-    # The name of the dispatch pointer that should be generated for
-    # this dispatch set.
+    # The name of the member of struct piglit_dispatch_functions that
+    # should be generated for this dispatch set.
     @property
-    def dispatch_name(self):
-	return 'piglit_dispatch_' + self.primary_function.gl_name
+    def field_name(self):
+	return self.primary_function.name
+
+    # The dispatch pointer of this dispatch set in the dispatch table
+    # "table".
+    def dispatch_pointer(self, table = 'table'):
+	return '{0}->functions.{1}'.format(table, self.field_name)
 
     # The name of the stub function that should be generated for this
     # dispatch set.
@@ -345,6 +376,18 @@ class DispatchSet(object):
     def resolve_name(self):
 	return 'resolve_' + self.primary_function.gl_name
 
+    # The name of the instrumented wrapper that should be generated
+    # for this dispatch set.
+    @property
+    def instrumented_name(self):
+	return 'instrumented_' + self.primary_function.gl_name
+
+    # The pointer through which the instrumented wrapper calls the
+    # implementation.
+    @property
+    def real_pointer(self):
+	return 'piglit_dispatch_current->real.' + self.field_name
+
     @staticmethod
     def __sort_key(cat_fn_pair):
 	if cat_fn_pair[0].kind == 'GL':
@@ -470,7 +513,7 @@ def generate_resolve_function(ds):
 	    typedef_name = f.typedef_name
 
 	code = '{0} = ({1}) {2};'.format(
-	    ds.dispatch_name, typedef_name, getter)
+	    ds.dispatch_pointer(), typedef_name, getter)
 
 	condition_code_pairs.append((condition, code))
 
@@ -484,6 +527,8 @@ def generate_resolve_function(ds):
     resolve_fn = 'static piglit_dispatch_function_ptr {0}()\n'.format(
 	ds.resolve_name)
     resolve_fn += '{\n'
+    resolve_fn += '\tstruct piglit_dispatch_table *table = ' \
+	'piglit_dispatch_current;\n'
 
     # Output code that checks each condition in turn and executes the
     # appropriate case.  To make the generated code more palatable
@@ -502,9 +547,21 @@ def generate_resolve_function(ds):
 		resolve_fn += '\telse if ({0})\n\t\t{1}\n'.format(
 		    *condition_code_pairs[i])
 
+    # If call instrumentation is enabled, divert the dispatch function
+    # pointer to the instrumented wrapper.  The pointer still points
+    # to the stub if the function is unsupported (and unsupported()
+    # returned).
+    resolve_fn += '\tif (call_stats != NULL && {0} != {1}) {{\n'.format(
+	ds.dispatch_pointer(), ds.stub_name)
+    resolve_fn += '\t\ttable->real.{0} = {1};\n'.format(
+	ds.field_name, ds.dispatch_pointer())
+    resolve_fn += '\t\t{0} = {1};\n'.format(
+	ds.dispatch_pointer(), ds.instrumented_name)
+    resolve_fn += '\t}\n'
+
     # Output code to return the dispatch function.
     resolve_fn += '\treturn (piglit_dispatch_function_ptr) {0};\n'.format(
-	ds.dispatch_name)
+	ds.dispatch_pointer())
     resolve_fn += '}\n'
     return resolve_fn
 
@@ -523,22 +580,72 @@ def generate_stub_function(ds):
     # Output the call to the dispatch function.
     stub_fn += '\t{0}{1}({2});\n'.format(
 	'return ' if f0.return_type != 'void' else '',
-	ds.dispatch_name, ', '.join(f0.param_names))
+	ds.dispatch_pointer('piglit_dispatch_current'),
+	', '.join(f0.param_names))
     stub_fn += '}\n'
     return stub_fn
 
 
-# Generate the reset_dispatch_pointers() function, which sets each
-# dispatch pointer to point to the corresponding stub function.
-def generate_dispatch_pointer_resetter(dispatch_sets):
+# Generate the instrumented wrapper for a given DispatchSet, whose
+# index in the dispatch_set_names table is set_index.
+def generate_instrumented_function(ds, set_index):
+    f0 = ds.primary_function
+
+    # Start the wrapper function
+    fn = 'static {0}\n'.format(
+	f0.c_form('APIENTRY ' + ds.instrumented_name, anonymous_args = False))
+    fn += '{\n'
+    if f0.return_type != 'void':
+	fn += '\t{0} call_result;\n'.format(f0.return_type)
+    fn += '\tconst int64_t call_start = begin_call();\n'
+
+    # Output the timed call to the implementation.
+    fn += '\t{0}{1}({2});\n'.format(
+	'call_result = ' if f0.return_type != 'void' else '',
+	ds.real_pointer, ', '.join(f0.param_names))
+    fn += '\tend_call({0}, call_start);\n'.format(set_index)
+    if f0.return_type != 'void':
+	fn += '\treturn call_result;\n'
+    fn += '}\n'
+    return fn
+
+
+# Generate the dispatch_set_names table.
+def generate_dispatch_set_names(dispatch_sets):
     result = []
-    result.append('static void\n')
-    result.append('reset_dispatch_pointers()\n')
-    result.append('{\n')
+    result.append('static const char * const dispatch_set_names[] = {\n')
+    for ds in dispatch_sets:
+	result.append('\t"{0}",\n'.format(ds.primary_function.gl_name))
+    result.append('};\n')
+    return ''.join(result)
+
+
+# Generate the struct piglit_dispatch_functions definition.
+def generate_functions_struct(dispatch_sets):
+    result = []
+    result.append('\nstruct piglit_dispatch_functions {\n')
     for ds in dispatch_sets:
-	result.append(
-	    '\t{0} = {1};\n'.format(ds.dispatch_name, ds.stub_name))
-    result.append('}\n')
+	result.append('\t{0} {1};\n'.format(
+		ds.primary_function.typedef_name, ds.field_name))
+    result.append('};\n')
+    return ''.join(result)
+
+
+# Generate the stub_functions table and the default dispatch table,
+# whose dispatch pointers point to the corresponding stub functions.
+def generate_stub_tables(dispatch_sets):
+    stubs = ''.join('\t{0},\n'.format(ds.stub_name) for ds in dispatch_sets)
+    result = []
+    result.append('static const struct piglit_dispatch_functions '
+		  'stub_functions = {\n')
+    result.append(stubs)
+    result.append('};\n')
+    result.append('\n')
+    result.append('static struct piglit_dispatch_table default_table = {\n')
+    result.append('{\n')
+    result.append(stubs)
+    result.append('},\n')
+    result.append('};\n')
     return ''.join(result)
 
 
@@ -579,7 +686,10 @@ def generate_code(api):
 
     dispatch_sets = api.compute_dispatch_sets()
 
-    for ds in dispatch_sets:
+    # Emit the dispatch table layout
+    h_contents.append(generate_functions_struct(dispatch_sets))
+
+    for set_index, ds in enumerate(dispatch_sets):
 	f0 = ds.primary_function
 
 	# Emit comment block
@@ -589,15 +699,19 @@ def generate_code(api):
 	c_contents.append(comments)
 	h_contents.append(comments)
 
-	# Emit extern declaration of dispatch pointer
-	h_contents.append(
-	    'extern {0} {1};\n'.format(f0.typedef_name, ds.dispatch_name))
-
 	# Emit defines aliasing each GL function to the dispatch
-	# pointer
+	# pointer of the current dispatch table
 	for _, f in ds.cat_fn_pairs:
-	    h_contents.append(
-		'#define {0} {1}\n'.format(f.gl_name, ds.dispatch_name))
+	    h_contents.append('#define {0} ({1})\n'.format(
+		    f.gl_name, ds.dispatch_pointer('piglit_dispatch_current')))
+
+	# Emit instrumented wrapper
+	c_contents.append(generate_instrumented_function(ds, set_index))
+
+	# Emit forward declaration of the stub function, which the
+	# resolve function refers to
+	c_contents.append('static {0};\n'.format(
+		f0.c_form('APIENTRY ' + ds.stub_name, anonymous_args = True)))
 
 	# Emit resolve function
 	c_contents.append(generate_resolve_function(ds))
@@ -605,19 +719,20 @@ def generate_code(api):
 	# Emit stub function
 	c_contents.append(generate_stub_function(ds))
 
-	# Emit initializer for dispatch pointer
-	c_contents.append(
-	    '{0} {1} = {2};\n'.format(
-		f0.typedef_name, ds.dispatch_name, ds.stub_name))
-
-    # Emit dispatch pointer initialization function
-    c_contents.append(generate_dispatch_pointer_resetter(dispatch_sets))
+    # Emit the tables of stub functions
+    c_contents.append('\n')
+    c_contents.append(generate_stub_tables(dispatch_sets))
 
     c_contents.append('\n')
 
     # Emit function_names and function_resolvers tables.
     c_contents.append(generate_function_names_and_resolvers(dispatch_sets))
 
+    c_contents.append('\n')
+
+    # Emit dispatch_set_names table.
+    c_contents.append(generate_dispatch_set_names(dispatch_sets))
+
     # Emit enum #defines
     for name, value in api.compute_unique_enums():
 	h_contents.append('#define GL_{0} {1}\n'.format(name, value))
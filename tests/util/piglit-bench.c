@@ -0,0 +1,394 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-bench.c
+ *
+ * Micro-benchmark harness.  See piglit-bench.h.
+ */
+
+#include "piglit-bench.h"
+
+/* Scale factor that makes the MAD a consistent estimator of the standard
+ * deviation for normally distributed data.
+ */
+#define MAD_TO_SIGMA 1.4826
+
+/* Warmup is over once this many consecutive batches agree to within
+ * WARMUP_TOLERANCE of their predecessor.
+ */
+#define WARMUP_STABLE_BATCHES 3
+#define WARMUP_TOLERANCE 0.05
+
+#define MAX_BATCH_SIZE (1u << 30)
+
+void
+piglit_bench_default_options(struct piglit_bench_options *options)
+{
+	const char *env;
+
+	options->min_batch_time = 0.01;
+	options->max_warmup_time = 1.0;
+	options->max_time = 5.0;
+	options->min_samples = 10;
+	options->max_samples = 200;
+	options->target_rel_mad = 0.01;
+	options->outlier_threshold = 3.5;
+
+	/* Let nightly runs trade precision for wall time without
+	 * rebuilding.
+	 */
+	env = getenv("PIGLIT_BENCH_MAX_TIME");
+	if (env != NULL && atof(env) > 0.0)
+		options->max_time = atof(env);
+}
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+	const double x = *(const double *) a;
+	const double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * Linearly interpolated percentile of \c sorted, with \c p in [0, 1].
+ */
+double
+piglit_bench_percentile(const double *sorted, unsigned n, double p)
+{
+	double pos;
+	unsigned i;
+
+	if (n == 0)
+		return 0.0;
+
+	pos = CLAMP(p, 0.0, 1.0) * (n - 1);
+	i = (unsigned) pos;
+	if (i + 1 >= n)
+		return sorted[n - 1];
+
+	return sorted[i] + (pos - i) * (sorted[i + 1] - sorted[i]);
+}
+
+/**
+ * Median absolute deviation of \c sorted around \c median.  \c scratch
+ * must have room for \c n values.
+ */
+static double
+median_absolute_deviation(const double *sorted, unsigned n, double median,
+			  double *scratch)
+{
+	unsigned i;
+
+	for (i = 0; i < n; i++)
+		scratch[i] = fabs(sorted[i] - median);
+	qsort(scratch, n, sizeof(double), compare_doubles);
+
+	return piglit_bench_percentile(scratch, n, 0.5);
+}
+
+/**
+ * Summarize \c samples.  \c samples is sorted in place, and the samples
+ * that survive outlier rejection are moved to its start.
+ */
+void
+piglit_bench_compute_stats(double *samples, unsigned n,
+			   double outlier_threshold,
+			   struct piglit_bench_stats *stats)
+{
+	double *scratch;
+	double median, mad, sum;
+	unsigned first, last, i;
+
+	memset(stats, 0, sizeof(*stats));
+	if (n == 0)
+		return;
+
+	scratch = malloc(n * sizeof(double));
+	qsort(samples, n, sizeof(double), compare_doubles);
+
+	/* Reject outliers based on the statistics of the full set.  Since
+	 * the samples are sorted, the survivors are a contiguous range.
+	 */
+	first = 0;
+	last = n;
+	if (outlier_threshold > 0.0 && scratch != NULL) {
+		double limit;
+
+		median = piglit_bench_percentile(samples, n, 0.5);
+		mad = median_absolute_deviation(samples, n, median, scratch);
+		limit = outlier_threshold * MAD_TO_SIGMA * mad;
+
+		if (limit > 0.0) {
+			while (first < last && median - samples[first] > limit)
+				first++;
+			while (last > first && samples[last - 1] - median > limit)
+				last--;
+		}
+	}
+
+	if (first != 0) {
+		/* Keep the survivors at the start of the array. */
+		memmove(samples, samples + first,
+			(last - first) * sizeof(double));
+	}
+	stats->outliers = n - (last - first);
+	n = last - first;
+
+	sum = 0.0;
+	for (i = 0; i < n; i++)
+		sum += samples[i];
+
+	stats->samples = n;
+	stats->min = samples[0];
+	stats->max = samples[n - 1];
+	stats->mean = sum / n;
+	stats->median = piglit_bench_percentile(samples, n, 0.5);
+	stats->p05 = piglit_bench_percentile(samples, n, 0.05);
+	stats->p25 = piglit_bench_percentile(samples, n, 0.25);
+	stats->p75 = piglit_bench_percentile(samples, n, 0.75);
+	stats->p95 = piglit_bench_percentile(samples, n, 0.95);
+	if (scratch != NULL)
+		stats->mad = median_absolute_deviation(samples, n,
+						       stats->median, scratch);
+
+	free(scratch);
+}
+
+/**
+ * Run \c bench->op \c count times and return the elapsed time per call,
+ * in seconds.
+ */
+static double
+run_batch(const struct piglit_bench *bench, unsigned count)
+{
+	int64_t start, end;
+	unsigned i;
+
+	if (bench->prepare)
+		bench->prepare(bench->data);
+
+	start = piglit_time_get_nano();
+	for (i = 0; i < count; i++)
+		bench->op(bench->data);
+	if (bench->finish)
+		bench->finish(bench->data);
+	end = piglit_time_get_nano();
+
+	return (end - start) * 1e-9 / count;
+}
+
+/**
+ * Smallest observable step of the clock, in seconds.
+ */
+static double
+clock_resolution(void)
+{
+	int64_t best = INT64_MAX;
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		int64_t start = piglit_time_get_nano();
+		int64_t now;
+
+		while ((now = piglit_time_get_nano()) == start)
+			;
+		best = MIN2(best, now - start);
+	}
+
+	return best * 1e-9;
+}
+
+bool
+piglit_bench_run(const struct piglit_bench *bench,
+		 const struct piglit_bench_options *user_options,
+		 struct piglit_bench_result *result)
+{
+	struct piglit_bench_options options;
+	double min_batch_time, prev, per_op, elapsed;
+	double *samples, *scratch;
+	unsigned batch_size, stable, n;
+	bool retimed;
+	int64_t start;
+
+	memset(result, 0, sizeof(*result));
+
+	if (bench->op == NULL)
+		return false;
+
+	if (user_options)
+		options = *user_options;
+	else
+		piglit_bench_default_options(&options);
+
+	options.min_samples = MAX2(options.min_samples, 1);
+	options.max_samples = MAX2(options.max_samples, options.min_samples);
+
+	samples = malloc(options.max_samples * sizeof(double));
+	scratch = malloc(options.max_samples * sizeof(double));
+	if (samples == NULL || scratch == NULL) {
+		free(samples);
+		free(scratch);
+		return false;
+	}
+
+	/* Keep the quantization error of a single sample below 0.1%. */
+	min_batch_time = MAX2(options.min_batch_time,
+			      1000.0 * clock_resolution());
+
+	/* Grow the batch until it is long enough to time reliably.  This
+	 * also serves as the first part of the warmup.  The very first call
+	 * often pays for one-time work, so it is timed twice before it is
+	 * allowed to settle the batch size at one.
+	 */
+	batch_size = 1;
+	retimed = false;
+	start = piglit_time_get_nano();
+	for (;;) {
+		per_op = run_batch(bench, batch_size);
+		if (per_op * batch_size >= min_batch_time ||
+		    batch_size >= MAX_BATCH_SIZE) {
+			if (batch_size > 1 || retimed)
+				break;
+			retimed = true;
+			continue;
+		}
+
+		if (per_op > 0.0) {
+			double want = 1.2 * min_batch_time / per_op;
+			batch_size = (unsigned) MIN2(want,
+						     (double) MAX_BATCH_SIZE);
+			batch_size = MAX2(batch_size, 2);
+		} else {
+			batch_size *= 2;
+		}
+	}
+	result->batch_size = batch_size;
+
+	/* Keep running until the per-op time stops drifting, so that
+	 * shader compiles, buffer migrations, cache fills and clock ramping
+	 * don't end up in the samples.
+	 */
+	prev = per_op;
+	stable = 0;
+	while (stable < WARMUP_STABLE_BATCHES &&
+	       (piglit_time_get_nano() - start) * 1e-9 <
+	       options.max_warmup_time) {
+		per_op = run_batch(bench, batch_size);
+		result->warmup_batches++;
+
+		if (fabs(per_op - prev) <= WARMUP_TOLERANCE * prev)
+			stable++;
+		else
+			stable = 0;
+		prev = per_op;
+	}
+
+	n = 0;
+	start = piglit_time_get_nano();
+	do {
+		samples[n++] = run_batch(bench, batch_size);
+		elapsed = (piglit_time_get_nano() - start) * 1e-9;
+
+		if (n >= options.min_samples && options.target_rel_mad > 0.0) {
+			struct piglit_bench_stats s;
+
+			memcpy(scratch, samples, n * sizeof(double));
+			piglit_bench_compute_stats(scratch, n, 0.0, &s);
+			if (s.mad <= options.target_rel_mad * s.median)
+				break;
+		}
+	} while (n < options.max_samples &&
+		 (n < options.min_samples || elapsed < options.max_time));
+
+	piglit_bench_compute_stats(samples, n, options.outlier_threshold,
+				   &result->stats);
+	free(samples);
+	free(scratch);
+
+	if (result->stats.median > 0.0) {
+		double work = bench->work_per_op > 0.0 ?
+			bench->work_per_op : 1.0;
+		result->rate = work / result->stats.median;
+		result->secondary_rate =
+			bench->secondary_work_per_op / result->stats.median;
+	}
+
+	return true;
+}
+
+/**
+ * Print \c s as a quoted Python string literal.
+ */
+static void
+print_python_string(const char *s)
+{
+	putchar('\'');
+	for (; *s; s++) {
+		if (*s == '\'' || *s == '\\')
+			putchar('\\');
+		putchar(*s);
+	}
+	putchar('\'');
+}
+
+void
+piglit_bench_report(const struct piglit_bench *bench,
+		    const struct piglit_bench_result *result)
+{
+	const struct piglit_bench_stats *s = &result->stats;
+	const char *unit = bench->unit ? bench->unit : "ops";
+	const double rel_mad = s->median > 0.0 ? s->mad / s->median : 0.0;
+
+	printf("%s: %.6g %s/s (median %.4g us/op, MAD %.2f%%, "
+	       "%u samples of %u, %u outliers)\n",
+	       bench->name, result->rate, unit, s->median * 1e6,
+	       100.0 * rel_mad, s->samples, result->batch_size, s->outliers);
+	if (bench->secondary_unit) {
+		printf("%s: %.6g %s/s\n", bench->name,
+		       result->secondary_rate, bench->secondary_unit);
+	}
+
+	printf("PIGLIT: {'bench': {");
+	print_python_string(bench->name);
+	printf(": {'unit': ");
+	print_python_string(unit);
+	if (bench->secondary_unit) {
+		printf(", 'secondary_unit': ");
+		print_python_string(bench->secondary_unit);
+		printf(", 'secondary_rate': %.9g", result->secondary_rate);
+	}
+	printf(", 'rate': %.9g, 'median': %.9g, 'mad': %.9g, "
+	       "'mean': %.9g, 'min': %.9g, 'max': %.9g, "
+	       "'p05': %.9g, 'p25': %.9g, 'p75': %.9g, 'p95': %.9g, "
+	       "'samples': %u, 'outliers': %u, 'batch_size': %u, "
+	       "'warmup_batches': %u}}}\n",
+	       result->rate, s->median, s->mad,
+	       s->mean, s->min, s->max,
+	       s->p05, s->p25, s->p75, s->p95,
+	       s->samples, s->outliers, result->batch_size,
+	       result->warmup_batches);
+	fflush(stdout);
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-bench.h
+ *
+ * Micro-benchmark harness.
+ *
+ * This is a successor to glean's Timer/BasicStats pair that any piglit
+ * test can use.  A benchmark is an operation that is repeated in batches.
+ * The harness picks a batch size long enough to dwarf the clock
+ * resolution, runs batches until the per-operation time settles (warmup),
+ * and then collects samples until the spread is small enough or the time
+ * budget runs out.  Results are summarized with robust statistics (median,
+ * median absolute deviation, percentiles) after rejecting outliers, and
+ * are reported both as a human readable line and as a \c PIGLIT: record
+ * that the Python framework merges into the test's result dictionary
+ * under the \c 'bench' key.
+ *
+ * Example:
+ *
+ * \code
+ *	static void draw(void *data) { piglit_draw_rect(-1, -1, 2, 2); }
+ *	static void finish(void *data) { glFinish(); }
+ *
+ *	struct piglit_bench bench = { "draw-rect", "draws", 1.0,
+ *				      draw, NULL, finish, NULL };
+ *	struct piglit_bench_result result;
+ *
+ *	if (piglit_bench_run(&bench, NULL, &result))
+ *		piglit_bench_report(&bench, &result);
+ * \endcode
+ */
+
+#pragma once
+#ifndef PIGLIT_BENCH_H
+#define PIGLIT_BENCH_H
+
+#include "piglit-util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct piglit_bench {
+	/** Key of this benchmark in the result dictionary. */
+	const char *name;
+
+	/** Unit of work done by \c op, for example "draws".  May be NULL. */
+	const char *unit;
+
+	/** Units of work done by one call to \c op.  Zero means one. */
+	double work_per_op;
+
+	/** The operation being measured. */
+	void (*op)(void *data);
+
+	/** Optional.  Called before each batch, outside the timed region. */
+	void (*prepare)(void *data);
+
+	/**
+	 * Optional.  Called at the end of each batch, inside the timed
+	 * region, to wait for asynchronous work (e.g. \c glFinish).
+	 */
+	void (*finish)(void *data);
+
+	void *data;
+
+	/**
+	 * Optional second unit of work to report a rate for, for example
+	 * "vertices" for a benchmark whose \c unit is "draws".
+	 */
+	const char *secondary_unit;
+	double secondary_work_per_op;
+};
+
+struct piglit_bench_options {
+	/** Minimum duration of one sample, in seconds. */
+	double min_batch_time;
+
+	/** Time budget for warmup, in seconds. */
+	double max_warmup_time;
+
+	/** Time budget for sampling, in seconds. */
+	double max_time;
+
+	unsigned min_samples;
+	unsigned max_samples;
+
+	/**
+	 * Stop sampling early once MAD / median drops below this value.
+	 */
+	double target_rel_mad;
+
+	/**
+	 * Samples further than this many (normal-consistent) MADs away from
+	 * the median are rejected as outliers.  Zero disables rejection.
+	 */
+	double outlier_threshold;
+};
+
+/**
+ * Summary of a set of samples.  After \c piglit_bench_run, all times are
+ * in seconds per call to \c op.
+ */
+struct piglit_bench_stats {
+	unsigned samples;	/**< Samples kept after outlier rejection */
+	unsigned outliers;	/**< Samples rejected */
+	double min;
+	double max;
+	double mean;
+	double median;
+	double mad;		/**< Median absolute deviation */
+	double p05;
+	double p25;
+	double p75;
+	double p95;
+};
+
+struct piglit_bench_result {
+	struct piglit_bench_stats stats;
+
+	/** Calls to \c op per sample. */
+	unsigned batch_size;
+
+	/** Batches run before the timings settled. */
+	unsigned warmup_batches;
+
+	/** Work units per second, derived from the median. */
+	double rate;
+
+	/** Secondary work units per second, if \c secondary_unit is set. */
+	double secondary_rate;
+};
+
+void
+piglit_bench_default_options(struct piglit_bench_options *options);
+
+bool
+piglit_bench_run(const struct piglit_bench *bench,
+		 const struct piglit_bench_options *options,
+		 struct piglit_bench_result *result);
+
+void
+piglit_bench_report(const struct piglit_bench *bench,
+		    const struct piglit_bench_result *result);
+
+double
+piglit_bench_percentile(const double *sorted, unsigned n, double p);
+
+void
+piglit_bench_compute_stats(double *samples, unsigned n,
+			   double outlier_threshold,
+			   struct piglit_bench_stats *stats);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+
+#endif /* PIGLIT_BENCH_H */
@@ -53,28 +53,81 @@ static piglit_error_function_ptr unsupported = NULL;
 static piglit_error_function_ptr get_proc_address_failure = NULL;
 
 /**
- * The GL version extracted from glGetString(GL_VERSION), times 10.
- * For example, if the GL version is 2.1, the value 21 is stored here.
- *
- * We cache this here because calling glGetString is prohibited
- * between glBegin and glEnd, and to avoid the inefficiency of
- * redundant glGetString queries.
+ * True if piglit_dispatch_init has been called.
+ */
+static bool is_initialized = false;
+
+/**
+ * Number of calls to, and total time spent in, the functions of one
+ * dispatch set.
  */
-static int gl_version = 0;
+struct call_stats {
+	uint64_t count;
+	int64_t time;
+};
 
 /**
- * The GL extension string returned by glGetString(GL_EXTENSIONS).
+ * Call statistics for each entry of dispatch_set_names, if GL call
+ * instrumentation is enabled, or NULL otherwise.
  *
- * We cache this here because calling glGetString is prohibited
- * between glBegin and glEnd, and to avoid the inefficiency of
- * redundant glGetString queries.
+ * Setting the environment variable PIGLIT_GL_CALL_STATS to a value
+ * other than 0 enables instrumentation.  Each resolve function then
+ * points the dispatch function pointer at an instrumented wrapper,
+ * which counts and times the calls, and the functions that took the
+ * most calls and time are reported when the test exits.  The counters
+ * are not atomic, so tests that call GL from several threads get
+ * approximate counts.
  */
-static const char *gl_extensions = NULL;
+static struct call_stats *call_stats = NULL;
 
 /**
- * True if piglit_dispatch_init has been called.
+ * Binary call trace, written if the environment variable
+ * PIGLIT_GL_CALL_TRACE names a file (which also enables
+ * instrumentation).  The trace starts with the 8 bytes "PIGLTRC1", a
+ * uint32_t count of function names and that many NUL terminated names,
+ * followed by one struct call_trace_record per call.  All values are
+ * in host byte order.
  */
-static bool is_initialized = false;
+static FILE *call_trace = NULL;
+
+struct call_trace_record {
+	uint32_t function;	/**< Index into the name table */
+	uint32_t duration;	/**< In nanoseconds, saturated */
+	int64_t start;		/**< piglit_time_get_nano() at call */
+};
+
+/**
+ * Instrumented wrappers call this function before calling into the
+ * implementation.
+ */
+static inline int64_t
+begin_call()
+{
+	return piglit_time_get_nano();
+}
+
+/**
+ * Instrumented wrappers call this function after calling into the
+ * implementation.  \c index is the index of the dispatch set in
+ * dispatch_set_names.
+ */
+static inline void
+end_call(unsigned index, int64_t start)
+{
+	const int64_t duration = piglit_time_get_nano() - start;
+
+	call_stats[index].count++;
+	call_stats[index].time += duration;
+
+	if (call_trace) {
+		struct call_trace_record record;
+
+		record.function = index;
+		record.duration = MIN2(duration, (int64_t) UINT32_MAX);
+		record.start = start;
+		fwrite(&record, sizeof(record), 1, call_trace);
+	}
+}
 
 /**
  * Generated code calls this function to verify that the dispatch
@@ -117,6 +170,21 @@ get_ext_proc(const char *name)
 	return function_pointer;
 }
 
+/**
+ * Query the GL version and extension string of the current context for
+ * check_version() and check_extension(), the first time they are needed
+ * with the current dispatch table.  Note: this is safe to do while
+ * resolving a function because the only GL function it calls is
+ * glGetString(), and the stub function for glGetString does not need to
+ * call check_version() or check_extension().
+ */
+static void
+query_context_info(struct piglit_dispatch_table *table)
+{
+	table->gl_version = piglit_get_gl_version();
+	table->gl_extensions = (const char *) glGetString(GL_EXTENSIONS);
+}
+
 /**
  * Generated code calls this function to determine whether a given GL
  * version is supported.
@@ -124,7 +192,9 @@ get_ext_proc(const char *name)
 static inline bool
 check_version(int required_version)
 {
-	return gl_version >= required_version;
+	if (piglit_dispatch_current->gl_version == 0)
+		query_context_info(piglit_dispatch_current);
+	return piglit_dispatch_current->gl_version >= required_version;
 }
 
 /**
@@ -134,13 +204,186 @@ check_version(int required_version)
 static inline bool
 check_extension(const char *name)
 {
-	return piglit_is_extension_in_string(gl_extensions, name);
+	if (piglit_dispatch_current->gl_version == 0)
+		query_context_info(piglit_dispatch_current);
+	return piglit_is_extension_in_string(
+		piglit_dispatch_current->gl_extensions, name);
 }
 
 #include "generated_dispatch.c"
 
+PIGLIT_THREAD_LOCAL struct piglit_dispatch_table *piglit_dispatch_current =
+	&default_table;
+
+/**
+ * Create a dispatch table for a context.  Make it current with
+ * piglit_dispatch_make_current() while the context is current.
+ *
+ * The table's functions, version and extensions are looked up when GL
+ * is first called through it, so it can be created before the context.
+ */
+struct piglit_dispatch_table *
+piglit_dispatch_create_table(void)
+{
+	struct piglit_dispatch_table *table =
+		calloc(1, sizeof(struct piglit_dispatch_table));
+
+	if (table == NULL) {
+		printf("Failed to allocate a dispatch table\n");
+		piglit_report_result(PIGLIT_FAIL);
+	}
+	table->functions = stub_functions;
+	return table;
+}
+
+void
+piglit_dispatch_destroy_table(struct piglit_dispatch_table *table)
+{
+	if (piglit_dispatch_current == table)
+		piglit_dispatch_current = &default_table;
+	free(table);
+}
+
+/**
+ * Dispatch the calling thread's GL calls through \c table, or through
+ * the default table if \c table is NULL.
+ */
+void
+piglit_dispatch_make_current(struct piglit_dispatch_table *table)
+{
+	piglit_dispatch_current = table ? table : &default_table;
+}
+
+/** Number of functions listed by report_call_stats. */
+#define CALL_STATS_TOP 10
+
+static int
+compare_call_counts(const void *x, const void *y)
+{
+	const uint64_t a = call_stats[*(const unsigned *) x].count;
+	const uint64_t b = call_stats[*(const unsigned *) y].count;
+	return (a < b) - (a > b);
+}
+
+static int
+compare_call_times(const void *x, const void *y)
+{
+	const int64_t a = call_stats[*(const unsigned *) x].time;
+	const int64_t b = call_stats[*(const unsigned *) y].time;
+	return (a < b) - (a > b);
+}
+
+/**
+ * Print the first CALL_STATS_TOP functions of \c order that were
+ * called at all, as a Python list of [name, calls, seconds] lists.
+ */
+static void
+print_call_stats_list(const unsigned *order, unsigned n)
+{
+	unsigned i;
+
+	printf("[");
+	for (i = 0; i < MIN2(n, CALL_STATS_TOP); i++) {
+		const struct call_stats *stats = &call_stats[order[i]];
+
+		if (stats->count == 0)
+			break;
+		printf("%s['%s', %llu, %.9g]", i ? ", " : "",
+		       dispatch_set_names[order[i]],
+		       (unsigned long long) stats->count,
+		       stats->time * 1e-9);
+	}
+	printf("]");
+}
+
+/**
+ * Report the functions that took the most calls and time.  Registered
+ * with atexit(), so the record follows the result printed by
+ * piglit_report_result(), and the Python framework merges both into
+ * the test's result dictionary under the 'gl_calls' key.
+ */
+static void
+report_call_stats(void)
+{
+	const unsigned n = ARRAY_SIZE(dispatch_set_names);
+	unsigned *order = malloc(n * sizeof(unsigned));
+	uint64_t total_count = 0;
+	int64_t total_time = 0;
+	unsigned i;
+
+	if (call_trace) {
+		fclose(call_trace);
+		call_trace = NULL;
+	}
+
+	if (order == NULL)
+		return;
+
+	for (i = 0; i < n; i++) {
+		order[i] = i;
+		total_count += call_stats[i].count;
+		total_time += call_stats[i].time;
+	}
+
+	printf("PIGLIT: {'gl_calls': {'calls': %llu, 'time': %.9g, "
+	       "'by_count': ",
+	       (unsigned long long) total_count, total_time * 1e-9);
+	qsort(order, n, sizeof(unsigned), compare_call_counts);
+	print_call_stats_list(order, n);
+	printf(", 'by_time': ");
+	qsort(order, n, sizeof(unsigned), compare_call_times);
+	print_call_stats_list(order, n);
+	printf("}}\n");
+	fflush(stdout);
+
+	free(order);
+}
+
 /**
- * Initialize the dispatch mechanism.
+ * Enable GL call instrumentation if the environment asks for it.  See
+ * call_stats and call_trace.
+ */
+static void
+init_call_instrumentation(void)
+{
+	static const char magic[8] = { 'P', 'I', 'G', 'L', 'T', 'R', 'C', '1' };
+	const char *stats_env = getenv("PIGLIT_GL_CALL_STATS");
+	const char *trace_env = getenv("PIGLIT_GL_CALL_TRACE");
+	const uint32_t n = ARRAY_SIZE(dispatch_set_names);
+	uint32_t i;
+
+	if ((stats_env == NULL || !strcmp(stats_env, "") ||
+	     !strcmp(stats_env, "0")) &&
+	    (trace_env == NULL || !strcmp(trace_env, "")))
+		return;
+
+	call_stats = calloc(n, sizeof(struct call_stats));
+	if (call_stats == NULL)
+		return;
+
+	if (trace_env != NULL && strcmp(trace_env, "") != 0) {
+		call_trace = fopen(trace_env, "wb");
+		if (call_trace == NULL) {
+			fprintf(stderr, "Failed to open GL call trace %s\n",
+				trace_env);
+		} else {
+			setvbuf(call_trace, NULL, _IOFBF, 1 << 20);
+			fwrite(magic, sizeof(magic), 1, call_trace);
+			fwrite(&n, sizeof(n), 1, call_trace);
+			for (i = 0; i < n; i++) {
+				fwrite(dispatch_set_names[i],
+				       strlen(dispatch_set_names[i]) + 1, 1,
+				       call_trace);
+			}
+		}
+	}
+
+	atexit(report_call_stats);
+}
+
+/**
+ * Initialize the dispatch mechanism, and reset the calling thread's
+ * current dispatch table for the current context.
  *
  * \param api is the API under test.  This determines whether
  * deprecated functionality is supported (since deprecated functions
@@ -182,20 +425,17 @@ piglit_dispatch_init(piglit_dispatch_api api,
 
 	/* No need to reset the dispatch pointers the first time */
 	if (is_initialized) {
-		reset_dispatch_pointers();
+		piglit_dispatch_current->functions = stub_functions;
+	} else {
+		/* This has to happen before the first GL call below,
+		 * so that every function gets instrumented.
+		 */
+		init_call_instrumentation();
 	}
 
 	is_initialized = true;
 
-	/* Store the GL version and extension string for use by
-	 * check_version() and check_extension().  Note: the
-	 * following two calls are safe because the only GL function
-	 * they call is glGetString(), and the stub function for
-	 * glGetString does not need to call check_version() or
-	 * check_extension().
-	 */
-	gl_version = piglit_get_gl_version();
-	gl_extensions = (const char *) glGetString(GL_EXTENSIONS);
+	query_context_info(piglit_dispatch_current);
 }
 
 /**
@@ -28,11 +28,11 @@
  *   are declared as simple #defines.
  *
  * - Functions defined by OpenGL, GLES, and extensions.  Each function
- *   is represented by a function pointer, which initially points to a
- *   stub function.  When the stub function is called, it looks up the
- *   appropriate function in the GL or GLES implementation, and
- *   updates the function pointer to point to it.  Then it defers to
- *   that function.
+ *   is represented by a function pointer in the current dispatch
+ *   table, which initially points to a stub function.  When the stub
+ *   function is called, it looks up the appropriate function in the GL
+ *   or GLES implementation, and updates the function pointer to point
+ *   to it.  Then it defers to that function.
  *
  * The dispatch mechanism understands function aliases.  So, for
  * example, since glMapBuffer and glMapBufferARB are synonymous, you
@@ -48,6 +48,26 @@
  * caller to specify which API is in use, how to look up function
  * pointers, what to do in the event of an error, and what to do if an
  * unsupported function is requested.
+ *
+ * Which functions are available depends on the context's version and
+ * extensions, so the function pointers, version and extension string
+ * are kept in a dispatch table per context.  The current dispatch table
+ * is per thread.  All threads start out sharing one default table, which
+ * is enough for tests that use only one kind of context.  Tests that use
+ * contexts of different versions, or that make contexts current on
+ * several threads, create a table for each context with
+ * piglit_dispatch_create_table() and pass it to
+ * piglit_dispatch_make_current() right after making the context current.
+ * The table's functions are looked up when they are first called, and
+ * then kept for as long as the table lives.
+ *
+ * For profiling, the dispatch mechanism can count and time every GL
+ * call that a test makes, and report the functions that took the most
+ * calls and time when the test exits.  Set the environment variable
+ * PIGLIT_GL_CALL_STATS=1 to enable this, or PIGLIT_GL_CALL_TRACE to a
+ * file name to also write a binary trace of the calls (see
+ * piglit-dispatch.c for its format).  When neither is set, calls go
+ * straight to the implementation.
  */
 
 #ifndef __piglit_dispatch_h__
@@ -135,6 +155,18 @@ typedef piglit_dispatch_function_ptr (*piglit_dispatch_resolver_ptr)();
 
 typedef void (*piglit_error_function_ptr)(const char *);
 
+#if defined(_MSC_VER)
+#define PIGLIT_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+/* Every GL call reads the current dispatch table, so avoid the
+ * __tls_get_addr() call of the general dynamic TLS model in the shared
+ * library.
+ */
+#define PIGLIT_THREAD_LOCAL __thread __attribute__((tls_model("initial-exec")))
+#else
+#define PIGLIT_THREAD_LOCAL __thread
+#endif
+
 typedef enum {
 	PIGLIT_DISPATCH_GL,
 	PIGLIT_DISPATCH_GL_FWD,
@@ -153,6 +185,49 @@ piglit_dispatch_resolve_function(const char *name);
 
 #include "generated_dispatch.h"
 
+/**
+ * Function pointers and cached context information for one context.
+ */
+struct piglit_dispatch_table {
+	/** Called by the GL function macros. */
+	struct piglit_dispatch_functions functions;
+
+	/**
+	 * The implementation's functions, which the instrumented
+	 * wrappers call when GL call instrumentation is enabled.
+	 */
+	struct piglit_dispatch_functions real;
+
+	/**
+	 * The GL version extracted from glGetString(GL_VERSION), times
+	 * 10, or 0 if it hasn't been queried yet.  For example, if the GL
+	 * version is 2.1, the value 21 is stored here.
+	 *
+	 * We cache this here because calling glGetString is prohibited
+	 * between glBegin and glEnd, and to avoid the inefficiency of
+	 * redundant glGetString queries.
+	 */
+	int gl_version;
+
+	/**
+	 * The GL extension string returned by
+	 * glGetString(GL_EXTENSIONS), cached for the same reasons.
+	 */
+	const char *gl_extensions;
+};
+
+/** The dispatch table of the calling thread. */
+extern PIGLIT_THREAD_LOCAL struct piglit_dispatch_table *piglit_dispatch_current;
+
+struct piglit_dispatch_table *
+piglit_dispatch_create_table(void);
+
+void
+piglit_dispatch_destroy_table(struct piglit_dispatch_table *table);
+
+void
+piglit_dispatch_make_current(struct piglit_dispatch_table *table);
+
 void piglit_dispatch_default_init();
 
 /* As a temporary measure, redirect glewInit() to
@@ -128,6 +128,9 @@ int piglit_cl_framework_run(int argc, char** argv)
 	cl_platform_id platform_id = NULL;
 	cl_device_id device_id = NULL;
 
+	/* Before the runtime starts any threads, which inherit it. */
+	piglit_set_cpu_affinity_from_env();
+
 	/* Get test configuration */
 	struct piglit_cl_test_config_header *config =
 	    piglit_cl_get_test_config(argc, (const char**)argv, &PIGLIT_CL_DEFAULT_TEST_CONFIG_HEADER);
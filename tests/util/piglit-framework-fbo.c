@@ -31,6 +31,10 @@
 #	define PIGLIT_FRAMEWORK_FBO_DISABLED
 #endif
 
+#if defined(PIGLIT_HAS_EGL) && !defined(PIGLIT_FRAMEWORK_FBO_DISABLED)
+#	define PIGLIT_FRAMEWORK_FBO_USE_EGL
+#endif
+
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
@@ -48,6 +52,11 @@
 #include <waffle/waffle.h>
 #endif
 
+#ifdef PIGLIT_FRAMEWORK_FBO_USE_EGL
+#include "piglit-util-egl.h"
+#include <EGL/eglext.h>
+#endif
+
 bool piglit_use_fbo = false;
 
 #ifdef PIGLIT_FRAMEWORK_FBO_USE_GLX
@@ -63,6 +72,12 @@ static struct waffle_window *piglit_waffle_window;
 static struct waffle_context *piglit_waffle_context;
 #endif
 
+#ifdef PIGLIT_FRAMEWORK_FBO_USE_EGL
+static EGLDisplay piglit_egl_display = EGL_NO_DISPLAY;
+static EGLSurface piglit_egl_surface = EGL_NO_SURFACE;
+static EGLContext piglit_egl_context = EGL_NO_CONTEXT;
+#endif
+
 #ifdef PIGLIT_FRAMEWORK_FBO_USE_GLX
 static void
 piglit_framework_fbo_glx_init()
@@ -225,6 +240,183 @@ piglit_framework_fbo_waffle_destroy(void)
 }
 #endif
 
+#ifdef PIGLIT_FRAMEWORK_FBO_USE_EGL
+/**
+ * \brief Print the EGL error and report test failure.
+ *
+ * The \a func_name is the name of the EGL function that failed.
+ */
+static void
+fatal_egl_error(const char *func_name)
+{
+	fflush(stdout);
+	fprintf(stderr, "%s failed with error: %s\n", func_name,
+		piglit_get_egl_error_name(eglGetError()));
+	piglit_report_result(PIGLIT_FAIL);
+}
+
+static bool
+egl_has_extension(EGLDisplay dpy, const char *name)
+{
+	const char *extensions = eglQueryString(dpy, EGL_EXTENSIONS);
+
+	return extensions != NULL &&
+	       piglit_is_extension_in_string(extensions, name);
+}
+
+/**
+ * Get a display that needs no window system.  Mesa's surfaceless
+ * platform renders straight to the GPU (or to llvmpipe) without a
+ * display server.  Without it, fall back to the default display, whose
+ * platform the EGL_PLATFORM variable picks (e.g. "drm").
+ */
+static EGLDisplay
+piglit_framework_fbo_egl_get_display(void)
+{
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+	const char *client_extensions =
+		eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+	if (client_extensions != NULL &&
+	    piglit_is_extension_in_string(client_extensions,
+					  "EGL_MESA_platform_surfaceless")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)
+			eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+		if (get_platform_display != NULL) {
+			EGLDisplay dpy = get_platform_display(
+				EGL_PLATFORM_SURFACELESS_MESA,
+				EGL_DEFAULT_DISPLAY, NULL);
+			if (dpy != EGL_NO_DISPLAY)
+				return dpy;
+		}
+	}
+#endif
+
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static void
+piglit_framework_fbo_egl_init(void)
+{
+	int i;
+	bool surfaceless;
+	EGLint major, minor;
+	EGLint num_configs;
+	EGLConfig config;
+	EGLint config_attribs[64];
+	EGLint context_attribs[64];
+	EGLint pbuffer_attribs[64];
+
+	piglit_egl_display = piglit_framework_fbo_egl_get_display();
+	if (piglit_egl_display == EGL_NO_DISPLAY)
+		fatal_egl_error("eglGetDisplay");
+
+	if (!eglInitialize(piglit_egl_display, &major, &minor))
+		fatal_egl_error("eglInitialize");
+
+	/* Rendering only ever goes to the FBO, so a context without a
+	 * surface will do.  Failing that, bind a pbuffer, which still
+	 * needs no window system.
+	 */
+	surfaceless = egl_has_extension(piglit_egl_display,
+					"EGL_KHR_surfaceless_context");
+
+	i = 0;
+	config_attribs[i++] = EGL_RED_SIZE;
+	config_attribs[i++] = 1;
+	config_attribs[i++] = EGL_GREEN_SIZE;
+	config_attribs[i++] = 1;
+	config_attribs[i++] = EGL_BLUE_SIZE;
+	config_attribs[i++] = 1;
+	config_attribs[i++] = EGL_RENDERABLE_TYPE;
+#if defined(USE_OPENGL)
+	config_attribs[i++] = EGL_OPENGL_BIT;
+#else
+	config_attribs[i++] = EGL_OPENGL_ES2_BIT;
+#endif
+	/* The default, EGL_WINDOW_BIT, would rule out most configs. */
+	config_attribs[i++] = EGL_SURFACE_TYPE;
+	config_attribs[i++] = surfaceless ? 0 : EGL_PBUFFER_BIT;
+	config_attribs[i++] = EGL_NONE;
+
+	i = 0;
+#if defined(USE_OPENGL_ES2)
+	context_attribs[i++] = EGL_CONTEXT_CLIENT_VERSION;
+	context_attribs[i++] = 2;
+#endif
+	context_attribs[i++] = EGL_NONE;
+
+	i = 0;
+	pbuffer_attribs[i++] = EGL_WIDTH;
+	pbuffer_attribs[i++] = piglit_width;
+	pbuffer_attribs[i++] = EGL_HEIGHT;
+	pbuffer_attribs[i++] = piglit_height;
+	pbuffer_attribs[i++] = EGL_NONE;
+
+#if defined(USE_OPENGL)
+	if (!eglBindAPI(EGL_OPENGL_API))
+		fatal_egl_error("eglBindAPI");
+#else
+	if (!eglBindAPI(EGL_OPENGL_ES_API))
+		fatal_egl_error("eglBindAPI");
+#endif
+
+	if (!eglChooseConfig(piglit_egl_display, config_attribs,
+			     &config, 1, &num_configs))
+		fatal_egl_error("eglChooseConfig");
+	if (num_configs == 0) {
+		fprintf(stderr, "eglChooseConfig found no usable config\n");
+		piglit_report_result(PIGLIT_SKIP);
+	}
+
+	piglit_egl_context = eglCreateContext(piglit_egl_display, config,
+					      EGL_NO_CONTEXT, context_attribs);
+	if (piglit_egl_context == EGL_NO_CONTEXT)
+		fatal_egl_error("eglCreateContext");
+
+	if (!surfaceless) {
+		piglit_egl_surface =
+			eglCreatePbufferSurface(piglit_egl_display, config,
+						pbuffer_attribs);
+		if (piglit_egl_surface == EGL_NO_SURFACE)
+			fatal_egl_error("eglCreatePbufferSurface");
+	}
+
+	if (!eglMakeCurrent(piglit_egl_display, piglit_egl_surface,
+			    piglit_egl_surface, piglit_egl_context))
+		fatal_egl_error("eglMakeCurrent");
+}
+
+static void
+piglit_framework_fbo_egl_destroy(void)
+{
+	eglMakeCurrent(piglit_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+		       EGL_NO_CONTEXT);
+	if (piglit_egl_surface != EGL_NO_SURFACE)
+		eglDestroySurface(piglit_egl_display, piglit_egl_surface);
+	eglDestroyContext(piglit_egl_display, piglit_egl_context);
+	eglTerminate(piglit_egl_display);
+
+	piglit_egl_display = EGL_NO_DISPLAY;
+	piglit_egl_surface = EGL_NO_SURFACE;
+	piglit_egl_context = EGL_NO_CONTEXT;
+}
+#endif
+
+bool
+piglit_framework_fbo_headless(void)
+{
+#ifdef PIGLIT_FRAMEWORK_FBO_USE_EGL
+	const char *platform = getenv("PIGLIT_PLATFORM");
+
+	return platform != NULL && !strcmp(platform, "surfaceless_egl");
+#else
+	return false;
+#endif
+}
+
 static bool
 piglit_framework_fbo_gl_init()
 {
@@ -299,6 +491,18 @@ piglit_framework_fbo_gl_init()
 bool
 piglit_framework_fbo_init(void)
 {
+#ifdef PIGLIT_FRAMEWORK_FBO_USE_EGL
+	if (piglit_framework_fbo_headless()) {
+		piglit_framework_fbo_egl_init();
+		if (!piglit_framework_fbo_gl_init())
+			return false;
+
+		/* Without a window, nothing sized the viewport. */
+		glViewport(0, 0, piglit_width, piglit_height);
+		return true;
+	}
+#endif
+
 #if defined(PIGLIT_FRAMEWORK_FBO_USE_GLX)
 	piglit_framework_fbo_glx_init();
 #elif defined(PIGLIT_FRAMEWORK_FBO_USE_WAFFLE)
@@ -317,6 +521,13 @@ piglit_framework_fbo_destroy(void)
 
 	piglit_winsys_fbo = 0;
 
+#ifdef PIGLIT_FRAMEWORK_FBO_USE_EGL
+	if (piglit_framework_fbo_headless()) {
+		piglit_framework_fbo_egl_destroy();
+		return;
+	}
+#endif
+
 #if defined(PIGLIT_FRAMEWORK_FBO_USE_GLX)
 	piglit_framework_fbo_glx_destroy();
 #elif defined(PIGLIT_FRAMEWORK_FBO_USE_WAFFLE)
@@ -25,5 +25,11 @@
 
 extern bool piglit_use_fbo;
 
+/**
+ * True if PIGLIT_PLATFORM=surfaceless_egl asks for a context made through
+ * EGL without any window system.  Tests then always render to an FBO.
+ */
+bool piglit_framework_fbo_headless(void);
+
 bool piglit_framework_fbo_init(void);
 void piglit_framework_fbo_destroy(void);
@@ -35,6 +35,7 @@
 #include "piglit-util-gl-common.h"
 #include "piglit-framework.h"
 #include "piglit-framework-fbo.h"
+#include "piglit-zygote.h"
 
 #ifdef USE_GLX
 #include "piglit-glx-util.h"
@@ -142,6 +143,14 @@ int main(int argc, char *argv[])
 {
 	int j;
 
+	/* When started as a fork server, only the forked runs return,
+	 * each with its own arguments.
+	 */
+	piglit_zygote_init(&argc, &argv);
+
+	/* Before the driver starts any threads, which inherit it. */
+	piglit_set_cpu_affinity_from_env();
+
 	/* Find/remove "-auto" and "-fbo" from the argument vector.
 	 */
 	for (j = 1; j < argc; j++) {
@@ -151,6 +160,15 @@ int main(int argc, char *argv[])
 		} else if (!strcmp(argv[j], "-fbo")) {
 			piglit_use_fbo = true;
 			delete_arg(argv, argc--, j--);
+		} else if (!strcmp(argv[j], "-subtest")) {
+			if (j + 1 >= argc) {
+				fprintf(stderr,
+					"-subtest requires an argument\n");
+				piglit_report_result(PIGLIT_FAIL);
+			}
+			piglit_selected_subtest = argv[j + 1];
+			delete_arg(argv, argc--, j);
+			delete_arg(argv, argc--, j--);
 		} else if (!strcmp(argv[j], "-rlimit")) {
 			char *ptr;
 			unsigned long lim;
@@ -183,7 +201,15 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	if (piglit_use_fbo) {
+	/* Without a window system there is nothing to fall back to. */
+	if (piglit_framework_fbo_headless()) {
+		if (!piglit_framework_fbo_init()) {
+			fprintf(stderr, "PIGLIT_PLATFORM=surfaceless_egl needs "
+				"GL 2.0 and a complete FBO\n");
+			piglit_report_result(PIGLIT_SKIP);
+		}
+		piglit_use_fbo = true;
+	} else if (piglit_use_fbo) {
 		if (!piglit_framework_fbo_init())
 			piglit_use_fbo = false;
 	}
@@ -191,6 +217,8 @@ int main(int argc, char *argv[])
 	if (!piglit_use_fbo)
 		piglit_framework_glut_init(argc, argv);
 
+	piglit_init_gl_error_capture();
+
 	piglit_init(argc, argv);
 
 	if (piglit_use_fbo) {
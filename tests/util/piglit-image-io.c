@@ -0,0 +1,491 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-image-io.c
+ *
+ * Raw and PNG image writers, and the background thread behind the
+ * asynchronous ones.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <png.h>
+
+#include "piglit-image-io.h"
+#include "piglit-pixel-convert.h"
+
+/** Number of failed probes per process whose framebuffer gets dumped. */
+#define MAX_FAILURE_DUMPS 4
+
+bool
+piglit_write_raw_image(const char *filename, int width, int height,
+		       GLenum format, GLenum type, unsigned row_stride,
+		       const void *pixels)
+{
+	struct piglit_raw_image_header header;
+	char padding[PIGLIT_RAW_IMAGE_DATA_OFFSET - sizeof(header)];
+	size_t size = (size_t) row_stride * height;
+	FILE *f;
+	bool ok;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PIGLIT_RAW_IMAGE_MAGIC, sizeof(header.magic));
+	header.version = PIGLIT_RAW_IMAGE_VERSION;
+	header.data_offset = PIGLIT_RAW_IMAGE_DATA_OFFSET;
+	header.width = width;
+	header.height = height;
+	header.format = format;
+	header.type = type;
+	header.row_stride = row_stride;
+	memset(padding, 0, sizeof(padding));
+
+	f = fopen(filename, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "Failed to open %s for writing: %s\n",
+			filename, strerror(errno));
+		return false;
+	}
+
+	ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+	     fwrite(padding, sizeof(padding), 1, f) == 1 &&
+	     (size == 0 || fwrite(pixels, size, 1, f) == 1);
+	if (fclose(f) != 0)
+		ok = false;
+
+	if (!ok)
+		fprintf(stderr, "Failed to write %s\n", filename);
+	return ok;
+}
+
+bool
+piglit_write_png_image(const char *filename, int width, int height,
+		       GLenum format, GLenum type, unsigned row_stride,
+		       const void *pixels)
+{
+	png_structp png;
+	png_infop info;
+	unsigned char *rgba;
+	FILE *f;
+	int y;
+
+	rgba = malloc((size_t) width * height * 4);
+	if (rgba == NULL) {
+		fprintf(stderr, "Out of memory writing %s\n", filename);
+		return false;
+	}
+
+	/* GL rows go bottom-up, PNG rows top-down. */
+	for (y = 0; y < height; y++) {
+		const char *src = (const char *) pixels +
+			(size_t) (height - 1 - y) * row_stride;
+
+		if (!piglit_pixels_convert(format, type, src,
+					   GL_RGBA, GL_UNSIGNED_BYTE,
+					   rgba + (size_t) y * width * 4,
+					   width)) {
+			fprintf(stderr, "Cannot write %s: unsupported "
+				"format %s, type %s\n", filename,
+				piglit_get_gl_enum_name(format),
+				piglit_get_gl_enum_name(type));
+			free(rgba);
+			return false;
+		}
+	}
+
+	f = fopen(filename, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "Failed to open %s for writing: %s\n",
+			filename, strerror(errno));
+		free(rgba);
+		return false;
+	}
+
+	png = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+				      NULL, NULL, NULL);
+	info = png ? png_create_info_struct(png) : NULL;
+	if (info == NULL || setjmp(png_jmpbuf(png))) {
+		fprintf(stderr, "Failed to write %s\n", filename);
+		png_destroy_write_struct(&png, info ? &info : NULL);
+		fclose(f);
+		free(rgba);
+		return false;
+	}
+
+	png_init_io(png, f);
+	/* Failure images are written while a test is running; trade file
+	 * size for speed.
+	 */
+	png_set_compression_level(png, 1);
+	png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA,
+		     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+		     PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(png, info);
+	for (y = 0; y < height; y++)
+		png_write_row(png, rgba + (size_t) y * width * 4);
+	png_write_end(png, NULL);
+
+	png_destroy_write_struct(&png, &info);
+	fclose(f);
+	free(rgba);
+	return true;
+}
+
+bool
+piglit_write_image(const char *filename, int width, int height,
+		   GLenum format, GLenum type, unsigned row_stride,
+		   const void *pixels)
+{
+	size_t len = strlen(filename);
+
+	if (len >= 4 && strcmp(filename + len - 4, ".png") == 0)
+		return piglit_write_png_image(filename, width, height,
+					      format, type, row_stride,
+					      pixels);
+	else
+		return piglit_write_raw_image(filename, width, height,
+					      format, type, row_stride,
+					      pixels);
+}
+
+#if defined(_WIN32)
+
+void
+piglit_write_image_async(const char *filename, int width, int height,
+			 GLenum format, GLenum type, unsigned row_stride,
+			 const void *pixels)
+{
+	piglit_write_image(filename, width, height, format, type,
+			   row_stride, pixels);
+}
+
+void
+piglit_flush_image_writes(void)
+{
+}
+
+#else
+
+struct image_write {
+	struct image_write *next;
+	char *filename;
+	int width, height;
+	GLenum format, type;
+	unsigned row_stride;
+	void *pixels;
+};
+
+static pthread_mutex_t write_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t write_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t write_done = PTHREAD_COND_INITIALIZER;
+static struct image_write *write_head, *write_tail;
+static bool writer_busy;
+static bool writer_started;
+
+static void *
+image_writer(void *data)
+{
+	struct image_write *w;
+
+	pthread_mutex_lock(&write_mutex);
+	for (;;) {
+		while (write_head == NULL)
+			pthread_cond_wait(&write_queued, &write_mutex);
+
+		w = write_head;
+		write_head = w->next;
+		if (write_head == NULL)
+			write_tail = NULL;
+		writer_busy = true;
+		pthread_mutex_unlock(&write_mutex);
+
+		piglit_write_image(w->filename, w->width, w->height,
+				   w->format, w->type, w->row_stride,
+				   w->pixels);
+		free(w->filename);
+		free(w->pixels);
+		free(w);
+
+		pthread_mutex_lock(&write_mutex);
+		writer_busy = false;
+		if (write_head == NULL)
+			pthread_cond_broadcast(&write_done);
+	}
+
+	return NULL;
+}
+
+/** Called with write_mutex held. */
+static bool
+start_writer(void)
+{
+	pthread_t thread;
+
+	if (writer_started)
+		return true;
+	if (pthread_create(&thread, NULL, image_writer, NULL) != 0)
+		return false;
+	pthread_detach(thread);
+	atexit(piglit_flush_image_writes);
+	writer_started = true;
+	return true;
+}
+
+void
+piglit_write_image_async(const char *filename, int width, int height,
+			 GLenum format, GLenum type, unsigned row_stride,
+			 const void *pixels)
+{
+	size_t size = (size_t) row_stride * height;
+	struct image_write *w = calloc(1, sizeof(*w));
+
+	if (w != NULL) {
+		w->filename = strdup(filename);
+		w->pixels = malloc(size ? size : 1);
+	}
+	if (w == NULL || w->filename == NULL || w->pixels == NULL) {
+		if (w != NULL) {
+			free(w->filename);
+			free(w->pixels);
+			free(w);
+		}
+		piglit_write_image(filename, width, height, format, type,
+				   row_stride, pixels);
+		return;
+	}
+
+	memcpy(w->pixels, pixels, size);
+	w->width = width;
+	w->height = height;
+	w->format = format;
+	w->type = type;
+	w->row_stride = row_stride;
+
+	pthread_mutex_lock(&write_mutex);
+	if (!start_writer()) {
+		pthread_mutex_unlock(&write_mutex);
+		piglit_write_image(filename, width, height, format, type,
+				   row_stride, pixels);
+		free(w->filename);
+		free(w->pixels);
+		free(w);
+		return;
+	}
+	if (write_tail)
+		write_tail->next = w;
+	else
+		write_head = w;
+	write_tail = w;
+	pthread_cond_signal(&write_queued);
+	pthread_mutex_unlock(&write_mutex);
+}
+
+void
+piglit_flush_image_writes(void)
+{
+	pthread_mutex_lock(&write_mutex);
+	while (write_head != NULL || writer_busy)
+		pthread_cond_wait(&write_done, &write_mutex);
+	pthread_mutex_unlock(&write_mutex);
+}
+
+#endif /* _WIN32 */
+
+static bool
+check_raw_header(const char *filename,
+		 const struct piglit_raw_image_header *header,
+		 size_t file_size)
+{
+	if (file_size < sizeof(*header) ||
+	    memcmp(header->magic, PIGLIT_RAW_IMAGE_MAGIC,
+		   sizeof(header->magic)) != 0) {
+		fprintf(stderr, "%s is not a piglit raw image\n", filename);
+		return false;
+	}
+	if (header->version != PIGLIT_RAW_IMAGE_VERSION) {
+		fprintf(stderr, "%s: unsupported raw image version %u\n",
+			filename, header->version);
+		return false;
+	}
+	if (header->data_offset +
+	    (uint64_t) header->row_stride * header->height > file_size) {
+		fprintf(stderr, "%s is truncated\n", filename);
+		return false;
+	}
+	return true;
+}
+
+bool
+piglit_map_raw_image(const char *filename, struct piglit_raw_image *image)
+{
+#if defined(_WIN32)
+	FILE *f = fopen(filename, "rb");
+	long size;
+
+	memset(image, 0, sizeof(*image));
+	if (f == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n",
+			filename, strerror(errno));
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	image->map = malloc(size > 0 ? size : 1);
+	if (image->map == NULL ||
+	    fread(image->map, 1, size, f) != (size_t) size) {
+		fprintf(stderr, "Failed to read %s\n", filename);
+		free(image->map);
+		image->map = NULL;
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+	image->map_size = size;
+#else
+	struct stat st;
+	void *map;
+	int fd;
+
+	memset(image, 0, sizeof(*image));
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n",
+			filename, strerror(errno));
+		return false;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		fprintf(stderr, "%s is not a piglit raw image\n", filename);
+		close(fd);
+		return false;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Failed to map %s: %s\n",
+			filename, strerror(errno));
+		return false;
+	}
+	image->map = map;
+	image->map_size = st.st_size;
+#endif
+
+	if (image->map_size >= sizeof(image->header))
+		memcpy(&image->header, image->map, sizeof(image->header));
+	if (!check_raw_header(filename, &image->header, image->map_size)) {
+		piglit_unmap_raw_image(image);
+		return false;
+	}
+	image->pixels = (const char *) image->map + image->header.data_offset;
+	return true;
+}
+
+void
+piglit_unmap_raw_image(struct piglit_raw_image *image)
+{
+	if (image->map != NULL) {
+#if defined(_WIN32)
+		free(image->map);
+#else
+		munmap(image->map, image->map_size);
+#endif
+	}
+	memset(image, 0, sizeof(*image));
+}
+
+void
+piglit_dump_probe_failure(void)
+{
+	static int dumps;
+	static const GLenum pack_params[] = {
+		GL_PACK_ALIGNMENT,
+		GL_PACK_ROW_LENGTH,
+		GL_PACK_SKIP_ROWS,
+		GL_PACK_SKIP_PIXELS,
+	};
+	GLint saved[ARRAY_SIZE(pack_params)];
+	GLint pack_buffer = 0;
+	const char *dir = getenv("PIGLIT_IMAGE_DUMP_DIR");
+	char filename[4096];
+	float *pixels;
+	unsigned i;
+
+	if (dir == NULL || dir[0] == '\0' || dumps >= MAX_FAILURE_DUMPS)
+		return;
+	dumps++;
+
+	pixels = malloc((size_t) piglit_width * piglit_height * 4 *
+			sizeof(float));
+	if (pixels == NULL)
+		return;
+
+	/* Read back with default packing, whatever the test set up. */
+	for (i = 0; i < ARRAY_SIZE(pack_params); i++) {
+		glGetIntegerv(pack_params[i], &saved[i]);
+		glPixelStorei(pack_params[i], pack_params[i] ==
+			      GL_PACK_ALIGNMENT ? 1 : 0);
+	}
+	if (piglit_get_gl_version() >= 21 ||
+	    piglit_is_extension_supported("GL_ARB_pixel_buffer_object")) {
+		glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &pack_buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	glReadPixels(0, 0, piglit_width, piglit_height, GL_RGBA, GL_FLOAT,
+		     pixels);
+
+	if (pack_buffer)
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pack_buffer);
+	for (i = 0; i < ARRAY_SIZE(pack_params); i++)
+		glPixelStorei(pack_params[i], saved[i]);
+
+	snprintf(filename, sizeof(filename), "%s/probe-%d-%d.raw",
+		 dir, (int) getpid(), dumps);
+	piglit_write_image_async(filename, piglit_width, piglit_height,
+				 GL_RGBA, GL_FLOAT, piglit_width * 16, pixels);
+	printf("  Framebuffer dumped to %s\n", filename);
+
+	snprintf(filename, sizeof(filename), "%s/probe-%d-%d.png",
+		 dir, (int) getpid(), dumps);
+	piglit_write_image_async(filename, piglit_width, piglit_height,
+				 GL_RGBA, GL_FLOAT, piglit_width * 16, pixels);
+	printf("  Framebuffer dumped to %s\n", filename);
+
+	free(pixels);
+}
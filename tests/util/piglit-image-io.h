@@ -0,0 +1,145 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-image-io.h
+ *
+ * Writing images to disk, as raw dumps or as PNG files.
+ *
+ * A raw dump is a fixed size header followed by the pixel rows exactly as
+ * glReadPixels returned them, bottom row first.  The pixel data starts at
+ * a page-friendly offset, so a dump can be mapped and compared in place
+ * without parsing or copying.  PNG files are converted to 8-bit RGBA and
+ * flipped to the usual top-down order, for looking at with an image viewer.
+ *
+ * The asynchronous writers copy the pixels and hand them to a single
+ * background thread, so a test pays only for the copy.  Pending writes are
+ * flushed when the process exits.
+ */
+
+#pragma once
+#ifndef PIGLIT_IMAGE_IO_H
+#define PIGLIT_IMAGE_IO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "piglit-util-gl-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PIGLIT_RAW_IMAGE_MAGIC "PIGLTIMG"
+#define PIGLIT_RAW_IMAGE_VERSION 1
+#define PIGLIT_RAW_IMAGE_DATA_OFFSET 64
+
+/**
+ * Header of a raw image dump.  Fields are in host byte order; a dump from
+ * a machine of the other endianness fails the version check.
+ */
+struct piglit_raw_image_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t data_offset;	/**< Start of the pixel rows in the file. */
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;	/**< GL pixel format, e.g. GL_RGBA. */
+	uint32_t type;		/**< GL pixel type, e.g. GL_FLOAT. */
+	uint32_t row_stride;	/**< Bytes from one row to the next. */
+	uint32_t reserved;
+};
+
+/** A raw dump mapped into memory by piglit_map_raw_image(). */
+struct piglit_raw_image {
+	struct piglit_raw_image_header header;
+	const void *pixels;
+	void *map;
+	size_t map_size;
+};
+
+/**
+ * Write \c height rows of \c width pixels, \c row_stride bytes apart, as
+ * a raw dump.  Returns false and prints a message if the file cannot be
+ * written.
+ */
+bool
+piglit_write_raw_image(const char *filename, int width, int height,
+		       GLenum format, GLenum type, unsigned row_stride,
+		       const void *pixels);
+
+/**
+ * Write pixels as an 8-bit RGBA PNG file.  The format and type may be any
+ * pair supported by piglit_pixels_unpack().
+ */
+bool
+piglit_write_png_image(const char *filename, int width, int height,
+		       GLenum format, GLenum type, unsigned row_stride,
+		       const void *pixels);
+
+/**
+ * Write pixels as PNG if \c filename ends in ".png", as a raw dump
+ * otherwise.
+ */
+bool
+piglit_write_image(const char *filename, int width, int height,
+		   GLenum format, GLenum type, unsigned row_stride,
+		   const void *pixels);
+
+/**
+ * Like piglit_write_image(), but returns as soon as the pixels have been
+ * copied.  Errors are reported by the background thread.
+ */
+void
+piglit_write_image_async(const char *filename, int width, int height,
+			 GLenum format, GLenum type, unsigned row_stride,
+			 const void *pixels);
+
+/** Wait until every asynchronous write has finished. */
+void
+piglit_flush_image_writes(void);
+
+/**
+ * Map a raw dump read-only.  Returns false and prints a message if the
+ * file cannot be opened or is not a raw dump.
+ */
+bool
+piglit_map_raw_image(const char *filename, struct piglit_raw_image *image);
+
+void
+piglit_unmap_raw_image(struct piglit_raw_image *image);
+
+/**
+ * Called by the probe functions when a probe fails.  If the
+ * PIGLIT_IMAGE_DUMP_DIR environment variable is set, read back the window
+ * and queue a raw dump and a PNG of it in that directory.  Only the first
+ * few failures of a process are dumped.
+ */
+void
+piglit_dump_probe_failure(void);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+
+#endif /* PIGLIT_IMAGE_IO_H */
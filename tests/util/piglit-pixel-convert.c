@@ -0,0 +1,787 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-pixel-convert.c
+ *
+ * Client pixel format conversion.  See piglit-pixel-convert.h.
+ *
+ * Formats and packed types are described by tables.  The converters for
+ * the array types are generated by a macro for each component type, with
+ * a specialized loop for formats whose components are already in RGBA
+ * order.  Float RGBA is a plain copy, 8-bit normalized RGBA has SSE2
+ * versions, and unpacking half float RGBA uses F16C when the compiler
+ * targets it.
+ */
+
+#include "piglit-pixel-convert.h"
+#include "rgb9e5.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+/* Destinations of a format's components, in addition to 0-3 for RGBA. */
+#define CHAN_L 4	/**< Luminance: red, green and blue */
+
+struct format_info {
+	GLenum format;
+	unsigned components;
+	unsigned char map[4];
+	bool integer;
+};
+
+/* A packed type's fields, in the order of the format's components. */
+struct packed_info {
+	GLenum type;
+	unsigned bytes;
+	unsigned components;
+	unsigned char shift[4];
+	unsigned char bits[4];
+};
+
+static const struct format_info formats[] = {
+	{ GL_RED,             1, { 0 },          false },
+	{ GL_GREEN,           1, { 1 },          false },
+	{ GL_BLUE,            1, { 2 },          false },
+	{ GL_ALPHA,           1, { 3 },          false },
+	{ GL_LUMINANCE,       1, { CHAN_L },     false },
+	{ GL_LUMINANCE_ALPHA, 2, { CHAN_L, 3 },  false },
+	{ GL_RG,              2, { 0, 1 },       false },
+	{ GL_RGB,             3, { 0, 1, 2 },    false },
+	{ GL_BGR,             3, { 2, 1, 0 },    false },
+	{ GL_RGBA,            4, { 0, 1, 2, 3 }, false },
+	{ GL_BGRA,            4, { 2, 1, 0, 3 }, false },
+	{ GL_ABGR_EXT,        4, { 3, 2, 1, 0 }, false },
+	{ GL_RED_INTEGER,     1, { 0 },          true },
+	{ GL_GREEN_INTEGER,   1, { 1 },          true },
+	{ GL_BLUE_INTEGER,    1, { 2 },          true },
+	{ GL_ALPHA_INTEGER,   1, { 3 },          true },
+	{ GL_RG_INTEGER,      2, { 0, 1 },       true },
+	{ GL_RGB_INTEGER,     3, { 0, 1, 2 },    true },
+	{ GL_BGR_INTEGER,     3, { 2, 1, 0 },    true },
+	{ GL_RGBA_INTEGER,    4, { 0, 1, 2, 3 }, true },
+	{ GL_BGRA_INTEGER,    4, { 2, 1, 0, 3 }, true },
+};
+
+static const struct packed_info packed_types[] = {
+	{ GL_UNSIGNED_BYTE_3_3_2,         1, 3, { 5, 2, 0 },   { 3, 3, 2 } },
+	{ GL_UNSIGNED_BYTE_2_3_3_REV,     1, 3, { 0, 3, 6 },   { 3, 3, 2 } },
+	{ GL_UNSIGNED_SHORT_5_6_5,        2, 3, { 11, 5, 0 },  { 5, 6, 5 } },
+	{ GL_UNSIGNED_SHORT_5_6_5_REV,    2, 3, { 0, 5, 11 },  { 5, 6, 5 } },
+	{ GL_UNSIGNED_SHORT_4_4_4_4,      2, 4, { 12, 8, 4, 0 },
+					        { 4, 4, 4, 4 } },
+	{ GL_UNSIGNED_SHORT_4_4_4_4_REV,  2, 4, { 0, 4, 8, 12 },
+					        { 4, 4, 4, 4 } },
+	{ GL_UNSIGNED_SHORT_5_5_5_1,      2, 4, { 11, 6, 1, 0 },
+					        { 5, 5, 5, 1 } },
+	{ GL_UNSIGNED_SHORT_1_5_5_5_REV,  2, 4, { 0, 5, 10, 15 },
+					        { 5, 5, 5, 1 } },
+	{ GL_UNSIGNED_INT_8_8_8_8,        4, 4, { 24, 16, 8, 0 },
+					        { 8, 8, 8, 8 } },
+	{ GL_UNSIGNED_INT_8_8_8_8_REV,    4, 4, { 0, 8, 16, 24 },
+					        { 8, 8, 8, 8 } },
+	{ GL_UNSIGNED_INT_10_10_10_2,     4, 4, { 22, 12, 2, 0 },
+					        { 10, 10, 10, 2 } },
+	{ GL_UNSIGNED_INT_2_10_10_10_REV, 4, 4, { 0, 10, 20, 30 },
+					        { 10, 10, 10, 2 } },
+};
+
+static const struct format_info *
+find_format(GLenum format)
+{
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(formats); i++) {
+		if (formats[i].format == format)
+			return &formats[i];
+	}
+	return NULL;
+}
+
+static const struct packed_info *
+find_packed_type(GLenum type)
+{
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(packed_types); i++) {
+		if (packed_types[i].type == type)
+			return &packed_types[i];
+	}
+	return NULL;
+}
+
+static inline bool
+is_rgba_order(const struct format_info *f)
+{
+	return f->components == 4 && f->map[0] == 0 && f->map[1] == 1 &&
+		f->map[2] == 2 && f->map[3] == 3;
+}
+
+/** Scatter a pixel's components into RGBA. */
+static inline void
+expand(const struct format_info *f, const float *v, float *rgba)
+{
+	unsigned c;
+
+	rgba[0] = rgba[1] = rgba[2] = 0.0f;
+	rgba[3] = 1.0f;
+	for (c = 0; c < f->components; c++) {
+		if (f->map[c] == CHAN_L)
+			rgba[0] = rgba[1] = rgba[2] = v[c];
+		else
+			rgba[f->map[c]] = v[c];
+	}
+}
+
+/** Gather a pixel's components from RGBA. */
+static inline void
+gather(const struct format_info *f, const float *rgba, float *v)
+{
+	unsigned c;
+
+	for (c = 0; c < f->components; c++)
+		v[c] = rgba[f->map[c] == CHAN_L ? 0 : f->map[c]];
+}
+
+/* Rounding conversion of a float that is already in range. */
+static inline int
+round_to_int(float f)
+{
+	return (int) (f >= 0.0f ? f + 0.5f : f - 0.5f);
+}
+
+static inline double
+round_to_double(double d)
+{
+	return d >= 0.0 ? floor(d + 0.5) : ceil(d - 0.5);
+}
+
+/*
+ * Per component conversions.  The *_RAW_* ones are used for the
+ * *_INTEGER formats.
+ */
+#define UBYTE_TO_FLOAT(c)	((c) * (1.0f / 255.0f))
+#define BYTE_TO_FLOAT(c)	MAX2((c) * (1.0f / 127.0f), -1.0f)
+#define USHORT_TO_FLOAT(c)	((c) * (1.0f / 65535.0f))
+#define SHORT_TO_FLOAT(c)	MAX2((c) * (1.0f / 32767.0f), -1.0f)
+#define UINT_TO_FLOAT(c)	((float) ((c) * (1.0 / 4294967295.0)))
+#define INT_TO_FLOAT(c)		((float) MAX2((c) * (1.0 / 2147483647.0), -1.0))
+#define FLOAT_TO_FLOAT(c)	(c)
+#define HALF_TO_FLOAT(c)	float_from_half(c)
+#define INT_TO_RAW_FLOAT(c)	((float) (c))
+
+#define FLOAT_TO_UBYTE(f)	((GLubyte) (CLAMP((f), 0.0f, 1.0f) * 255.0f + 0.5f))
+#define FLOAT_TO_BYTE(f)	((GLbyte) round_to_int(CLAMP((f), -1.0f, 1.0f) * 127.0f))
+#define FLOAT_TO_USHORT(f)	((GLushort) (CLAMP((f), 0.0f, 1.0f) * 65535.0f + 0.5f))
+#define FLOAT_TO_SHORT(f)	((GLshort) round_to_int(CLAMP((f), -1.0f, 1.0f) * 32767.0f))
+#define FLOAT_TO_UINT(f)	((GLuint) (CLAMP((double) (f), 0.0, 1.0) * 4294967295.0 + 0.5))
+#define FLOAT_TO_INT(f)		((GLint) round_to_double(CLAMP((double) (f), -1.0, 1.0) * 2147483647.0))
+#define FLOAT_TO_HALF(f)	piglit_half_from_float(f)
+
+#define FLOAT_TO_RAW_UBYTE(f)	((GLubyte) round_to_double(CLAMP((double) (f), 0.0, 255.0)))
+#define FLOAT_TO_RAW_BYTE(f)	((GLbyte) round_to_double(CLAMP((double) (f), -128.0, 127.0)))
+#define FLOAT_TO_RAW_USHORT(f)	((GLushort) round_to_double(CLAMP((double) (f), 0.0, 65535.0)))
+#define FLOAT_TO_RAW_SHORT(f)	((GLshort) round_to_double(CLAMP((double) (f), -32768.0, 32767.0)))
+#define FLOAT_TO_RAW_UINT(f)	((GLuint) round_to_double(CLAMP((double) (f), 0.0, 4294967295.0)))
+#define FLOAT_TO_RAW_INT(f)	((GLint) round_to_double(CLAMP((double) (f), -2147483648.0, 2147483647.0)))
+
+/**
+ * Convert a half float to a float.  Unlike the other direction, this is
+ * exact.
+ */
+static inline float
+float_from_half(GLushort h)
+{
+	const unsigned s = (h >> 15) & 0x1;
+	const unsigned e = (h >> 10) & 0x1f;
+	const unsigned m = h & 0x3ff;
+	float f;
+
+	if (e == 0)
+		f = ldexpf((float) m, -24);
+	else if (e == 31)
+		f = m == 0 ? INFINITY : NAN;
+	else
+		f = ldexpf((float) (m | 0x400), (int) e - 25);
+
+	return s ? -f : f;
+}
+
+/*
+ * Generate unpack_<name> and pack_<name> for an array type.  The compiler
+ * sees the component count and order as constants in the RGBA loops, so
+ * those end up unrolled; other formats go through expand/gather.
+ */
+#define ARRAY_CONVERTERS(name, ctype, TO_FLOAT, FROM_FLOAT)		\
+static void								\
+unpack_##name(const struct format_info *f, const void *src,		\
+	      unsigned n, float *rgba)					\
+{									\
+	const ctype *in = src;						\
+	unsigned i, c;							\
+									\
+	if (is_rgba_order(f)) {						\
+		for (i = 0; i < 4 * n; i++)				\
+			rgba[i] = TO_FLOAT(in[i]);			\
+		return;							\
+	}								\
+									\
+	for (i = 0; i < n; i++) {					\
+		float v[4];						\
+									\
+		for (c = 0; c < f->components; c++)			\
+			v[c] = TO_FLOAT(in[c]);				\
+		expand(f, v, rgba);					\
+		in += f->components;					\
+		rgba += 4;						\
+	}								\
+}									\
+									\
+static void								\
+pack_##name(const struct format_info *f, const float *rgba,		\
+	    unsigned n, void *dst)					\
+{									\
+	ctype *out = dst;						\
+	unsigned i, c;							\
+									\
+	if (is_rgba_order(f)) {						\
+		for (i = 0; i < 4 * n; i++)				\
+			out[i] = FROM_FLOAT(rgba[i]);			\
+		return;							\
+	}								\
+									\
+	for (i = 0; i < n; i++) {					\
+		float v[4];						\
+									\
+		gather(f, rgba, v);					\
+		for (c = 0; c < f->components; c++)			\
+			out[c] = FROM_FLOAT(v[c]);			\
+		out += f->components;					\
+		rgba += 4;						\
+	}								\
+}
+
+ARRAY_CONVERTERS(ubyte,  GLubyte,  UBYTE_TO_FLOAT,  FLOAT_TO_UBYTE)
+ARRAY_CONVERTERS(byte,   GLbyte,   BYTE_TO_FLOAT,   FLOAT_TO_BYTE)
+ARRAY_CONVERTERS(ushort, GLushort, USHORT_TO_FLOAT, FLOAT_TO_USHORT)
+ARRAY_CONVERTERS(short,  GLshort,  SHORT_TO_FLOAT,  FLOAT_TO_SHORT)
+ARRAY_CONVERTERS(uint,   GLuint,   UINT_TO_FLOAT,   FLOAT_TO_UINT)
+ARRAY_CONVERTERS(int,    GLint,    INT_TO_FLOAT,    FLOAT_TO_INT)
+ARRAY_CONVERTERS(half,   GLushort, HALF_TO_FLOAT,   FLOAT_TO_HALF)
+ARRAY_CONVERTERS(float,  GLfloat,  FLOAT_TO_FLOAT,  FLOAT_TO_FLOAT)
+
+ARRAY_CONVERTERS(ubyte_int,  GLubyte,  INT_TO_RAW_FLOAT, FLOAT_TO_RAW_UBYTE)
+ARRAY_CONVERTERS(byte_int,   GLbyte,   INT_TO_RAW_FLOAT, FLOAT_TO_RAW_BYTE)
+ARRAY_CONVERTERS(ushort_int, GLushort, INT_TO_RAW_FLOAT, FLOAT_TO_RAW_USHORT)
+ARRAY_CONVERTERS(short_int,  GLshort,  INT_TO_RAW_FLOAT, FLOAT_TO_RAW_SHORT)
+ARRAY_CONVERTERS(uint_int,   GLuint,   INT_TO_RAW_FLOAT, FLOAT_TO_RAW_UINT)
+ARRAY_CONVERTERS(int_int,    GLint,    INT_TO_RAW_FLOAT, FLOAT_TO_RAW_INT)
+
+typedef void (*unpack_func)(const struct format_info *f, const void *src,
+			    unsigned n, float *rgba);
+typedef void (*pack_func)(const struct format_info *f, const float *rgba,
+			  unsigned n, void *dst);
+
+static const struct {
+	GLenum type;
+	unsigned size;
+	unpack_func unpack, unpack_int;
+	pack_func pack, pack_int;
+} array_types[] = {
+	{ GL_UNSIGNED_BYTE,  1, unpack_ubyte,  unpack_ubyte_int,
+				pack_ubyte,    pack_ubyte_int },
+	{ GL_BYTE,           1, unpack_byte,   unpack_byte_int,
+				pack_byte,     pack_byte_int },
+	{ GL_UNSIGNED_SHORT, 2, unpack_ushort, unpack_ushort_int,
+				pack_ushort,   pack_ushort_int },
+	{ GL_SHORT,          2, unpack_short,  unpack_short_int,
+				pack_short,    pack_short_int },
+	{ GL_UNSIGNED_INT,   4, unpack_uint,   unpack_uint_int,
+				pack_uint,     pack_uint_int },
+	{ GL_INT,            4, unpack_int,    unpack_int_int,
+				pack_int,      pack_int_int },
+	{ GL_HALF_FLOAT,     2, unpack_half,   NULL,
+				pack_half,     NULL },
+	{ GL_FLOAT,          4, unpack_float,  NULL,
+				pack_float,    NULL },
+};
+
+static int
+find_array_type(GLenum type)
+{
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(array_types); i++) {
+		if (array_types[i].type == type)
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Unsigned 10 and 11 bit floats, as used by
+ * GL_UNSIGNED_INT_10F_11F_11F_REV: a 5 bit exponent with a bias of 15
+ * and \c mbits bits of mantissa.
+ */
+static float
+float_from_ufloat(unsigned bits, unsigned mbits)
+{
+	const unsigned e = bits >> mbits;
+	const unsigned m = bits & ((1u << mbits) - 1);
+
+	if (e == 0)
+		return ldexpf((float) m, -14 - (int) mbits);
+	else if (e == 31)
+		return m == 0 ? INFINITY : NAN;
+	else
+		return ldexpf((float) (m | (1u << mbits)),
+			      (int) e - 15 - (int) mbits);
+}
+
+static unsigned
+ufloat_from_float(float f, unsigned mbits)
+{
+	const unsigned max_finite = (30u << mbits) | ((1u << mbits) - 1);
+	unsigned bits;
+	int exp, e;
+
+	if (isnan(f))
+		return (31u << mbits) | 1;
+	if (f <= 0.0f)
+		return 0;
+	if (isinf(f))
+		return 31u << mbits;
+
+	/* Denormals use the scale of the smallest normal exponent. */
+	frexpf(f, &exp);
+	e = MAX2(exp - 1 + 15, 1);
+
+	/* The mantissa, including the implicit one of normal numbers, is
+	 * right below the exponent, so adding it to (e - 1) << mbits gives
+	 * the encoding.  A mantissa that rounds up carries into the
+	 * exponent.
+	 */
+	bits = (unsigned) round_to_double(ldexp(f, (int) mbits - (e - 15)));
+	bits += (unsigned) (e - 1) << mbits;
+	return MIN2(bits, max_finite);
+}
+
+static inline unsigned
+read_word(const GLubyte *p, unsigned bytes)
+{
+	switch (bytes) {
+	case 1:
+		return *p;
+	case 2:
+		return *(const GLushort *) p;
+	default:
+		return *(const GLuint *) p;
+	}
+}
+
+static inline void
+write_word(GLubyte *p, unsigned bytes, unsigned value)
+{
+	switch (bytes) {
+	case 1:
+		*p = value;
+		break;
+	case 2:
+		*(GLushort *) p = value;
+		break;
+	default:
+		*(GLuint *) p = value;
+		break;
+	}
+}
+
+static void
+unpack_packed(const struct format_info *f, const struct packed_info *p,
+	      const void *src, unsigned n, float *rgba)
+{
+	const GLubyte *in = src;
+	unsigned i, c;
+
+	for (i = 0; i < n; i++) {
+		const unsigned word = read_word(in, p->bytes);
+		float v[4];
+
+		for (c = 0; c < p->components; c++) {
+			const unsigned max = (1u << p->bits[c]) - 1;
+			const unsigned field = (word >> p->shift[c]) & max;
+
+			v[c] = f->integer ? (float) field
+				: field * (1.0f / max);
+		}
+		expand(f, v, rgba);
+		in += p->bytes;
+		rgba += 4;
+	}
+}
+
+static void
+pack_packed(const struct format_info *f, const struct packed_info *p,
+	    const float *rgba, unsigned n, void *dst)
+{
+	GLubyte *out = dst;
+	unsigned i, c;
+
+	for (i = 0; i < n; i++) {
+		unsigned word = 0;
+		float v[4];
+
+		gather(f, rgba, v);
+		for (c = 0; c < p->components; c++) {
+			const unsigned max = (1u << p->bits[c]) - 1;
+			unsigned field;
+
+			if (f->integer)
+				field = (unsigned) round_to_double(
+					CLAMP((double) v[c], 0.0, max));
+			else
+				field = (unsigned) (CLAMP(v[c], 0.0f, 1.0f) *
+						    max + 0.5f);
+			word |= field << p->shift[c];
+		}
+		write_word(out, p->bytes, word);
+		out += p->bytes;
+		rgba += 4;
+	}
+}
+
+static void
+unpack_r11g11b10f(const struct format_info *f, const void *src,
+		  unsigned n, float *rgba)
+{
+	const GLuint *in = src;
+	unsigned i;
+
+	for (i = 0; i < n; i++) {
+		float v[3];
+
+		v[0] = float_from_ufloat(in[i] & 0x7ff, 6);
+		v[1] = float_from_ufloat((in[i] >> 11) & 0x7ff, 6);
+		v[2] = float_from_ufloat(in[i] >> 22, 5);
+		expand(f, v, rgba + 4 * i);
+	}
+}
+
+static void
+pack_r11g11b10f(const struct format_info *f, const float *rgba,
+		unsigned n, void *dst)
+{
+	GLuint *out = dst;
+	unsigned i;
+
+	for (i = 0; i < n; i++) {
+		float v[3];
+
+		gather(f, rgba + 4 * i, v);
+		out[i] = ufloat_from_float(v[0], 6) |
+			(ufloat_from_float(v[1], 6) << 11) |
+			(ufloat_from_float(v[2], 5) << 22);
+	}
+}
+
+static void
+unpack_rgb9e5(const struct format_info *f, const void *src,
+	      unsigned n, float *rgba)
+{
+	const GLuint *in = src;
+	unsigned i;
+
+	for (i = 0; i < n; i++) {
+		float v[3];
+
+		rgb9e5_to_float3(in[i], v);
+		expand(f, v, rgba + 4 * i);
+	}
+}
+
+static void
+pack_rgb9e5(const struct format_info *f, const float *rgba,
+	    unsigned n, void *dst)
+{
+	GLuint *out = dst;
+	unsigned i;
+
+	for (i = 0; i < n; i++) {
+		float v[3];
+
+		gather(f, rgba + 4 * i, v);
+		out[i] = float3_to_rgb9e5(v);
+	}
+}
+
+#ifdef __SSE2__
+/** 8-bit normalized RGBA to float, four pixels at a time. */
+static unsigned
+unpack_ubyte_rgba_sse2(const GLubyte *in, unsigned n, float *rgba)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+	const __m128i zero = _mm_setzero_si128();
+	unsigned i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		const __m128i px = _mm_loadu_si128((const __m128i *) (in + 4 * i));
+		const __m128i lo = _mm_unpacklo_epi8(px, zero);
+		const __m128i hi = _mm_unpackhi_epi8(px, zero);
+		float *out = rgba + 4 * i;
+
+		_mm_storeu_ps(out + 0, _mm_mul_ps(_mm_cvtepi32_ps(
+			_mm_unpacklo_epi16(lo, zero)), scale));
+		_mm_storeu_ps(out + 4, _mm_mul_ps(_mm_cvtepi32_ps(
+			_mm_unpackhi_epi16(lo, zero)), scale));
+		_mm_storeu_ps(out + 8, _mm_mul_ps(_mm_cvtepi32_ps(
+			_mm_unpacklo_epi16(hi, zero)), scale));
+		_mm_storeu_ps(out + 12, _mm_mul_ps(_mm_cvtepi32_ps(
+			_mm_unpackhi_epi16(hi, zero)), scale));
+	}
+
+	return i;
+}
+
+/** Float RGBA to 8-bit normalized, four pixels at a time. */
+static unsigned
+pack_ubyte_rgba_sse2(const float *rgba, unsigned n, GLubyte *out)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(255.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	__m128i c[4];
+	unsigned i, j;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		for (j = 0; j < 4; j++) {
+			__m128 v = _mm_loadu_ps(rgba + 4 * (i + j));
+
+			v = _mm_min_ps(_mm_max_ps(v, zero), one);
+			v = _mm_add_ps(_mm_mul_ps(v, scale), half);
+			c[j] = _mm_cvttps_epi32(v);
+		}
+		_mm_storeu_si128((__m128i *) (out + 4 * i),
+				 _mm_packus_epi16(_mm_packs_epi32(c[0], c[1]),
+						  _mm_packs_epi32(c[2], c[3])));
+	}
+
+	return i;
+}
+#endif
+
+#ifdef __F16C__
+/** Half float RGBA to float, two pixels at a time. */
+static unsigned
+unpack_half_rgba_f16c(const GLushort *in, unsigned n, float *rgba)
+{
+	unsigned i;
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		const __m128i h = _mm_loadu_si128((const __m128i *) (in + 4 * i));
+
+		_mm256_storeu_ps(rgba + 4 * i, _mm256_cvtph_ps(h));
+	}
+
+	return i;
+}
+#endif
+
+/**
+ * Handle the common cases that have a faster path than the generic
+ * converters.  Returns the number of pixels converted.
+ */
+static unsigned
+unpack_fast(const struct format_info *f, GLenum type, const void *src,
+	    unsigned n, float *rgba)
+{
+	if (!is_rgba_order(f) || f->integer)
+		return 0;
+
+	switch (type) {
+	case GL_FLOAT:
+		memcpy(rgba, src, 4 * n * sizeof(float));
+		return n;
+#ifdef __SSE2__
+	case GL_UNSIGNED_BYTE:
+		return unpack_ubyte_rgba_sse2(src, n, rgba);
+#endif
+#ifdef __F16C__
+	case GL_HALF_FLOAT:
+		return unpack_half_rgba_f16c(src, n, rgba);
+#endif
+	default:
+		return 0;
+	}
+}
+
+static unsigned
+pack_fast(const struct format_info *f, GLenum type, const float *rgba,
+	  unsigned n, void *dst)
+{
+	if (!is_rgba_order(f) || f->integer)
+		return 0;
+
+	switch (type) {
+	case GL_FLOAT:
+		memcpy(dst, rgba, 4 * n * sizeof(float));
+		return n;
+#ifdef __SSE2__
+	case GL_UNSIGNED_BYTE:
+		return pack_ubyte_rgba_sse2(rgba, n, dst);
+#endif
+	default:
+		return 0;
+	}
+}
+
+unsigned
+piglit_pixels_size(GLenum format, GLenum type)
+{
+	const struct format_info *f = find_format(format);
+	const struct packed_info *p;
+	int t;
+
+	if (f == NULL)
+		return 0;
+
+	t = find_array_type(type);
+	if (t >= 0) {
+		if (f->integer && array_types[t].unpack_int == NULL)
+			return 0;
+		return f->components * array_types[t].size;
+	}
+
+	p = find_packed_type(type);
+	if (p != NULL)
+		return p->components == f->components ? p->bytes : 0;
+
+	if (type == GL_UNSIGNED_INT_10F_11F_11F_REV ||
+	    type == GL_UNSIGNED_INT_5_9_9_9_REV)
+		return format == GL_RGB ? 4 : 0;
+
+	return 0;
+}
+
+bool
+piglit_pixels_unpack(GLenum format, GLenum type, const void *src,
+		     unsigned n, float *rgba)
+{
+	const struct format_info *f = find_format(format);
+	const unsigned size = piglit_pixels_size(format, type);
+	unsigned done;
+	int t;
+
+	if (size == 0)
+		return false;
+
+	done = unpack_fast(f, type, src, n, rgba);
+	src = (const GLubyte *) src + done * size;
+	rgba += 4 * done;
+	n -= done;
+
+	t = find_array_type(type);
+	if (t >= 0) {
+		if (f->integer)
+			array_types[t].unpack_int(f, src, n, rgba);
+		else
+			array_types[t].unpack(f, src, n, rgba);
+	} else if (type == GL_UNSIGNED_INT_10F_11F_11F_REV) {
+		unpack_r11g11b10f(f, src, n, rgba);
+	} else if (type == GL_UNSIGNED_INT_5_9_9_9_REV) {
+		unpack_rgb9e5(f, src, n, rgba);
+	} else {
+		unpack_packed(f, find_packed_type(type), src, n, rgba);
+	}
+
+	return true;
+}
+
+bool
+piglit_pixels_pack(GLenum format, GLenum type, const float *rgba,
+		   unsigned n, void *dst)
+{
+	const struct format_info *f = find_format(format);
+	const unsigned size = piglit_pixels_size(format, type);
+	unsigned done;
+	int t;
+
+	if (size == 0)
+		return false;
+
+	done = pack_fast(f, type, rgba, n, dst);
+	dst = (GLubyte *) dst + done * size;
+	rgba += 4 * done;
+	n -= done;
+
+	t = find_array_type(type);
+	if (t >= 0) {
+		if (f->integer)
+			array_types[t].pack_int(f, rgba, n, dst);
+		else
+			array_types[t].pack(f, rgba, n, dst);
+	} else if (type == GL_UNSIGNED_INT_10F_11F_11F_REV) {
+		pack_r11g11b10f(f, rgba, n, dst);
+	} else if (type == GL_UNSIGNED_INT_5_9_9_9_REV) {
+		pack_rgb9e5(f, rgba, n, dst);
+	} else {
+		pack_packed(f, find_packed_type(type), rgba, n, dst);
+	}
+
+	return true;
+}
+
+bool
+piglit_pixels_convert(GLenum src_format, GLenum src_type, const void *src,
+		      GLenum dst_format, GLenum dst_type, void *dst,
+		      unsigned n)
+{
+	/* Small enough to stay in the cache between the two passes. */
+	float tmp[4 * 256];
+	const unsigned src_size = piglit_pixels_size(src_format, src_type);
+	const unsigned dst_size = piglit_pixels_size(dst_format, dst_type);
+	unsigned i;
+
+	if (src_size == 0 || dst_size == 0)
+		return false;
+
+	if (src_format == dst_format && src_type == dst_type) {
+		memcpy(dst, src, n * src_size);
+		return true;
+	}
+
+	for (i = 0; i < n; i += 256) {
+		const unsigned count = MIN2(n - i, 256);
+
+		piglit_pixels_unpack(src_format, src_type,
+				     (const GLubyte *) src + i * src_size,
+				     count, tmp);
+		piglit_pixels_pack(dst_format, dst_type, tmp, count,
+				   (GLubyte *) dst + i * dst_size);
+	}
+
+	return true;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-pixel-convert.h
+ *
+ * Conversion of client pixel data (a glTexImage/glReadPixels format and
+ * type pair) to and from RGBA floats.
+ *
+ * Normalized types follow the GL conversion rules: unsigned values map to
+ * [0, 1], signed values to [-1, 1] with the most negative value clamped,
+ * and packing rounds to nearest after clamping.  The *_INTEGER formats
+ * convert the raw integer values instead.  Unpacking fills in missing
+ * components from (0, 0, 0, 1), and luminance is replicated to red, green
+ * and blue; packing takes luminance from red.
+ *
+ * Both the plain array types (including GL_HALF_FLOAT) and the packed
+ * types, including GL_UNSIGNED_INT_10F_11F_11F_REV and
+ * GL_UNSIGNED_INT_5_9_9_9_REV, are supported.  Pixels are tightly packed;
+ * row padding and glPixelStore state are up to the caller.
+ */
+
+#pragma once
+#ifndef PIGLIT_PIXEL_CONVERT_H
+#define PIGLIT_PIXEL_CONVERT_H
+
+#include "piglit-util-gl-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Size of one pixel of \c format and \c type in bytes, or 0 if the pair
+ * is not supported.
+ */
+unsigned
+piglit_pixels_size(GLenum format, GLenum type);
+
+/**
+ * Convert \c n pixels at \c src to RGBA floats.  Returns false if the
+ * format and type pair is not supported.
+ */
+bool
+piglit_pixels_unpack(GLenum format, GLenum type, const void *src,
+		     unsigned n, float *rgba);
+
+/**
+ * Convert \c n RGBA float pixels to \c format and \c type at \c dst.
+ * Returns false if the format and type pair is not supported.
+ */
+bool
+piglit_pixels_pack(GLenum format, GLenum type, const float *rgba,
+		   unsigned n, void *dst);
+
+/**
+ * Convert \c n pixels from one format and type pair to another, as if
+ * by piglit_pixels_unpack followed by piglit_pixels_pack.
+ */
+bool
+piglit_pixels_convert(GLenum src_format, GLenum src_type, const void *src,
+		      GLenum dst_format, GLenum dst_type, void *dst,
+		      unsigned n);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+
+#endif /* PIGLIT_PIXEL_CONVERT_H */
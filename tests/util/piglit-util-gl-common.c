@@ -151,13 +151,268 @@ const char* piglit_get_gl_error_name(GLenum error)
 #undef CASE
 }
 
+#if defined(USE_OPENGL)
+
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#endif
+
+#if defined(_MSC_VER)
+#define ring_fetch_inc(p) (InterlockedIncrement((volatile LONG *) (p)) - 1)
+#define ring_write_barrier() MemoryBarrier()
+#else
+#define ring_fetch_inc(p) __sync_fetch_and_add((p), 1)
+#define ring_write_barrier() __sync_synchronize()
+#endif
+
+/** Messages kept between two checks.  Older ones are dropped. */
+#define ERROR_RING_SIZE 16
+
+/**
+ * An error message from the debug callback.  \c seq is set last, to one
+ * more than the message's index, once the message is complete.
+ */
+struct captured_error {
+	volatile unsigned seq;
+	char message[256];
+};
+
+static struct captured_error error_ring[ERROR_RING_SIZE];
+/** Number of messages recorded by the callback. */
+static volatile unsigned error_ring_head;
+/** Number of messages consumed by the checks. */
+static unsigned error_ring_tail;
+
+static bool error_capture_active;
+static bool saved_debug_output;
+static bool saved_debug_output_synchronous;
+
+/** The table holding the wrappers below, and the entries they replaced. */
+static struct piglit_dispatch_table *capture_table;
+static PFNGLDEBUGMESSAGECALLBACKARBPROC saved_DebugMessageCallbackARB;
+static PFNGLDEBUGMESSAGECONTROLARBPROC saved_DebugMessageControlARB;
+static PFNGLDEBUGMESSAGEINSERTARBPROC saved_DebugMessageInsertARB;
+static PFNGLGETDEBUGMESSAGELOGARBPROC saved_GetDebugMessageLogARB;
+
+static void APIENTRY
+capture_debug_message(GLenum source, GLenum type, GLuint id,
+		      GLenum severity, GLsizei length,
+		      const GLchar *message, GLvoid *userParam)
+{
+	struct captured_error *entry;
+	unsigned index;
+
+	if (type != GL_DEBUG_TYPE_ERROR_ARB)
+		return;
+
+	index = ring_fetch_inc(&error_ring_head);
+	entry = &error_ring[index % ERROR_RING_SIZE];
+	entry->seq = 0;
+	if (length < 0 || length >= (GLsizei) sizeof(entry->message))
+		length = sizeof(entry->message) - 1;
+	strncpy(entry->message, message, length);
+	entry->message[length] = '\0';
+	ring_write_barrier();
+	entry->seq = index + 1;
+}
+
+static bool
+have_captured_errors(void)
+{
+	return error_ring_head != error_ring_tail;
+}
+
+/**
+ * Mark the captured messages as consumed, printing them first if \c print
+ * is set.
+ */
+static void
+consume_captured_errors(bool print)
+{
+	unsigned head = error_ring_head;
+	unsigned count = head - error_ring_tail;
+	unsigned i;
+
+	if (print) {
+		if (count > ERROR_RING_SIZE) {
+			printf("(%u GL debug messages dropped)\n",
+			       count - ERROR_RING_SIZE);
+			error_ring_tail = head - ERROR_RING_SIZE;
+		}
+		for (i = error_ring_tail; i != head; i++) {
+			const struct captured_error *entry =
+				&error_ring[i % ERROR_RING_SIZE];
+
+			if (entry->seq == i + 1)
+				printf("GL debug message: %s\n",
+				       entry->message);
+		}
+	}
+
+	error_ring_tail = head;
+}
+
+/**
+ * Put back the test's debug output entry points and state, leaving
+ * errors to be polled with glGetError.
+ */
+static void
+stop_gl_error_capture(void)
+{
+	if (!error_capture_active)
+		return;
+	error_capture_active = false;
+
+	capture_table->functions.DebugMessageCallbackARB =
+		saved_DebugMessageCallbackARB;
+	capture_table->functions.DebugMessageControlARB =
+		saved_DebugMessageControlARB;
+	capture_table->functions.DebugMessageInsertARB =
+		saved_DebugMessageInsertARB;
+	capture_table->functions.GetDebugMessageLogARB =
+		saved_GetDebugMessageLogARB;
+
+	glDebugMessageCallbackARB(NULL, NULL);
+	glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE,
+				 0, NULL, GL_TRUE);
+	glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE,
+				 GL_DEBUG_SEVERITY_LOW_ARB, 0, NULL, GL_FALSE);
+	if (!saved_debug_output_synchronous)
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+	if (!saved_debug_output)
+		glDisable(GL_DEBUG_OUTPUT);
+
+	/* The errors stay in the GL error flag. */
+	consume_captured_errors(false);
+}
+
+static void APIENTRY
+wrap_DebugMessageCallbackARB(GLDEBUGPROCARB callback, const GLvoid *userParam)
+{
+	stop_gl_error_capture();
+	glDebugMessageCallbackARB(callback, userParam);
+}
+
+static void APIENTRY
+wrap_DebugMessageControlARB(GLenum source, GLenum type, GLenum severity,
+			    GLsizei count, const GLuint *ids, GLboolean enabled)
+{
+	stop_gl_error_capture();
+	glDebugMessageControlARB(source, type, severity, count, ids, enabled);
+}
+
+static void APIENTRY
+wrap_DebugMessageInsertARB(GLenum source, GLenum type, GLuint id,
+			   GLenum severity, GLsizei length, const GLchar *buf)
+{
+	stop_gl_error_capture();
+	glDebugMessageInsertARB(source, type, id, severity, length, buf);
+}
+
+static GLuint APIENTRY
+wrap_GetDebugMessageLogARB(GLuint count, GLsizei bufsize, GLenum *sources,
+			   GLenum *types, GLuint *ids, GLenum *severities,
+			   GLsizei *lengths, GLchar *messageLog)
+{
+	stop_gl_error_capture();
+	return glGetDebugMessageLogARB(count, bufsize, sources, types, ids,
+				       severities, lengths, messageLog);
+}
+
+void
+piglit_init_gl_error_capture(void)
+{
+	const char *mode = getenv("PIGLIT_GL_ERROR_CAPTURE");
+	bool khr_debug;
+	unsigned head;
+
+	if (!mode || strcmp(mode, "debug_output") != 0 ||
+	    !piglit_is_extension_supported("GL_ARB_debug_output"))
+		return;
+
+	piglit_reset_gl_error();
+
+	/* Non-debug contexts only report errors with GL_DEBUG_OUTPUT. */
+	khr_debug = piglit_get_gl_version() >= 43 ||
+		piglit_is_extension_supported("GL_KHR_debug");
+	saved_debug_output = !khr_debug || glIsEnabled(GL_DEBUG_OUTPUT);
+	saved_debug_output_synchronous =
+		glIsEnabled(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+
+	if (!saved_debug_output)
+		glEnable(GL_DEBUG_OUTPUT);
+	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+	glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE,
+				 0, NULL, GL_FALSE);
+	glDebugMessageControlARB(GL_DONT_CARE, GL_DEBUG_TYPE_ERROR_ARB,
+				 GL_DONT_CARE, 0, NULL, GL_TRUE);
+	glDebugMessageCallbackARB(capture_debug_message, NULL);
+
+	capture_table = piglit_dispatch_current;
+	saved_DebugMessageCallbackARB =
+		capture_table->functions.DebugMessageCallbackARB;
+	saved_DebugMessageControlARB =
+		capture_table->functions.DebugMessageControlARB;
+	saved_DebugMessageInsertARB =
+		capture_table->functions.DebugMessageInsertARB;
+	saved_GetDebugMessageLogARB =
+		capture_table->functions.GetDebugMessageLogARB;
+	capture_table->functions.DebugMessageCallbackARB =
+		wrap_DebugMessageCallbackARB;
+	capture_table->functions.DebugMessageControlARB =
+		wrap_DebugMessageControlARB;
+	capture_table->functions.DebugMessageInsertARB =
+		wrap_DebugMessageInsertARB;
+	capture_table->functions.GetDebugMessageLogARB =
+		wrap_GetDebugMessageLogARB;
+	error_capture_active = true;
+
+	/* The checks trust an empty ring, so the callback must see every
+	 * error before the call raising it returns.
+	 */
+	head = error_ring_head;
+	glEnable(0xFFFFFFFF);
+	if (error_ring_head == head)
+		stop_gl_error_capture();
+	piglit_reset_gl_error();
+}
+
+#else /* USE_OPENGL */
+
+static const bool error_capture_active = false;
+
+static bool
+have_captured_errors(void)
+{
+	return false;
+}
+
+static void
+consume_captured_errors(bool print)
+{
+}
+
+void
+piglit_init_gl_error_capture(void)
+{
+}
+
+#endif /* USE_OPENGL */
+
 GLboolean
 piglit_check_gl_error_(GLenum expected_error, const char *file, unsigned line)
 {
 	GLenum actual_error;
 
-	actual_error = glGetError();
+	/* While errors are captured, the error flag is clear unless
+	 * something was captured.
+	 */
+	if (error_capture_active && !have_captured_errors())
+		actual_error = GL_NO_ERROR;
+	else
+		actual_error = glGetError();
 	if (actual_error == expected_error) {
+		consume_captured_errors(false);
 		return GL_TRUE;
 	}
 
@@ -170,6 +425,7 @@ piglit_check_gl_error_(GLenum expected_error, const char *file, unsigned line)
 	printf("Unexpected GL error: %s 0x%x\n",
                piglit_get_gl_error_name(actual_error), actual_error);
         printf("(Error at %s:%u)\n", file, line);
+	consume_captured_errors(true);
 
 	/* Print the expected error, but only if an error was really expected. */
 	if (expected_error != GL_NO_ERROR) {
@@ -182,6 +438,10 @@ piglit_check_gl_error_(GLenum expected_error, const char *file, unsigned line)
 
 void piglit_reset_gl_error(void)
 {
+	if (error_capture_active && !have_captured_errors())
+		return;
+	consume_captured_errors(false);
+
 	while (glGetError() != GL_NO_ERROR) {
 		/* empty */
 	}
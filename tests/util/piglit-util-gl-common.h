@@ -104,6 +104,21 @@ piglit_check_gl_error_(GLenum expected_error, const char *file, unsigned line);
  */
 void piglit_reset_gl_error(void);
 
+/**
+ * \brief Report GL errors with the driver's messages about them.
+ *
+ * A diagnostics mode.  If PIGLIT_GL_ERROR_CAPTURE is "debug_output" and
+ * the context reports errors synchronously through a debug callback,
+ * record them in a ring that piglit_check_gl_error() and
+ * piglit_reset_gl_error() consult, so that an unexpected error is printed
+ * along with the driver's message.  Synchronous debug output serializes
+ * threaded drivers, so this is no faster than calling glGetError.
+ * Capture stops as soon as the test uses the debug output API itself.
+ *
+ * Called by the framework once the context is current.
+ */
+void piglit_init_gl_error_capture(void);
+
 void piglit_require_gl_version(int required_version_times_10);
 void piglit_require_extension(const char *name);
 void piglit_require_not_extension(const char *name);
@@ -134,6 +149,20 @@ int piglit_probe_pixel_stencil(int x, int y, unsigned expected);
 int piglit_probe_rect_stencil(int x, int y, int w, int h, unsigned expected);
 int piglit_probe_rect_halves_equal_rgba(int x, int y, int w, int h);
 
+/**
+ * Read a rectangle of the current read buffer into a pixel buffer object
+ * and map it, for comparing pixels in place.  The result holds w * h
+ * tightly packed GL_RGBA / GL_UNSIGNED_BYTE pixels, bottom row first, and
+ * stays valid until piglit_unmap_color_rect().
+ *
+ * Return NULL if the read buffer isn't 8-bit unsigned normalized color, or
+ * if pixel pack or transfer state is set such that a GL_FLOAT read of it
+ * wouldn't give exactly the bytes divided by 255.  The caller then reads
+ * GL_FLOAT pixels as usual.
+ */
+const GLubyte *piglit_map_color_rect(int x, int y, int w, int h);
+void piglit_unmap_color_rect(void);
+
 int piglit_use_fragment_program(void);
 int piglit_use_vertex_program(void);
 void piglit_require_fragment_program(void);
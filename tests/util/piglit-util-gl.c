@@ -34,6 +34,7 @@
 #include <sys/stat.h>
 
 #include "piglit-util-gl-common.h"
+#include "piglit-image-io.h"
 
 
 GLint piglit_ARBfp_pass_through = 0;
@@ -64,6 +65,224 @@ piglit_num_components(GLenum base_format)
 	}
 }
 
+static GLuint color_rect_pbo;
+
+/**
+ * Whether a GL_RGBA / GL_UNSIGNED_BYTE read of the current read buffer into
+ * a PBO gives exactly what a GL_FLOAT read would, scaled by 255.
+ */
+static bool
+color_rect_mappable(void)
+{
+	static const struct {
+		GLenum pname;
+		GLint value;
+	} pack_defaults[] = {
+		{ GL_PIXEL_PACK_BUFFER_BINDING, 0 },
+		{ GL_PACK_ROW_LENGTH, 0 },
+		{ GL_PACK_SKIP_ROWS, 0 },
+		{ GL_PACK_SKIP_PIXELS, 0 },
+		{ GL_PACK_SWAP_BYTES, GL_FALSE },
+		{ GL_MAP_COLOR, GL_FALSE },
+	};
+	static const struct {
+		GLenum pname;
+		GLfloat value;
+	} transfer_defaults[] = {
+		{ GL_RED_SCALE, 1.0 },
+		{ GL_GREEN_SCALE, 1.0 },
+		{ GL_BLUE_SCALE, 1.0 },
+		{ GL_ALPHA_SCALE, 1.0 },
+		{ GL_RED_BIAS, 0.0 },
+		{ GL_GREEN_BIAS, 0.0 },
+		{ GL_BLUE_BIAS, 0.0 },
+		{ GL_ALPHA_BIAS, 0.0 },
+	};
+	static int supported = -1;
+	GLint read_fb, draw_fb, read_buffer, alignment, value;
+	GLint bits[4];
+	GLfloat fvalue;
+	int i;
+
+	if (supported < 0) {
+		supported = (piglit_get_gl_version() >= 30 ||
+			     piglit_is_extension_supported(
+				     "GL_ARB_framebuffer_object")) &&
+			    (piglit_get_gl_version() >= 21 ||
+			     piglit_is_extension_supported(
+				     "GL_ARB_pixel_buffer_object"));
+	}
+	if (!supported)
+		return false;
+
+	for (i = 0; i < ARRAY_SIZE(pack_defaults); i++) {
+		glGetIntegerv(pack_defaults[i].pname, &value);
+		if (value != pack_defaults[i].value)
+			return false;
+	}
+	for (i = 0; i < ARRAY_SIZE(transfer_defaults); i++) {
+		glGetFloatv(transfer_defaults[i].pname, &fvalue);
+		if (fvalue != transfer_defaults[i].value)
+			return false;
+	}
+
+	/* RGBA8 rows are always 4-byte aligned. */
+	glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+	if (alignment > 4)
+		return false;
+
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_fb);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_fb);
+	if (read_fb == 0) {
+		/* GL_RED_BITS and friends describe the draw
+		 * framebuffer, and window system buffers are always
+		 * normalized.
+		 */
+		if (draw_fb != 0)
+			return false;
+		glGetIntegerv(GL_RED_BITS, &bits[0]);
+		glGetIntegerv(GL_GREEN_BITS, &bits[1]);
+		glGetIntegerv(GL_BLUE_BITS, &bits[2]);
+		glGetIntegerv(GL_ALPHA_BITS, &bits[3]);
+	} else {
+		glGetIntegerv(GL_READ_BUFFER, &read_buffer);
+		if (read_buffer == GL_NONE)
+			return false;
+
+		glGetFramebufferAttachmentParameteriv(
+			GL_READ_FRAMEBUFFER, read_buffer,
+			GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &value);
+		if (value != GL_UNSIGNED_NORMALIZED)
+			return false;
+		glGetFramebufferAttachmentParameteriv(
+			GL_READ_FRAMEBUFFER, read_buffer,
+			GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &value);
+		if (value != GL_LINEAR)
+			return false;
+
+		glGetFramebufferAttachmentParameteriv(
+			GL_READ_FRAMEBUFFER, read_buffer,
+			GL_FRAMEBUFFER_ATTACHMENT_RED_SIZE, &bits[0]);
+		glGetFramebufferAttachmentParameteriv(
+			GL_READ_FRAMEBUFFER, read_buffer,
+			GL_FRAMEBUFFER_ATTACHMENT_GREEN_SIZE, &bits[1]);
+		glGetFramebufferAttachmentParameteriv(
+			GL_READ_FRAMEBUFFER, read_buffer,
+			GL_FRAMEBUFFER_ATTACHMENT_BLUE_SIZE, &bits[2]);
+		glGetFramebufferAttachmentParameteriv(
+			GL_READ_FRAMEBUFFER, read_buffer,
+			GL_FRAMEBUFFER_ATTACHMENT_ALPHA_SIZE, &bits[3]);
+	}
+
+	/* Other sizes would be rounded differently to bytes than to
+	 * floats.  A missing alpha channel reads as 1.0 either way.
+	 */
+	return bits[0] == 8 && bits[1] == 8 && bits[2] == 8 &&
+	       (bits[3] == 8 || bits[3] == 0);
+}
+
+const GLubyte *
+piglit_map_color_rect(int x, int y, int w, int h)
+{
+	const GLubyte *pixels;
+
+	if (!color_rect_mappable())
+		return NULL;
+
+	if (!color_rect_pbo)
+		glGenBuffers(1, &color_rect_pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, color_rect_pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, w * h * 4, NULL, GL_STREAM_READ);
+	glReadPixels(x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	if (!pixels)
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return pixels;
+}
+
+void
+piglit_unmap_color_rect(void)
+{
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/**
+ * Find the first of \c count RGBA8 pixels whose first \c components
+ * channels don't match \c expected, using the same test as the GL_FLOAT
+ * rect probes.  The test is done once for each byte value of each channel
+ * up front, so that the pixels themselves are only looked up.
+ *
+ * \return the index of the pixel, or -1 if all of them match
+ */
+static int
+find_color_rect_mismatch(const GLubyte *pixels, int count, int components,
+			 const float *expected)
+{
+	bool ok[4][256];
+	int i, p;
+
+	for (p = 0; p < components; p++) {
+		for (i = 0; i < 256; i++) {
+			ok[p][i] = fabs(i / 255.0f - expected[p]) <
+				piglit_tolerance[p];
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		for (p = 0; p < components; p++) {
+			if (!ok[p][pixels[i * 4 + p]])
+				return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Probe a rect through piglit_map_color_rect().  Return 1 or 0 like the
+ * rect probes, or -1 if the rect couldn't be mapped.
+ */
+static int
+probe_mapped_color_rect(int x, int y, int w, int h, int components,
+			const float *expected, bool silent)
+{
+	const GLubyte *pixels = piglit_map_color_rect(x, y, w, h);
+	float probe[4];
+	int i, p;
+
+	if (!pixels)
+		return -1;
+
+	i = find_color_rect_mismatch(pixels, w * h, components, expected);
+	if (i < 0) {
+		piglit_unmap_color_rect();
+		return 1;
+	}
+
+	for (p = 0; p < 4; p++)
+		probe[p] = pixels[i * 4 + p] / 255.0f;
+	piglit_unmap_color_rect();
+
+	if (silent)
+		return 0;
+
+	printf("Probe at (%i,%i)\n", x + i % w, y + i / w);
+	if (components == 4) {
+		printf("  Expected: %f %f %f %f\n",
+		       expected[0], expected[1], expected[2], expected[3]);
+		printf("  Observed: %f %f %f %f\n",
+		       probe[0], probe[1], probe[2], probe[3]);
+	} else {
+		printf("  Expected: %f %f %f\n",
+		       expected[0], expected[1], expected[2]);
+		printf("  Observed: %f %f %f\n",
+		       probe[0], probe[1], probe[2]);
+	}
+
+	piglit_dump_probe_failure();
+	return 0;
+}
+
 /**
  * Read a pixel from the given location and compare its RGBA value to the
  * given expected values.
@@ -92,6 +311,7 @@ int piglit_probe_pixel_rgba(int x, int y, const float* expected)
 	printf("  Expected: %f %f %f %f\n", expected[0], expected[1], expected[2], expected[3]);
 	printf("  Observed: %f %f %f %f\n", probe[0], probe[1], probe[2], probe[3]);
 
+	piglit_dump_probe_failure();
 	return 0;
 }
 
@@ -140,7 +360,13 @@ piglit_probe_rect_rgba(int x, int y, int w, int h, const float *expected)
 {
 	int i, j, p;
 	GLfloat *probe;
-	GLfloat *pixels = malloc(w*h*4*sizeof(float));
+	GLfloat *pixels;
+
+	p = probe_mapped_color_rect(x, y, w, h, 4, expected, false);
+	if (p >= 0)
+		return p;
+
+	pixels = malloc(w*h*4*sizeof(float));
 
 	glReadPixels(x, y, w, h, GL_RGBA, GL_FLOAT, pixels);
 
@@ -157,6 +383,7 @@ piglit_probe_rect_rgba(int x, int y, int w, int h, const float *expected)
 					       probe[0], probe[1], probe[2], probe[3]);
 
 					free(pixels);
+					piglit_dump_probe_failure();
 					return 0;
 				}
 			}
@@ -285,6 +512,7 @@ piglit_probe_image_color(int x, int y, int w, int h, GLenum format,
 					printf("\n");
 
 					free(pixels);
+					piglit_dump_probe_failure();
 					return 0;
 				}
 			}
@@ -336,6 +564,7 @@ int piglit_probe_pixel_rgb(int x, int y, const float* expected)
 	printf("  Expected: %f %f %f\n", expected[0], expected[1], expected[2]);
 	printf("  Observed: %f %f %f\n", probe[0], probe[1], probe[2]);
 
+	piglit_dump_probe_failure();
 	return 0;
 }
 
@@ -344,7 +573,13 @@ piglit_probe_rect_rgb(int x, int y, int w, int h, const float *expected)
 {
 	int i, j, p;
 	GLfloat *probe;
-	GLfloat *pixels = malloc(w*h*3*sizeof(float));
+	GLfloat *pixels;
+
+	p = probe_mapped_color_rect(x, y, w, h, 3, expected, false);
+	if (p >= 0)
+		return p;
+
+	pixels = malloc(w*h*3*sizeof(float));
 
 	glReadPixels(x, y, w, h, GL_RGB, GL_FLOAT, pixels);
 
@@ -361,6 +596,7 @@ piglit_probe_rect_rgb(int x, int y, int w, int h, const float *expected)
 					       probe[0], probe[1], probe[2]);
 
 					free(pixels);
+					piglit_dump_probe_failure();
 					return 0;
 				}
 			}
@@ -376,7 +612,13 @@ piglit_probe_rect_rgb_silent(int x, int y, int w, int h, const float *expected)
 {
 	int i, j, p;
 	GLfloat *probe;
-	GLfloat *pixels = malloc(w*h*3*sizeof(float));
+	GLfloat *pixels;
+
+	p = probe_mapped_color_rect(x, y, w, h, 3, expected, true);
+	if (p >= 0)
+		return p;
+
+	pixels = malloc(w*h*3*sizeof(float));
 
 	glReadPixels(x, y, w, h, GL_RGB, GL_FLOAT, pixels);
 
@@ -637,6 +879,7 @@ int piglit_probe_rect_halves_equal_rgba(int x, int y, int w, int h)
 					       probe2[0], probe2[1], probe2[2], probe2[3]);
 
 					free(pixels);
+					piglit_dump_probe_failure();
 					return 0;
 				}
 			}
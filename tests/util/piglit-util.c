@@ -21,6 +21,9 @@
  * USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+/* For sched_setaffinity() and the CPU_* macros. */
+#define _GNU_SOURCE
+
 #if defined(_WIN32)
 # define WIN32_LEAN_AND_MEAN
 # include <windows.h>
@@ -32,6 +35,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <setjmp.h>
 
 #include "config.h"
 #if defined(HAVE_SYS_TIME_H) && defined(HAVE_SYS_RESOURCE_H) && defined(HAVE_SETRLIMIT)
@@ -40,6 +44,17 @@
 # define USE_SETRLIMIT
 #endif
 
+#if defined(HAVE_SCHED_SETAFFINITY)
+# include <sched.h>
+# define USE_SCHED_SETAFFINITY
+#endif
+
+#if defined(HAVE_CLOCK_GETTIME)
+# include <time.h>
+#elif defined(HAVE_SYS_TIME_H)
+# include <sys/time.h>
+#endif
+
 #if defined(HAVE_FCNTL_H) && defined(HAVE_SYS_STAT_H) && defined(HAVE_SYS_TYPES_H) && defined(HAVE_UNISTD_H)
 # include <sys/types.h>
 # include <sys/stat.h>
@@ -172,11 +187,24 @@ piglit_merge_result(enum piglit_result *all, enum piglit_result subtest)
 	}
 }
 
+const char *piglit_selected_subtest = NULL;
+
+/* Where piglit_report_result() returns to while piglit_run_subtests() is
+ * running a combination, and the result it reported.
+ */
+static jmp_buf *subtest_jmp = NULL;
+static enum piglit_result subtest_jmp_result;
+
 void
 piglit_report_result(enum piglit_result result)
 {
 	fflush(stderr);
 
+	if (subtest_jmp) {
+		subtest_jmp_result = result;
+		longjmp(*subtest_jmp, 1);
+	}
+
 	if (result == PIGLIT_PASS) {
 		printf("PIGLIT: {'result': 'pass' }\n");
 		fflush(stdout);
@@ -196,6 +224,111 @@ piglit_report_result(enum piglit_result result)
 	}
 }
 
+/**
+ * Report the result of one named part of a test, without exiting.  The
+ * framework collects these under the 'subtest' key of the test's result.
+ */
+void
+piglit_report_subtest_result(enum piglit_result result, const char *name)
+{
+	const char *str;
+
+	switch (result) {
+	case PIGLIT_PASS: str = "pass"; break;
+	case PIGLIT_SKIP: str = "skip"; break;
+	case PIGLIT_WARN: str = "warn"; break;
+	default:          str = "fail"; break;
+	}
+
+	fflush(stderr);
+	printf("PIGLIT: {'subtest': {'%s' : '%s'}}\n", name, str);
+	fflush(stdout);
+}
+
+enum piglit_result
+piglit_run_subtests(const struct piglit_subtest_param *params,
+		    piglit_subtest_func func, void *data)
+{
+	enum piglit_result all = PIGLIT_SKIP;
+	unsigned num_params, i;
+	unsigned *choice;
+	char *name;
+	size_t name_size = 1;
+	bool found = false;
+	jmp_buf jmp;
+
+	for (num_params = 0; params[num_params].name; num_params++) {
+		const char *const *v;
+		size_t longest = 0;
+
+		for (v = params[num_params].values; *v; v++) {
+			if (strlen(*v) > longest)
+				longest = strlen(*v);
+		}
+		name_size += longest + 1;
+	}
+
+	choice = calloc(num_params ? num_params : 1, sizeof(*choice));
+	name = malloc(name_size);
+	if (!choice || !name) {
+		printf("Out of memory\n");
+		piglit_report_result(PIGLIT_FAIL);
+	}
+
+	for (;;) {
+		enum piglit_result result;
+
+		name[0] = '\0';
+		for (i = 0; i < num_params; i++) {
+			if (i > 0)
+				strcat(name, " ");
+			strcat(name, params[i].values[choice[i]]);
+		}
+
+		if (!piglit_selected_subtest ||
+		    strcmp(piglit_selected_subtest, name) == 0) {
+			found = true;
+
+			printf("Testing");
+			for (i = 0; i < num_params; i++) {
+				printf("%s %s=%s", i > 0 ? "," : "",
+				       params[i].name,
+				       params[i].values[choice[i]]);
+			}
+			printf("\n");
+
+			if (setjmp(jmp) == 0) {
+				subtest_jmp = &jmp;
+				result = func(choice, data);
+			} else {
+				result = subtest_jmp_result;
+			}
+			subtest_jmp = NULL;
+
+			piglit_report_subtest_result(result, name);
+			piglit_merge_result(&all, result);
+		}
+
+		/* Step to the next combination, last parameter fastest. */
+		for (i = num_params; i > 0; i--) {
+			if (params[i - 1].values[++choice[i - 1]])
+				break;
+			choice[i - 1] = 0;
+		}
+		if (i == 0)
+			break;
+	}
+
+	if (!found) {
+		printf("Unknown subtest \"%s\"\n", piglit_selected_subtest);
+		all = PIGLIT_FAIL;
+	}
+
+	free(choice);
+	free(name);
+	return all;
+}
+
 char *piglit_load_text_file(const char *file_name, unsigned *size)
 {
 	char *text = NULL;
@@ -337,3 +470,78 @@ piglit_set_rlimit(unsigned long lim)
 	printf("Cannot reset rlimit on this platform.\n\n");
 #endif
 }
+
+/**
+ * Restrict the process to the CPUs listed in PIGLIT_CPUS (e.g. "2,3"),
+ * which piglit-run.py sets to share the CPUs among the tests it runs at
+ * the same time.  Threads started later, such as the driver's, inherit
+ * the restriction.
+ */
+void
+piglit_set_cpu_affinity_from_env(void)
+{
+#if defined(USE_SCHED_SETAFFINITY)
+	const char *list = getenv("PIGLIT_CPUS");
+	cpu_set_t set;
+	char *end;
+
+	if (list == NULL || *list == '\0')
+		return;
+
+	CPU_ZERO(&set);
+	for (;;) {
+		unsigned long cpu = strtoul(list, &end, 10);
+
+		if (end == list || cpu >= CPU_SETSIZE ||
+		    (*end != ',' && *end != '\0')) {
+			printf("Ignoring malformed PIGLIT_CPUS.\n");
+			return;
+		}
+		CPU_SET(cpu, &set);
+		if (*end == '\0')
+			break;
+		list = end + 1;
+	}
+
+	if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+		printf("Could not set CPU affinity due to: %s (%d)\n",
+		       strerror(errno), errno);
+	}
+#endif
+}
+
+/**
+ * Read a monotonic clock, in nanoseconds.
+ *
+ * The epoch is unspecified, so only differences between two readings are
+ * meaningful.  Falls back to the wall clock on platforms without a
+ * monotonic clock source.
+ */
+int64_t
+piglit_time_get_nano(void)
+{
+#if defined(_WIN32)
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER counter;
+
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&counter);
+
+	/* Split the conversion to avoid overflowing 64 bits. */
+	return (counter.QuadPart / freq.QuadPart) * INT64_C(1000000000) +
+		(counter.QuadPart % freq.QuadPart) * INT64_C(1000000000) /
+		freq.QuadPart;
+#elif defined(HAVE_CLOCK_GETTIME)
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (int64_t) t.tv_sec * INT64_C(1000000000) + t.tv_nsec;
+#else
+	struct timeval t;
+
+	gettimeofday(&t, NULL);
+	return (int64_t) t.tv_sec * INT64_C(1000000000) +
+		(int64_t) t.tv_usec * 1000;
+#endif
+}
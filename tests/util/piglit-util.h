@@ -132,6 +132,45 @@ int FindLine(const char *program, int position);
 
 void piglit_merge_result(enum piglit_result *all, enum piglit_result subtest);
 void piglit_report_result(enum piglit_result result);
+void piglit_report_subtest_result(enum piglit_result result, const char *name);
+
+/**
+ * One parameter of a test that covers a whole parameter space in one
+ * process.  See piglit_run_subtests().
+ */
+struct piglit_subtest_param {
+	const char *name;		/**< For messages, e.g. "format". */
+	const char *const *values;	/**< NULL-terminated list of values. */
+};
+
+/**
+ * Called by piglit_run_subtests() for one combination of parameters.
+ * \c choice holds the index of the chosen value of each parameter.
+ */
+typedef enum piglit_result (*piglit_subtest_func)(const unsigned *choice,
+						  void *data);
+
+/**
+ * If not NULL, piglit_run_subtests() runs only the combination of this
+ * name, for debugging.  Set by the "-subtest NAME" command line option.
+ */
+extern const char *piglit_selected_subtest;
+
+/**
+ * Call \c func for every combination of the values of \c params, which
+ * is terminated by an entry with a NULL name, and report each result with
+ * piglit_report_subtest_result().  A combination is named by its values
+ * separated by spaces, e.g. "depth-test d24s8".
+ *
+ * A piglit_report_result() call made while \c func runs, e.g. by
+ * piglit_require_extension(), ends only the current combination.  Any GL
+ * state it leaves behind is seen by the following combinations.
+ *
+ * Returns the merged result of all combinations that were run.
+ */
+enum piglit_result
+piglit_run_subtests(const struct piglit_subtest_param *params,
+		    piglit_subtest_func func, void *data);
 
 char *piglit_load_text_file(const char *file_name, unsigned *size);
 
@@ -140,6 +179,9 @@ char *strchrnul(const char *s, int c);
 #endif
 
 extern void piglit_set_rlimit(unsigned long lim);
+void piglit_set_cpu_affinity_from_env(void);
+
+int64_t piglit_time_get_nano(void);
 
 #ifdef __cplusplus
 } /* end extern "C" */
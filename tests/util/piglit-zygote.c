@@ -0,0 +1,358 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-zygote.c
+ *
+ * Fork server for test executables.  See piglit-zygote.h.
+ *
+ * The zygote forks a short-lived helper per connection, which reads the
+ * request, forks the test itself and waits for it, so that the zygote
+ * only ever accepts connections and many runs can be in flight at once.
+ */
+
+#include "piglit-util-gl-common.h"
+#include "piglit-zygote.h"
+
+#if defined(HAVE_FORK) && defined(HAVE_SYS_UN_H) && defined(HAVE_UNISTD_H)
+#define USE_ZYGOTE
+#endif
+
+#ifdef USE_ZYGOTE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef HAVE_DLFCN_H
+#include <dlfcn.h>
+#endif
+
+/** Largest request accepted, to bound a bad client. */
+#define MAX_REQUEST_SIZE (1 << 20)
+
+static void
+preload_libraries(void)
+{
+#ifdef HAVE_DLFCN_H
+	const char *list = getenv("PIGLIT_ZYGOTE_PRELOAD");
+	char *copy, *name, *save;
+
+	if (!list)
+		return;
+
+	copy = strdup(list);
+	for (name = strtok_r(copy, ":", &save); name;
+	     name = strtok_r(NULL, ":", &save)) {
+		if (!dlopen(name, RTLD_NOW | RTLD_GLOBAL))
+			fprintf(stderr, "zygote: can't preload %s: %s\n",
+				name, dlerror());
+	}
+	free(copy);
+#endif
+}
+
+/**
+ * Read from \c fd until end of file.  The result is NUL-terminated, so
+ * that a request missing its last terminator can't overrun it.
+ */
+static char *
+read_all(int fd, size_t *size)
+{
+	size_t capacity = 4096;
+	char *buf = malloc(capacity);
+
+	*size = 0;
+	while (buf) {
+		ssize_t n;
+
+		if (*size + 1 == capacity) {
+			if (capacity >= MAX_REQUEST_SIZE) {
+				free(buf);
+				return NULL;
+			}
+			capacity *= 2;
+			buf = realloc(buf, capacity);
+			if (!buf)
+				return NULL;
+		}
+
+		n = read(fd, buf + *size, capacity - *size - 1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			free(buf);
+			return NULL;
+		}
+		if (n == 0) {
+			buf[*size] = '\0';
+			return buf;
+		}
+		*size += n;
+	}
+	return NULL;
+}
+
+/**
+ * Return the string at \c *pos in the request and step past it, or NULL
+ * if the request ends first.
+ */
+static char *
+next_field(char *buf, size_t size, size_t *pos)
+{
+	char *field = buf + *pos;
+
+	if (*pos >= size)
+		return NULL;
+	*pos += strlen(field) + 1;
+	return field;
+}
+
+static bool
+redirect(int fd, const char *filename, int flags)
+{
+	int file = open(filename, flags, 0644);
+
+	if (file < 0)
+		return false;
+	if (file != fd) {
+		dup2(file, fd);
+		close(file);
+	}
+	return true;
+}
+
+/**
+ * Body of the helper process of one connection.  Returns only in the test
+ * process, after setting it up as the request asks.
+ */
+static void
+handle_connection(int conn, int *argc, char ***argv)
+{
+	char *buf, *out_file, *err_file, *cwd, *count;
+	char **args;
+	size_t size, pos = 0;
+	int n, i, status;
+	pid_t pid;
+	struct rusage usage;
+	char reply[64];
+
+	buf = read_all(conn, &size);
+	if (!buf)
+		_exit(1);
+
+	out_file = next_field(buf, size, &pos);
+	err_file = next_field(buf, size, &pos);
+	cwd = next_field(buf, size, &pos);
+	count = next_field(buf, size, &pos);
+	if (!count)
+		_exit(1);
+
+	n = atoi(count);
+	if (n < 1 || n > (int) size)
+		_exit(1);
+	args = calloc(n + 1, sizeof(char *));
+	for (i = 0; i < n; i++) {
+		args[i] = next_field(buf, size, &pos);
+		if (!args[i])
+			_exit(1);
+	}
+
+	/* The helper must be able to wait for the test. */
+	signal(SIGCHLD, SIG_DFL);
+
+	pid = fork();
+	if (pid == 0) {
+		char *var;
+
+		close(conn);
+
+		if (!redirect(STDIN_FILENO, "/dev/null", O_RDONLY) ||
+		    !redirect(STDOUT_FILENO, out_file,
+			      O_WRONLY | O_CREAT | O_TRUNC) ||
+		    !redirect(STDERR_FILENO, err_file,
+			      O_WRONLY | O_CREAT | O_TRUNC) ||
+		    chdir(cwd) != 0)
+			_exit(1);
+
+		count = next_field(buf, size, &pos);
+		if (!count)
+			_exit(1);
+		clearenv();
+		for (i = atoi(count); i > 0; i--) {
+			var = next_field(buf, size, &pos);
+			if (!var)
+				_exit(1);
+			putenv(var);
+		}
+
+		*argc = n;
+		*argv = args;
+		return;
+	}
+
+	/* The reply is the exit status and the peak resident set size
+	 * (ru_maxrss) of the test, for the runner's memory accounting.
+	 */
+	memset(&usage, 0, sizeof(usage));
+	if (pid < 0) {
+		status = 1;
+	} else {
+		while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR)
+			;
+		if (WIFSIGNALED(status))
+			status = -WTERMSIG(status);
+		else
+			status = WEXITSTATUS(status);
+	}
+
+	snprintf(reply, sizeof(reply), "%d %ld\n", status,
+		 (long) usage.ru_maxrss);
+	if (write(conn, reply, strlen(reply)) < 0)
+		_exit(1);
+	_exit(0);
+}
+
+static void
+serve(const char *socket_path, int *argc, char ***argv)
+{
+	struct sockaddr_un addr;
+	int listen_fd;
+
+	if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "zygote: socket path too long\n");
+		exit(1);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_fd < 0 ||
+	    bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+	    listen(listen_fd, 64) != 0) {
+		fprintf(stderr, "zygote: can't listen on %s: %s\n",
+			socket_path, strerror(errno));
+		exit(1);
+	}
+
+	/* Work shared by every run.  Dispatch setup queries the
+	 * context's extensions, so it is left to each run.
+	 */
+	preload_libraries();
+
+	/* Helpers are reaped automatically. */
+	signal(SIGCHLD, SIG_IGN);
+
+	printf("PIGLIT-ZYGOTE: ready\n");
+	fflush(stdout);
+	fflush(stderr);
+
+	for (;;) {
+		struct pollfd fds[2];
+		int conn;
+		pid_t pid;
+
+		fds[0].fd = STDIN_FILENO;
+		fds[0].events = POLLIN;
+		fds[1].fd = listen_fd;
+		fds[1].events = POLLIN;
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (fds[0].revents) {
+			char c;
+			if (read(STDIN_FILENO, &c, 1) <= 0)
+				break;
+		}
+
+		if (!(fds[1].revents & POLLIN))
+			continue;
+
+		conn = accept(listen_fd, NULL, NULL);
+		if (conn < 0)
+			continue;
+
+		pid = fork();
+		if (pid == 0) {
+			close(listen_fd);
+			handle_connection(conn, argc, argv);
+			return;
+		}
+		close(conn);
+	}
+
+	close(listen_fd);
+	unlink(socket_path);
+	exit(0);
+}
+
+void
+piglit_zygote_init(int *argc, char ***argv)
+{
+	const char *request = getenv("PIGLIT_ZYGOTE");
+	char *socket_path;
+	long parent;
+
+	if (!request)
+		return;
+
+	/* Only a direct child of the framework serves, not tests that
+	 * are started by the test being run.
+	 */
+	parent = strtol(request, &socket_path, 10);
+	if (*socket_path != ':' || parent != (long) getppid()) {
+		unsetenv("PIGLIT_ZYGOTE");
+		return;
+	}
+
+	socket_path = strdup(socket_path + 1);
+	unsetenv("PIGLIT_ZYGOTE");
+	serve(socket_path, argc, argv);
+	free(socket_path);
+}
+
+#else /* USE_ZYGOTE */
+
+void
+piglit_zygote_init(int *argc, char ***argv)
+{
+	/* The framework falls back to starting every run itself when
+	 * the first one doesn't report that it is a zygote.
+	 */
+}
+
+#endif /* USE_ZYGOTE */
@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-zygote.h
+ *
+ * Fork server ("zygote") for running a test executable many times.
+ *
+ * The framework starts a test as a zygote by setting PIGLIT_ZYGOTE to
+ * "<pid>:<socket path>", where pid is the framework's own process id, so
+ * that tests started by other tests do not become zygotes too.  The zygote
+ * does the start-up work that can be shared between runs, which includes
+ * loading the libraries named in the colon-separated PIGLIT_ZYGOTE_PRELOAD
+ * (e.g. the DRI driver), prints "PIGLIT-ZYGOTE: ready" on stdout and
+ * listens on the Unix socket.  The window system connection and the context
+ * are still made by each run, since they can't be shared across fork().
+ *
+ * Each connection to the socket is one run.  The client sends a sequence
+ * of NUL-terminated strings and then shuts down its side for writing:
+ *
+ *	stdout file, stderr file, working directory,
+ *	number of arguments, arguments...,
+ *	number of environment variables, "NAME=value"...
+ *
+ * The zygote forks a child that takes on the arguments, environment,
+ * working directory and output files and runs the test.  The reply is
+ * the child's exit status as a decimal number: the exit code, or minus
+ * the number of the signal that killed it, like Python's
+ * subprocess.Popen.returncode.
+ *
+ * The zygote exits when its stdin is closed.  See framework/zygote.py.
+ */
+
+#pragma once
+#ifndef PIGLIT_ZYGOTE_H
+#define PIGLIT_ZYGOTE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * If PIGLIT_ZYGOTE asks this process to be a zygote, serve runs until stdin
+ * is closed and then exit.  Only the forked children return from this
+ * call, with \c argc and \c argv replaced by the arguments of their run.
+ *
+ * Otherwise, return right away.
+ */
+void
+piglit_zygote_init(int *argc, char ***argv);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+
+#endif /* PIGLIT_ZYGOTE_H */